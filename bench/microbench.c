@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+
+/*
+ * Timings of the interpreter's primitives in isolation, to attribute a
+ * regression of a bench/ script to the primitive behind it.
+ * Usage: bench/microbench [FILTER], only primitives whose name contains
+ * FILTER are timed. Built by `make microbench`, which links it with
+ * -Wl,--wrap for malloc, calloc and realloc so allocations are counted
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lbuf.h"
+#include "lval.h"
+#include "parser.h"
+
+/* Least time a primitive is timed for, repetitions double until then */
+#define MBENCH_MIN_NS 100000000L
+/* Most operands of `+` timed */
+#define MBENCH_MAX_OPERANDS 256
+
+/* Allocations so far, counted by the wrappers the linker routes malloc,
+ * calloc and realloc of the interpreter through */
+static unsigned long mbench_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    mbench_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    mbench_allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    mbench_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+/**
+ * @brief  What a timed operation works on
+ * @note   Operations never keep what they create, so every repetition does
+ *         the same work
+ */
+typedef struct MBench {
+    mpc_ast_t *ast;
+    LVal *lval;
+    LVal *other;
+    LEnv *lenv;
+    LVal *lfun;
+    int count;
+    LBuf lbuf;
+} MBench;
+
+static const char *mbench_filter = NULL;
+static volatile int mbench_sink = 0;
+
+static long mbench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Time `run` on `mbench` and print ns and allocations per operation
+static void mbench_time(const char *name, void (*run)(MBench *mbench),
+                        MBench *mbench) {
+    if (mbench_filter && !strstr(name, mbench_filter)) {
+        return;
+    }
+
+    // Warm up caches and the allocator first
+    run(mbench);
+
+    long reps = 1;
+    long elapsed;
+    unsigned long allocs;
+    while (1) {
+        unsigned long start_allocs = mbench_allocs;
+        long start = mbench_now();
+        for (long i = 0; i < reps; i++) {
+            run(mbench);
+        }
+        elapsed = mbench_now() - start;
+        allocs = mbench_allocs - start_allocs;
+        if (elapsed >= MBENCH_MIN_NS) {
+            break;
+        }
+        reps *= 2;
+    }
+
+    printf("%-28s %12.1f %12.2f\n", name, (double)elapsed / (double)reps,
+           (double)allocs / (double)reps);
+    fflush(stdout);
+}
+
+static void mbench_read(MBench *mbench) {
+    lval_del(lval_read_ast(mbench->ast));
+}
+
+static void mbench_copy(MBench *mbench) {
+    lval_del(lval_copy(mbench->lval));
+}
+
+static void mbench_get(MBench *mbench) {
+    lval_del(lenv_get(mbench->lenv, mbench->lval));
+}
+
+static void mbench_eq(MBench *mbench) {
+    mbench_sink += lval_eq(mbench->lval, mbench->other);
+}
+
+static void mbench_print(MBench *mbench) {
+    mbench->lbuf.len = 0;
+    lval_print_lbuf(&mbench->lbuf, mbench->lval);
+}
+
+// Operands are allocated in the loop too, `count` of the allocations
+static void mbench_op(MBench *mbench) {
+    LVal *argv[MBENCH_MAX_OPERANDS];
+    for (int i = 0; i < mbench->count; i++) {
+        argv[i] = lval_wrap_long(i);
+    }
+    lval_del(mbench->lfun->lbuiltinv(mbench->lenv, mbench->count, argv));
+}
+
+/* Generated sources */
+
+// {0 1 ... n-1}
+static char *mbench_flat(int n) {
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lbuf_putc(&lbuf, '{');
+    for (int i = 0; i < n; i++) {
+        lbuf_put_long(&lbuf, i);
+        lbuf_putc(&lbuf, ' ');
+    }
+    lbuf_putc(&lbuf, '}');
+    return lbuf_take(&lbuf, NULL);
+}
+
+// {{... {0} ...}} nested n times
+static char *mbench_deep(int n) {
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    for (int i = 0; i < n; i++) {
+        lbuf_putc(&lbuf, '{');
+    }
+    lbuf_putc(&lbuf, '0');
+    for (int i = 0; i < n; i++) {
+        lbuf_putc(&lbuf, '}');
+    }
+    return lbuf_take(&lbuf, NULL);
+}
+
+// n strings too long to be stored inline, so copies share their bytes
+static char *mbench_strs(int n) {
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lbuf_putc(&lbuf, '{');
+    for (int i = 0; i < n; i++) {
+        lbuf_puts(&lbuf, "\"a string longer than inline storage ");
+        lbuf_put_long(&lbuf, i);
+        lbuf_puts(&lbuf, "\" ");
+    }
+    lbuf_putc(&lbuf, '}');
+    return lbuf_take(&lbuf, NULL);
+}
+
+// n definitions of recursive lambdas, as a program reads them
+static char *mbench_program(int n) {
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lbuf_putc(&lbuf, '{');
+    for (int i = 0; i < n; i++) {
+        lbuf_puts(&lbuf, "(def {f");
+        lbuf_put_long(&lbuf, i);
+        lbuf_puts(&lbuf, "} (\\ {n} {if (< n 2) {n} {+ (f");
+        lbuf_put_long(&lbuf, i);
+        lbuf_puts(&lbuf, " (- n 1)) (f");
+        lbuf_put_long(&lbuf, i);
+        lbuf_puts(&lbuf, " (- n 2))}}))\n");
+    }
+    lbuf_putc(&lbuf, '}');
+    return lbuf_take(&lbuf, NULL);
+}
+
+static mpc_ast_t *mbench_parse(char *src) {
+    mpc_result_t result;
+    if (!mpc_parse("<microbench>", src, Notation, &result)) {
+        mpc_err_print(result.error);
+        mpc_err_delete(result.error);
+        exit(1);
+    }
+    free(src);
+    return result.output;
+}
+
+/* Shapes of trees read, copied, compared and printed */
+enum { MBENCH_FLAT, MBENCH_DEEP, MBENCH_STRS, MBENCH_PROGRAM, MBENCH_SHAPES };
+
+static const char *mbench_shapes[MBENCH_SHAPES] = {
+    "flat-1000", "deep-100", "strs-1000", "program-100"};
+
+// Global LEnv with the builtins and `count` numbers bound to v0, v1, ...
+static LEnv *mbench_globals(int count) {
+    LEnv *lenv = lenv_new();
+    char sym[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(sym, sizeof(sym), "v%d", i);
+        LVal *lsym = lval_wrap_symn(sym, strlen(sym));
+        LVal *lnum = lval_wrap_long(i);
+        lenv_put(lenv, lsym, lnum);
+        lval_del(lsym);
+        lval_del(lnum);
+    }
+    return lenv;
+}
+
+// Local LEnv's `depth` deep over `root`, each binding 4 names
+static LEnv *mbench_locals(LEnv *root, int depth) {
+    LEnv *lenv = root;
+    for (int i = 0; i < depth; i++) {
+        LEnv *local = lenv_new();
+        local->parent = lenv;
+        for (int j = 0; j < 4; j++) {
+            char sym[] = {'l', (char)('0' + j), '\0'};
+            LVal *lsym = lval_wrap_symn(sym, 2);
+            LVal *lnum = lval_wrap_long(j);
+            lenv_put(local, lsym, lnum);
+            lval_del(lsym);
+            lval_del(lnum);
+        }
+        lenv = local;
+    }
+    return lenv;
+}
+
+static void mbench_locals_del(LEnv *lenv, LEnv *root) {
+    while (lenv != root) {
+        LEnv *parent = lenv->parent;
+        lenv_del(lenv);
+        lenv = parent;
+    }
+}
+
+// Time lenv_get of `sym` from `lenv`, without and with an inline cache
+static void mbench_time_get(const char *name, LEnv *lenv, const char *sym) {
+    char cached[64];
+    snprintf(cached, sizeof(cached), "%s-cached", name);
+
+    MBench mbench;
+    mbench.lenv = lenv;
+    mbench.lval = lval_wrap_symn(sym, strlen(sym));
+    mbench_time(name, mbench_get, &mbench);
+    mbench.lval->icache = licache_new();
+    mbench_time(cached, mbench_get, &mbench);
+    lval_del(mbench.lval);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [FILTER]\n", argv[0]);
+        return 1;
+    }
+    mbench_filter = argc == 2 ? argv[1] : NULL;
+    parser_init();
+
+    mpc_ast_t *asts[MBENCH_SHAPES];
+    LVal *trees[MBENCH_SHAPES];
+    asts[MBENCH_FLAT] = mbench_parse(mbench_flat(1000));
+    asts[MBENCH_DEEP] = mbench_parse(mbench_deep(100));
+    asts[MBENCH_STRS] = mbench_parse(mbench_strs(1000));
+    asts[MBENCH_PROGRAM] = mbench_parse(mbench_program(100));
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        trees[i] = lval_read_ast(asts[i]);
+    }
+
+    printf("%-28s %12s %12s\n", "primitive", "ns/op", "allocs/op");
+    char name[64];
+    MBench mbench;
+
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        snprintf(name, sizeof(name), "read+del/%s", mbench_shapes[i]);
+        mbench.ast = asts[i];
+        mbench_time(name, mbench_read, &mbench);
+    }
+
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        snprintf(name, sizeof(name), "copy+del/%s", mbench_shapes[i]);
+        mbench.lval = trees[i];
+        mbench_time(name, mbench_copy, &mbench);
+    }
+
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        snprintf(name, sizeof(name), "eq/%s", mbench_shapes[i]);
+        mbench.lval = trees[i];
+        mbench.other = lval_copy(trees[i]);
+        mbench_time(name, mbench_eq, &mbench);
+        lval_del(mbench.other);
+    }
+
+    lbuf_init_str(&mbench.lbuf);
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        snprintf(name, sizeof(name), "print/%s", mbench_shapes[i]);
+        mbench.lval = trees[i];
+        mbench_time(name, mbench_print, &mbench);
+    }
+    lbuf_free(&mbench.lbuf);
+
+    // The last bound name is the one scanned for longest
+    static const int sizes[] = {16, 256, 4096};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        LEnv *lenv = mbench_globals(sizes[i]);
+        char sym[32];
+        snprintf(sym, sizeof(sym), "v%d", sizes[i] - 1);
+        snprintf(name, sizeof(name), "get/globals-%d", sizes[i]);
+        mbench_time_get(name, lenv, sym);
+        lenv_del(lenv);
+    }
+
+    // Globals looked up through locals, which are searched first
+    static const int depths[] = {1, 8, 64};
+    LEnv *root = mbench_globals(16);
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        LEnv *lenv = mbench_locals(root, depths[i]);
+        snprintf(name, sizeof(name), "get/depth-%d", depths[i]);
+        mbench_time_get(name, lenv, "v0");
+        mbench_locals_del(lenv, root);
+    }
+
+    LVal *lplus = lval_wrap_symn("+", 1);
+    mbench.lenv = root;
+    mbench.lfun = lenv_get(root, lplus);
+    static const int counts[] = {2, 16, MBENCH_MAX_OPERANDS};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        snprintf(name, sizeof(name), "op+/%d-operands", counts[i]);
+        mbench.count = counts[i];
+        mbench_time(name, mbench_op, &mbench);
+    }
+    lval_del(mbench.lfun);
+    lval_del(lplus);
+    lenv_del(root);
+
+    for (int i = 0; i < MBENCH_SHAPES; i++) {
+        lval_del(trees[i]);
+        mpc_ast_delete(asts[i]);
+    }
+    parser_cleanup();
+    return 0;
+}
@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+# Time every bench/*.lspy interpreted, with the JIT and compiled by lispyc
+# Usage: bench/run.sh [path to prompt], lispyc and liblispy.a are expected
+# next to it
+prompt=${1:-./prompt}
+root=$(dirname "$prompt")
+aot=$(mktemp -d)
+trap 'rm -rf "$aot"' EXIT
+TIMEFORMAT=%R
+
+printf '%-16s %10s %10s %10s\n' benchmark interpret jit aot
+for bench in "$(dirname "$0")"/*.lspy; do
+    name=$(basename "$bench" .lspy)
+    "$root/lispyc" "$bench" -o "$aot/$name.c"
+    ${CC:-gcc} -O2 -I"$root" -o "$aot/$name" "$aot/$name.c" \
+        "$root/liblispy.a" -pthread
+    interpret=$({ time "$prompt" --no-jit "$bench" >/dev/null; } 2>&1)
+    jit=$({ time "$prompt" "$bench" >/dev/null; } 2>&1)
+    compiled=$({ time "$aot/$name" >/dev/null; } 2>&1)
+    printf '%-16s %9ss %9ss %9ss\n' "$name" "$interpret" "$jit" "$compiled"
+done
@@ -0,0 +1,754 @@
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "lbuf.h"
+#include "ltask.h"
+
+#ifdef LISPY_NO_JIT
+
+int ljit_enabled = 0;
+
+#else
+
+int ljit_enabled = 1;
+
+// Held while compiling, so OS threads running tasks which find the same
+// lambda hot compile it once
+static pthread_mutex_t ljit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Deepest expression compiled, deeper lambdas are interpreted */
+#define LJIT_MAX_DEPTH 256
+
+/* Builtins compiled inline */
+enum {
+    LJIT_OP_ADD,
+    LJIT_OP_SUB,
+    LJIT_OP_MUL,
+    LJIT_OP_DIV,
+    LJIT_OP_MOD,
+    LJIT_OP_LT,
+    LJIT_OP_GT,
+    LJIT_OP_LE,
+    LJIT_OP_GE,
+    LJIT_OP_EQ,
+    LJIT_OP_NE,
+    LJIT_OP_IF
+};
+
+// Condition codes (low nibble of jcc/setcc) of comparisons, and their negation
+static const struct {
+    const char *sym;
+    int op;
+    unsigned char cc;
+    unsigned char not_cc;
+} ljit_ops[] = {
+    {"+", LJIT_OP_ADD, 0, 0},       {"-", LJIT_OP_SUB, 0, 0},
+    {"*", LJIT_OP_MUL, 0, 0},       {"/", LJIT_OP_DIV, 0, 0},
+    {"%", LJIT_OP_MOD, 0, 0},       {"<", LJIT_OP_LT, 0xC, 0xD},
+    {">", LJIT_OP_GT, 0xF, 0xE},    {"<=", LJIT_OP_LE, 0xE, 0xF},
+    {">=", LJIT_OP_GE, 0xD, 0xC},   {"==", LJIT_OP_EQ, 0x4, 0x5},
+    {"!=", LJIT_OP_NE, 0x5, 0x4},   {"if", LJIT_OP_IF, 0, 0},
+};
+
+#define LJIT_OP_COUNT (int)(sizeof(ljit_ops) / sizeof(ljit_ops[0]))
+
+/* Condition codes used directly */
+#define LJIT_CC_O 0x0
+#define LJIT_CC_B 0x2
+#define LJIT_CC_E 0x4
+#define LJIT_CC_NE 0x5
+
+/**
+ * @brief  State of compiling a single lambda
+ * @note   Code is emitted as a stack machine: every expression leaves its
+ *         value in rax, pending operands are pushed. rbx points to the
+ *         arguments, r12 to the result and r13 holds the stack limit
+ */
+typedef struct LJitCompiler {
+    LBuf code;
+    LJit *ljit;
+    LVal *lformals;
+    LEnv *root;
+
+    /* Offsets of rel32's to be patched with the bail out */
+    size_t *bails;
+    int bail_count;
+
+    int depth;
+} LJitCompiler;
+
+#define LJIT_EMIT(c, ...)                              \
+    ljit_emit(c, (const unsigned char[]){__VA_ARGS__}, \
+              sizeof((const unsigned char[]){__VA_ARGS__}))
+
+static void ljit_emit(LJitCompiler *c, const unsigned char *bytes,
+                      size_t len) {
+    lbuf_putn(&c->code, (const char *)bytes, len);
+}
+
+// x86-64 is little endian, as are the immediates
+static void ljit_emit_u32(LJitCompiler *c, uint32_t u32) {
+    lbuf_putn(&c->code, (const char *)&u32, sizeof(u32));
+}
+
+static void ljit_emit_u64(LJitCompiler *c, uint64_t u64) {
+    lbuf_putn(&c->code, (const char *)&u64, sizeof(u64));
+}
+
+// Point the rel32 at `at` to `target`
+static void ljit_patch(LJitCompiler *c, size_t at, size_t target) {
+    int32_t rel = (int32_t)((long)target - (long)(at + 4));
+    memcpy(c->code.data + at, &rel, sizeof(rel));
+}
+
+// Emit a jump (or conditional jump unless `cc` is negative), returning the
+// offset of its rel32 to be patched
+static size_t ljit_emit_jump(LJitCompiler *c, int cc) {
+    if (cc < 0) {
+        LJIT_EMIT(c, 0xE9);
+    } else {
+        LJIT_EMIT(c, 0x0F, (unsigned char)(0x80 | cc));
+    }
+    size_t at = c->code.len;
+    ljit_emit_u32(c, 0);
+    return at;
+}
+
+static void ljit_emit_bail(LJitCompiler *c, int cc) {
+    size_t at = ljit_emit_jump(c, cc);
+    c->bails = realloc(c->bails, sizeof(size_t) * (c->bail_count + 1));
+    c->bails[c->bail_count++] = at;
+}
+
+// mov rax/rcx, imm
+static void ljit_emit_imm(LJitCompiler *c, int rcx, long num) {
+    if (num >= INT32_MIN && num <= INT32_MAX) {
+        LJIT_EMIT(c, 0x48, 0xC7, rcx ? 0xC1 : 0xC0);
+        ljit_emit_u32(c, (uint32_t)num);
+    } else {
+        LJIT_EMIT(c, 0x48, rcx ? 0xB9 : 0xB8);
+        ljit_emit_u64(c, (uint64_t)num);
+    }
+}
+
+// mov rax/rcx, [rbx + 8 * index]
+static void ljit_emit_arg(LJitCompiler *c, int rcx, int index) {
+    LJIT_EMIT(c, 0x48, 0x8B, rcx ? 0x4B : 0x43, (unsigned char)(8 * index));
+}
+
+static int ljit_formal(LJitCompiler *c, LVal *lsym) {
+    for (int i = 0; i < c->lformals->child_count; i++) {
+        if (strcmp(c->lformals->children[i]->sym, lsym->sym) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Value of a name in the global LEnv, or NULL
+static LVal *ljit_lookup(LJitCompiler *c, LVal *lsym) {
+    return lenv_get_global(c->root, lsym->sym);
+}
+
+// Index in ljit_ops of a builtin applied by `lsym`, or -1
+static int ljit_op(LJitCompiler *c, LVal *lsym) {
+    if (lsym->type != LVAL_SYM || ljit_formal(c, lsym) >= 0) {
+        return -1;
+    }
+    for (int i = 0; i < LJIT_OP_COUNT; i++) {
+        if (strcmp(ljit_ops[i].sym, lsym->sym) == 0) {
+            // The builtin must still be bound, lenv_fold_shadows being 0
+            // tells that it is bound to nothing else
+            LVal *lfun = ljit_lookup(c, lsym);
+            if (!lfun || lfun->type != LVAL_FUN || !lfun->lbuiltin) {
+                return -1;
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Value of a global name the code depends on, which is recorded, or NULL
+static LVal *ljit_global(LJitCompiler *c, LVal *lsym) {
+    // Builtins are left to the guard on lenv_fold_shadows
+    int slot = lenv_index(c->root, lsym->sym);
+    if (slot < 0) {
+        return NULL;
+    }
+    LVal *lglobal = c->root->lvals[slot];
+
+    LJit *ljit = c->ljit;
+    for (int i = 0; i < ljit->name_count; i++) {
+        if (strcmp(ljit->names[i], lsym->sym) == 0) {
+            return lglobal;
+        }
+    }
+    ljit->names =
+        realloc(ljit->names, sizeof(char *) * (ljit->name_count + 1));
+    ljit->slots = realloc(ljit->slots, sizeof(int) * (ljit->name_count + 1));
+    ljit->names[ljit->name_count] = malloc(lsym->len + 1);
+    memcpy(ljit->names[ljit->name_count], lsym->sym, lsym->len + 1);
+    ljit->slots[ljit->name_count] = slot;
+    ljit->name_count += 1;
+    return lglobal;
+}
+
+// A number or a formal, which is loaded without disturbing rax
+static int ljit_is_leaf(LJitCompiler *c, LVal *lval) {
+    return lval->type == LVAL_NUM ||
+           (lval->type == LVAL_SYM && ljit_formal(c, lval) >= 0);
+}
+
+static int ljit_compile_expr(LJitCompiler *c, LVal *lval);
+static int ljit_compile_sexpr(LJitCompiler *c, LVal *lval);
+
+// Compile the second operand of a binary operation into rcx, keeping rax
+static int ljit_compile_rcx(LJitCompiler *c, LVal *lval) {
+    if (lval->type == LVAL_NUM) {
+        ljit_emit_imm(c, 1, lval->num);
+        return 1;
+    }
+    if (ljit_is_leaf(c, lval)) {
+        ljit_emit_arg(c, 1, ljit_formal(c, lval));
+        return 1;
+    }
+
+    LJIT_EMIT(c, 0x50);  // push rax
+    if (!ljit_compile_expr(c, lval)) {
+        return 0;
+    }
+    LJIT_EMIT(c, 0x48, 0x89, 0xC1);  // mov rcx, rax
+    LJIT_EMIT(c, 0x58);              // pop rax
+    return 1;
+}
+
+static int ljit_compile_arith(LJitCompiler *c, int op, LVal **args,
+                              int count) {
+    if (!ljit_compile_expr(c, args[0])) {
+        return 0;
+    }
+
+    // Negation by a lone `-`
+    if (op == LJIT_OP_SUB && count == 1) {
+        LJIT_EMIT(c, 0x48, 0xF7, 0xD8);  // neg rax
+        ljit_emit_bail(c, LJIT_CC_O);
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (!ljit_compile_rcx(c, args[i])) {
+            return 0;
+        }
+        switch (op) {
+            case LJIT_OP_ADD:
+                LJIT_EMIT(c, 0x48, 0x01, 0xC8);  // add rax, rcx
+                ljit_emit_bail(c, LJIT_CC_O);
+                break;
+            case LJIT_OP_SUB:
+                LJIT_EMIT(c, 0x48, 0x29, 0xC8);  // sub rax, rcx
+                ljit_emit_bail(c, LJIT_CC_O);
+                break;
+            case LJIT_OP_MUL:
+                LJIT_EMIT(c, 0x48, 0x0F, 0xAF, 0xC1);  // imul rax, rcx
+                ljit_emit_bail(c, LJIT_CC_O);
+                break;
+            case LJIT_OP_DIV:
+            case LJIT_OP_MOD:
+                // idiv traps on 0 and on LONG_MIN / -1, known divisors other
+                // than those need no checks
+                if (args[i]->type != LVAL_NUM || args[i]->num == 0 ||
+                    args[i]->num == -1) {
+                    LJIT_EMIT(c, 0x48, 0x85, 0xC9);  // test rcx, rcx
+                    ljit_emit_bail(c, LJIT_CC_E);
+                    LJIT_EMIT(c, 0x48, 0x83, 0xF9, 0xFF);  // cmp rcx, -1
+                    ljit_emit_bail(c, LJIT_CC_E);
+                }
+                LJIT_EMIT(c, 0x48, 0x99);        // cqo
+                LJIT_EMIT(c, 0x48, 0xF7, 0xF9);  // idiv rcx
+                if (op == LJIT_OP_MOD) {
+                    LJIT_EMIT(c, 0x48, 0x89, 0xD0);  // mov rax, rdx
+                }
+                break;
+        }
+    }
+    return 1;
+}
+
+// Compare the operands, leaving the flags set
+static int ljit_compile_cmp(LJitCompiler *c, LVal **args, int count) {
+    if (count != 2) {
+        return 0;
+    }
+    if (!ljit_compile_expr(c, args[0]) || !ljit_compile_rcx(c, args[1])) {
+        return 0;
+    }
+    LJIT_EMIT(c, 0x48, 0x39, 0xC8);  // cmp rax, rcx
+    return 1;
+}
+
+// An `if` branch, a Q-Expression evaluated as a S-Expression
+static int ljit_compile_branch(LJitCompiler *c, LVal *lval) {
+    return lval->type == LVAL_QEXPR && ljit_compile_sexpr(c, lval);
+}
+
+static int ljit_compile_if(LJitCompiler *c, LVal **args, int count) {
+    if (count != 3) {
+        return 0;
+    }
+
+    // Jump on comparisons directly rather than on their 0/1 result
+    LVal *cond = args[0];
+    int op = -1;
+    if (cond->type == LVAL_SEXPR && cond->child_count > 1) {
+        op = ljit_op(c, cond->children[0]);
+    }
+
+    size_t to_else;
+    if (op >= 0 && ljit_ops[op].cc) {
+        if (!ljit_compile_cmp(c, cond->children + 1, cond->child_count - 1)) {
+            return 0;
+        }
+        to_else = ljit_emit_jump(c, ljit_ops[op].not_cc);
+    } else {
+        if (!ljit_compile_expr(c, cond)) {
+            return 0;
+        }
+        LJIT_EMIT(c, 0x48, 0x85, 0xC0);  // test rax, rax
+        to_else = ljit_emit_jump(c, LJIT_CC_E);
+    }
+
+    if (!ljit_compile_branch(c, args[1])) {
+        return 0;
+    }
+    size_t to_end = ljit_emit_jump(c, -1);
+    ljit_patch(c, to_else, c->code.len);
+    if (!ljit_compile_branch(c, args[2])) {
+        return 0;
+    }
+    ljit_patch(c, to_end, c->code.len);
+    return 1;
+}
+
+// Call the code being compiled with the arguments pushed on the stack
+static int ljit_compile_self(LJitCompiler *c, LVal **args, int count) {
+    if (count != c->lformals->child_count) {
+        return 0;
+    }
+
+    // Pushed last to first, so they lie in order from rsp upwards
+    for (int i = count - 1; i >= 0; i--) {
+        if (!ljit_compile_expr(c, args[i])) {
+            return 0;
+        }
+        LJIT_EMIT(c, 0x50);  // push rax
+    }
+
+    LJIT_EMIT(c, 0x48, 0x83, 0xEC, 0x08);        // sub rsp, 8
+    LJIT_EMIT(c, 0x48, 0x8D, 0x7C, 0x24, 0x08);  // lea rdi, [rsp + 8]
+    LJIT_EMIT(c, 0x48, 0x89, 0xE6);              // mov rsi, rsp
+    LJIT_EMIT(c, 0x4C, 0x89, 0xEA);              // mov rdx, r13
+    LJIT_EMIT(c, 0xE8);                          // call start
+    ljit_emit_u32(c, 0);
+    ljit_patch(c, c->code.len - 4, 0);
+    LJIT_EMIT(c, 0x85, 0xC0);  // test eax, eax
+    ljit_emit_bail(c, LJIT_CC_NE);
+    LJIT_EMIT(c, 0x58);  // pop rax
+    if (count > 0) {
+        LJIT_EMIT(c, 0x48, 0x83, 0xC4, (unsigned char)(8 * count));
+    }
+    return 1;
+}
+
+// A S-Expression (or a body) applying a builtin or the lambda itself
+static int ljit_compile_sexpr(LJitCompiler *c, LVal *lval) {
+    if (lval->child_count == 0) {
+        return 0;
+    }
+    if (lval->child_count == 1) {
+        return ljit_compile_expr(c, lval->children[0]);
+    }
+
+    LVal *lhead = lval->children[0];
+    if (lhead->type != LVAL_SYM || ljit_formal(c, lhead) >= 0) {
+        return 0;
+    }
+    LVal **args = lval->children + 1;
+    int count = lval->child_count - 1;
+
+    int op = ljit_op(c, lhead);
+    if (op >= 0) {
+        switch (ljit_ops[op].op) {
+            case LJIT_OP_IF:
+                return ljit_compile_if(c, args, count);
+            case LJIT_OP_ADD:
+            case LJIT_OP_SUB:
+            case LJIT_OP_MUL:
+            case LJIT_OP_DIV:
+            case LJIT_OP_MOD:
+                return ljit_compile_arith(c, ljit_ops[op].op, args, count);
+            default:
+                if (!ljit_compile_cmp(c, args, count)) {
+                    return 0;
+                }
+                // setcc al, movzx eax, al
+                LJIT_EMIT(c, 0x0F, (unsigned char)(0x90 | ljit_ops[op].cc),
+                          0xC0);
+                LJIT_EMIT(c, 0x0F, 0xB6, 0xC0);
+                return 1;
+        }
+    }
+
+    LVal *lfun = ljit_global(c, lhead);
+    if (lfun && lfun->type == LVAL_FUN && lfun->ljit == c->ljit &&
+        lfun->lenv->child_count == 0) {
+        return ljit_compile_self(c, args, count);
+    }
+    return 0;
+}
+
+static int ljit_compile_expr(LJitCompiler *c, LVal *lval) {
+    if (++c->depth > LJIT_MAX_DEPTH) {
+        return 0;
+    }
+
+    int ok = 0;
+    switch (lval->type) {
+        case LVAL_NUM:
+            ljit_emit_imm(c, 0, lval->num);
+            ok = 1;
+            break;
+        case LVAL_SYM: {
+            int index = ljit_formal(c, lval);
+            if (index >= 0) {
+                ljit_emit_arg(c, 0, index);
+                ok = 1;
+                break;
+            }
+            // Global numbers are compiled in as constants
+            LVal *lglobal = ljit_global(c, lval);
+            if (lglobal && lglobal->type == LVAL_NUM) {
+                ljit_emit_imm(c, 0, lglobal->num);
+                ok = 1;
+            }
+            break;
+        }
+        case LVAL_SEXPR:
+            ok = ljit_compile_sexpr(c, lval);
+            break;
+    }
+
+    c->depth -= 1;
+    return ok;
+}
+
+#endif /* LISPY_NO_JIT */
+
+// Unmap the code and forget its dependencies, code attached by ljit_attach
+// is not mapped by the JIT
+static void ljit_release(LJit *ljit) {
+    if (ljit->code) {
+        munmap(ljit->code, ljit->size);
+    }
+    for (int i = 0; i < ljit->name_count; i++) {
+        free(ljit->names[i]);
+    }
+    free(ljit->names);
+    free(ljit->slots);
+
+    ljit->code = NULL;
+    ljit->fn = NULL;
+    ljit->names = NULL;
+    ljit->slots = NULL;
+    ljit->name_count = 0;
+    __atomic_store_n(&ljit->state, LJIT_COLD, __ATOMIC_RELAXED);
+    __atomic_store_n(&ljit->calls, 0, __ATOMIC_RELAXED);
+}
+
+#ifdef LISPY_NO_JIT
+
+// Nothing is compiled, lambdas only run code given to ljit_attach
+static int ljit_hot(LJit *ljit, LVal *lfun, LEnv *root) {
+    (void)ljit;
+    (void)lfun;
+    (void)root;
+    return 0;
+}
+
+#else
+
+static int ljit_compile(LJit *ljit, LVal *lfun, LEnv *root) {
+    LVal *lformals = lfun->lformals;
+    if (lformals->child_count > LJIT_MAX_ARGS) {
+        return 0;
+    }
+    // `&` and repeated formals are left to the interpreter
+    for (int i = 0; i < lformals->child_count; i++) {
+        if (strcmp(lformals->children[i]->sym, "&") == 0) {
+            return 0;
+        }
+        for (int j = 0; j < i; j++) {
+            if (strcmp(lformals->children[i]->sym,
+                       lformals->children[j]->sym) == 0) {
+                return 0;
+            }
+        }
+    }
+
+    LJitCompiler c;
+    lbuf_init_str(&c.code);
+    c.ljit = ljit;
+    c.lformals = lformals;
+    c.root = root;
+    c.bails = NULL;
+    c.bail_count = 0;
+    c.depth = 0;
+
+    ljit->root = root;
+    ljit->stamp = LATOMIC_GET(lenv_version_clock);
+
+    // Prologue, rbp keeps rsp to unwind pushed operands on bail outs
+    LJIT_EMIT(&c, 0x53, 0x41, 0x54, 0x41, 0x55, 0x55);  // push rbx,r12,r13,rbp
+    LJIT_EMIT(&c, 0x48, 0x89, 0xE5);                    // mov rbp, rsp
+    LJIT_EMIT(&c, 0x48, 0x89, 0xFB);                    // mov rbx, rdi
+    LJIT_EMIT(&c, 0x49, 0x89, 0xF4);                    // mov r12, rsi
+    LJIT_EMIT(&c, 0x49, 0x89, 0xD5);                    // mov r13, rdx
+    LJIT_EMIT(&c, 0x4C, 0x39, 0xEC);                    // cmp rsp, r13
+    ljit_emit_bail(&c, LJIT_CC_B);
+
+    LVal *lbody = lfun->lbody;
+    int ok = lbody->type == LVAL_QEXPR && ljit_compile_sexpr(&c, lbody);
+
+    LJIT_EMIT(&c, 0x49, 0x89, 0x04, 0x24);  // mov [r12], rax
+    LJIT_EMIT(&c, 0x31, 0xC0);              // xor eax, eax
+    size_t epilogue = c.code.len;
+    LJIT_EMIT(&c, 0x48, 0x89, 0xEC);        // mov rsp, rbp
+    LJIT_EMIT(&c, 0x5D, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+    size_t bail = c.code.len;
+    LJIT_EMIT(&c, 0xB8, 0x01, 0x00, 0x00, 0x00);  // mov eax, 1
+    ljit_patch(&c, ljit_emit_jump(&c, -1), epilogue);
+
+    for (int i = 0; i < c.bail_count; i++) {
+        ljit_patch(&c, c.bails[i], bail);
+    }
+    free(c.bails);
+
+    // Mapped writable for copying in, then only executable
+    if (ok) {
+        void *code = mmap(NULL, c.code.len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            ok = 0;
+        } else {
+            memcpy(code, c.code.data, c.code.len);
+            ljit->code = code;
+            ljit->size = c.code.len;
+            ok = mprotect(code, c.code.len, PROT_READ | PROT_EXEC) == 0;
+        }
+    }
+    lbuf_free(&c.code);
+
+    if (!ok) {
+        ljit_release(ljit);
+        return 0;
+    }
+    // ISO C has no conversion from object to function pointers
+    memcpy(&ljit->fn, &ljit->code, sizeof(ljit->fn));
+    // Publishes the code to OS threads running tasks
+    __atomic_store_n(&ljit->state, LJIT_NATIVE, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Compile a lambda which got hot, or find it compiled by another OS thread
+static int ljit_hot(LJit *ljit, LVal *lfun, LEnv *root) {
+    pthread_mutex_lock(&ljit_lock);
+    int state = __atomic_load_n(&ljit->state, __ATOMIC_ACQUIRE);
+    if (state == LJIT_COLD) {
+        state = LJIT_INTERPRET;
+        if (++ljit->compiles <= LJIT_MAX_COMPILES &&
+            ljit_compile(ljit, lfun, root)) {
+            state = LJIT_NATIVE;
+        }
+        __atomic_store_n(&ljit->state, state, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&ljit_lock);
+    return state == LJIT_NATIVE;
+}
+
+#endif /* LISPY_NO_JIT */
+
+// Whether a LEnv between the caller and the global LEnv binds a name the
+// code depends on, which dynamic scoping would make it resolve to instead
+static int ljit_shadowed(LJit *ljit, LEnv *lenv) {
+    for (; lenv->parent; lenv = lenv->parent) {
+        for (int i = 0; i < lenv->child_count; i++) {
+            for (int j = 0; j < ljit->name_count; j++) {
+                if (strcmp(lenv->syms[i], ljit->names[j]) == 0) {
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Whether a name the code depends on was bound again in `root`, which may
+// have fewer bindings if it is another LEnv at the same address
+static int ljit_rebound(LJit *ljit, LEnv *root) {
+    for (int i = 0; i < ljit->name_count; i++) {
+        int slot = ljit->slots[i];
+        if (slot >= root->child_count || root->stamps[slot] > ljit->stamp) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static LJit *ljit_alloc(void) {
+    LJit *ljit = malloc(sizeof(LJit));
+    ljit->refs = 1;
+    ljit->state = LJIT_COLD;
+    ljit->calls = 0;
+    ljit->bails = 0;
+    ljit->compiles = 0;
+    ljit->code = NULL;
+    ljit->size = 0;
+    ljit->fn = NULL;
+    ljit->root = NULL;
+    ljit->stamp = 0;
+    ljit->names = NULL;
+    ljit->slots = NULL;
+    ljit->name_count = 0;
+    return ljit;
+}
+
+LJit *ljit_new(void) { return ljit_enabled ? ljit_alloc() : NULL; }
+
+void ljit_del(LJit *ljit) {
+    if (!ljit || LATOMIC_ADD(ljit->refs, -1) > 0) {
+        return;
+    }
+    ljit_release(ljit);
+    free(ljit);
+}
+
+LVal *ljit_call(LEnv *lenv, LVal *lfun, int argc, LVal **argv) {
+    LJit *ljit = lfun->ljit;
+    if (!ljit) {
+        return NULL;
+    }
+    int state = __atomic_load_n(&ljit->state, __ATOMIC_ACQUIRE);
+    if (state == LJIT_INTERPRET) {
+        return NULL;
+    }
+
+    // Type guards, only complete calls with numbers are compiled
+    int count = argc;
+    if (count != lfun->lformals->child_count || count > LJIT_MAX_ARGS ||
+        lfun->lenv->child_count > 0) {
+        return NULL;
+    }
+    long args[LJIT_MAX_ARGS];
+    for (int i = 0; i < count; i++) {
+        if (argv[i]->type != LVAL_NUM) {
+            return NULL;
+        }
+        args[i] = argv[i]->num;
+    }
+
+    // Builtins are compiled in, which is valid only while none is shadowed
+    if (LATOMIC_GET(lenv_fold_shadows)) {
+        return NULL;
+    }
+
+    // While tasks run, lambdas are shared by OS threads. Calls are counted
+    // and compiled as usual (@see ljit_hot), but native code is never
+    // released or given up on, as another OS thread may be running it
+    int shared = ltask_busy();
+
+    LEnv *root = lenv;
+    while (root->parent) {
+        root = root->parent;
+    }
+
+    // Global values compiled in may have changed, compile again once hot.
+    // The global LEnv is read only while tasks run
+    if (state == LJIT_NATIVE && ljit->name_count > 0 &&
+        (ljit->root != root || ljit_rebound(ljit, root))) {
+        if (shared) {
+            return NULL;
+        }
+        ljit_release(ljit);
+        state = LJIT_COLD;
+    }
+
+    if (state == LJIT_COLD) {
+        // Only there for attached code, which has been dropped
+        if (!ljit_enabled) {
+            return NULL;
+        }
+        if (LATOMIC_ADD(ljit->calls, 1) < LJIT_THRESHOLD ||
+            !ljit_hot(ljit, lfun, root)) {
+            return NULL;
+        }
+    }
+
+    if (ljit->name_count > 0 && ljit_shadowed(ljit, lenv)) {
+        return NULL;
+    }
+
+    // Leave the stack below LJIT_STACK from here to the interpreter
+    char marker;
+    uintptr_t limit = (uintptr_t)&marker - LJIT_STACK;
+
+    long result;
+    if (ljit->fn(args, &result, limit) != 0) {
+        // Interpreted again from the start, compiled code has no side effects
+        if (!shared && ++ljit->bails == LJIT_MAX_BAILS) {
+            ljit_release(ljit);
+            ljit->state = LJIT_INTERPRET;
+        }
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        lval_del(argv[i]);
+    }
+    return lval_wrap_long(result);
+}
+
+int ljit_attach(LVal *lfun, LEnv *root, LJitFn fn, const char *const *names,
+                int count) {
+    if (!lfun->ljit) {
+        lfun->ljit = ljit_alloc();
+    }
+    LJit *ljit = lfun->ljit;
+    if (ljit->state == LJIT_NATIVE && ljit->fn == fn && ljit->root == root &&
+        !ljit_rebound(ljit, root)) {
+        return 1;
+    }
+
+    ljit_release(ljit);
+    for (int i = 0; i < count; i++) {
+        if (lenv_index(root, names[i]) < 0) {
+            return 0;
+        }
+    }
+    ljit->names = malloc(sizeof(char *) * (size_t)count);
+    ljit->slots = malloc(sizeof(int) * (size_t)count);
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(names[i]);
+        ljit->names[i] = malloc(len + 1);
+        memcpy(ljit->names[i], names[i], len + 1);
+        ljit->slots[i] = lenv_index(root, names[i]);
+    }
+    ljit->name_count = count;
+    ljit->root = root;
+    ljit->stamp = LATOMIC_GET(lenv_version_clock);
+    ljit->fn = fn;
+    ljit->state = LJIT_NATIVE;
+    return 1;
+}
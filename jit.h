@@ -0,0 +1,117 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lval.h"
+
+/* Native code is only emitted for x86-64, elsewhere lambdas are interpreted */
+#if !defined(__x86_64__) && !defined(LISPY_NO_JIT)
+#define LISPY_NO_JIT
+#endif
+
+/* Calls of a lambda (with numbers for all its formals) before it's compiled */
+#define LJIT_THRESHOLD 64
+/* Most formals of a compiled lambda */
+#define LJIT_MAX_ARGS 8
+/* Native stack a compiled lambda may recurse into before bailing out */
+#define LJIT_STACK (1 << 20)
+/* Bail outs or recompilations after which a lambda is only interpreted */
+#define LJIT_MAX_BAILS 64
+#define LJIT_MAX_COMPILES 8
+
+/* LJit States */
+enum {
+    LJIT_COLD,     /* Counting calls towards LJIT_THRESHOLD */
+    LJIT_NATIVE,   /* Compiled, `fn` is called instead of interpreting */
+    LJIT_INTERPRET /* Not compilable (or not worth it), never retried */
+};
+
+/**
+ * @brief  Signature of a compiled lambda
+ * @param  *args: Numbers bound to the formals, in order
+ * @param  *result: Set to the result on success
+ * @param  limit: Lowest address the native stack may grow to
+ * @retval 0 on success, else a guard failed (overflow, division by 0 or -1,
+ *         stack exhausted) and the call has to be interpreted instead
+ */
+typedef int (*LJitFn)(const long *args, long *result, uintptr_t limit);
+
+/**
+ * @brief  Native code of a lambda, shared (and reference counted) by all
+ *         copies of the lambda, so calls through any copy count towards
+ *         compiling it and run the compiled code
+ * @note   Compiled lambdas take and return unboxed longs. Supported are
+ *         numbers, formals, global numbers, `+ - * / %`, comparisons, `if`
+ *         and calls of the lambda itself through a global name
+ */
+struct LJit {
+    int refs;
+    int state;
+
+    long calls;
+    int bails;
+    int compiles;
+
+    /* Executable mapping holding the code, `fn` points to its start */
+    void *code;
+    size_t size;
+    LJitFn fn;
+
+    /* Global names whose values were compiled in and their indices in the
+     * global LEnv, valid as long as none was bound again since `stamp` and
+     * no LEnv in between binds them */
+    LEnv *root;
+    unsigned long stamp;
+    char **names;
+    int *slots;
+    int name_count;
+};
+
+/* 0 if lambdas must never be compiled, set before any lambda is created */
+extern int ljit_enabled;
+
+/**
+ * @brief  Create the LJit of a new lambda
+ * @retval A LJit with a single reference, or NULL if the JIT is disabled
+ */
+LJit *ljit_new(void);
+
+/**
+ * @brief  Drop a reference to a LJit, unmapping its code with the last one
+ * @param  *ljit: A LJit, may be NULL
+ * @retval None
+ */
+void ljit_del(LJit *ljit);
+
+/**
+ * @brief  Call a lambda natively if it's compiled (or hot enough to compile)
+ *         and all arguments are numbers
+ * @note   Counts the call towards compiling the lambda, guards against
+ *         bindings which changed since compiling it
+ * @param  *lenv: The calling LEnv
+ * @param  *lfun: A lambda
+ * @param  argc: Number of arguments
+ * @param  **argv: Arguments, consumed only on success but never the vector
+ * @retval The result, or NULL if the call has to be interpreted
+ */
+LVal *ljit_call(LEnv *lenv, LVal *lfun, int argc, LVal **argv);
+
+/**
+ * @brief  Make a lambda run code compiled ahead of time (@see laot.h)
+ * @note   The code is called like compiled code, under the same guards, and
+ *         dropped once a global it depends on changes, after which the
+ *         lambda is compiled (or interpreted) as usual
+ * @param  *lfun: A lambda, whose code must compute what its body evaluates to
+ * @param  *root: The global LEnv
+ * @param  fn: The code
+ * @param  **names: Global names whose values the code depends on
+ * @param  count: Number of `names`
+ * @note   Works without the JIT as well (eg: `make JIT=0`), compiled code
+ *         being portable C
+ * @retval 1 if the lambda runs `fn` from now on, 0 if a name is unbound
+ */
+int ljit_attach(LVal *lfun, LEnv *root, LJitFn fn, const char *const *names,
+                int count);
+
+#endif /* jit.h */
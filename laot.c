@@ -0,0 +1,162 @@
+#include "laot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lser.h"
+#include "ltask.h"
+#include "parser.h"
+
+/**
+ * @brief  State of running a compiled program
+ */
+typedef struct LAot {
+    const LAotProgram *program;
+    /* Formals and body of every compiled lambda, decoded */
+    LVal **lsrcs;
+    /* Global names compiled into every lambda, handed to ljit_attach */
+    const char ***names;
+    int *name_counts;
+
+    /* Stamp of the global LEnv lambdas were last attached at */
+    int attached;
+    unsigned long stamp;
+} LAot;
+
+// Whether a dependency is bound to what the code was compiled for
+static int laot_bound(LAot *laot, LEnv *root, const LAotDep *dep) {
+    LVal *lval = lenv_get_global(root, dep->sym);
+    if (!lval) {
+        return 0;
+    }
+
+    switch (dep->kind) {
+        case LAOT_NUM:
+            return lval->type == LVAL_NUM && lval->num == dep->num;
+        case LAOT_BUILTIN:
+            return lval->type == LVAL_FUN && lval->lbuiltin;
+        default: {
+            LVal *lsrc = laot->lsrcs[dep->num];
+            return lval->type == LVAL_FUN && !lval->lbuiltin &&
+                   lval->lenv->child_count == 0 &&
+                   lval_eq(lval->lformals, lsrc->children[0]) &&
+                   lval_eq(lval->lbody, lsrc->children[1]);
+        }
+    }
+}
+
+// Attach compiled lambdas to the lambdas bound as they were compiled, once
+// per change of the global LEnv
+static void laot_attach(LEnv *lenv, void *ctx) {
+    LAot *laot = ctx;
+    LEnv *root = lenv;
+    while (root->parent) {
+        root = root->parent;
+    }
+
+    // Running tasks share the lambdas, they are attached after the next form
+    if (ltask_busy() || (laot->attached && laot->stamp == root->stamp)) {
+        return;
+    }
+
+    const LAotProgram *program = laot->program;
+    for (int i = 0; i < program->fun_count; i++) {
+        const LAotFun *fun = &program->funs[i];
+        int bound = 1;
+        for (int j = 0; bound && j < fun->dep_count; j++) {
+            bound = laot_bound(laot, root, &fun->deps[j]);
+        }
+        if (bound) {
+            ljit_attach(lenv_get_global(root, fun->sym), root, fun->fn,
+                        laot->names[i], laot->name_counts[i]);
+        }
+    }
+
+    laot->attached = 1;
+    laot->stamp = root->stamp;
+}
+
+static LVal *laot_decode(const unsigned char *bytes, size_t len) {
+    const char *cur = (const char *)bytes;
+    const char *end = cur + len;
+    LVal *lval = lser_decode(&cur, end);
+    if (lval && (cur != end || lval->type != LVAL_SEXPR)) {
+        lval_del(lval);
+        return NULL;
+    }
+    return lval;
+}
+
+int laot_run(LEnv *lenv, const LAotProgram *program) {
+    LVal *lforms = laot_decode(program->forms, program->forms_len);
+    if (!lforms) {
+        fprintf(stderr, "%s: malformed program\n", program->path);
+        return 1;
+    }
+
+    LAot laot;
+    laot.program = program;
+    laot.lsrcs = malloc(sizeof(LVal *) * (size_t)program->fun_count);
+    laot.names = malloc(sizeof(char **) * (size_t)program->fun_count);
+    laot.name_counts = malloc(sizeof(int) * (size_t)program->fun_count);
+    laot.attached = 0;
+    laot.stamp = 0;
+
+    int status = 0;
+    for (int i = 0; i < program->fun_count; i++) {
+        const LAotFun *fun = &program->funs[i];
+        laot.lsrcs[i] = laot_decode(fun->src, fun->src_len);
+        if (!laot.lsrcs[i] || laot.lsrcs[i]->child_count != 2) {
+            status = 1;
+        }
+
+        // Builtins are left to the guard on lenv_fold_shadows
+        laot.names[i] = malloc(sizeof(char *) * (size_t)fun->dep_count);
+        laot.name_counts[i] = 0;
+        for (int j = 0; j < fun->dep_count; j++) {
+            if (fun->deps[j].kind != LAOT_BUILTIN) {
+                laot.names[i][laot.name_counts[i]++] = fun->deps[j].sym;
+            }
+        }
+    }
+
+    if (status == 0) {
+        lval_eval_forms(lenv, lforms, laot_attach, &laot);
+    } else {
+        fprintf(stderr, "%s: malformed program\n", program->path);
+        lval_del(lforms);
+    }
+
+    for (int i = 0; i < program->fun_count; i++) {
+        if (laot.lsrcs[i]) {
+            lval_del(laot.lsrcs[i]);
+        }
+        free(laot.names[i]);
+    }
+    free(laot.lsrcs);
+    free(laot.names);
+    free(laot.name_counts);
+    return status;
+}
+
+int laot_main(const LAotProgram *program) {
+    parser_init();
+
+    const char *jit = getenv("LISPY_JIT");
+    if (jit && strcmp(jit, "0") == 0) {
+        ljit_enabled = 0;
+    }
+    const char *threads = getenv("LISPY_THREADS");
+    if (threads) {
+        ltask_threads = atoi(threads);
+    }
+
+    LEnv *lenv = lenv_new();
+
+    int status = laot_run(lenv, program);
+
+    ltask_shutdown();
+    lval_reclaim(0);
+    lenv_del(lenv);
+    parser_cleanup();
+    return status;
+}
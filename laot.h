@@ -0,0 +1,73 @@
+#ifndef LAOT_H
+#define LAOT_H
+
+#include <stddef.h>
+#include "jit.h"
+#include "lval.h"
+
+/* Kinds of global names compiled into a lambda */
+enum {
+    LAOT_FUN,    /* A lambda compiled along, called directly */
+    LAOT_NUM,    /* A number, compiled in as a constant */
+    LAOT_BUILTIN /* A builtin compiled inline, eg: `+` or `if` */
+};
+
+/**
+ * @brief  A global name the code of a lambda depends on
+ * @note   The code is only attached while every dependency is bound as it
+ *         was compiled
+ */
+typedef struct LAotDep {
+    const char *sym;
+    int kind;
+    /* The value of a LAOT_NUM, the index in `funs` of a LAOT_FUN */
+    long num;
+} LAotDep;
+
+/**
+ * @brief  A lambda bound by a `def` of the program, compiled ahead of time
+ */
+typedef struct LAotFun {
+    const char *sym;
+    /* Encoding (@see lser.h) of a LVAL_SEXPR holding the formals and body */
+    const unsigned char *src;
+    size_t src_len;
+    LJitFn fn;
+    /* Dependencies of the lambda and every lambda it calls, itself included */
+    const LAotDep *deps;
+    int dep_count;
+} LAotFun;
+
+/**
+ * @brief  A program compiled by lispyc
+ * @note   The forms of the source are kept and evaluated as `load` would,
+ *         compiled lambdas are attached to the lambdas they define (@see
+ *         ljit_attach) so the output is the same as loading the source
+ */
+typedef struct LAotProgram {
+    const char *path;
+    /* Encoding of a LVAL_SEXPR holding all forms of the source */
+    const unsigned char *forms;
+    size_t forms_len;
+    const LAotFun *funs;
+    int fun_count;
+} LAotProgram;
+
+/**
+ * @brief  Run a compiled program in a LEnv
+ * @param  *lenv: The global LEnv, with the builtins added
+ * @param  *program: The program
+ * @retval 0 on success, 1 if the program is malformed
+ */
+int laot_run(LEnv *lenv, const LAotProgram *program);
+
+/**
+ * @brief  Run a compiled program as `prompt` runs a file
+ * @note   The main function of a compiled program, LISPY_JIT and
+ *         LISPY_THREADS are honored like by `prompt`
+ * @param  *program: The program
+ * @retval Exit status
+ */
+int laot_main(const LAotProgram *program);
+
+#endif /* laot.h */
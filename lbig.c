@@ -0,0 +1,465 @@
+#include "lbig.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest power of 10 fitting a limb, and its number of digits */
+#define LBIG_DEC 1000000000u
+#define LBIG_DEC_DIGITS 9
+
+static LBig *lbig_alloc(int len) {
+    LBig *lbig = malloc(sizeof(LBig) + sizeof(uint32_t) * (size_t)len);
+    lbig->refs = 1;
+    lbig->neg = 0;
+    lbig->len = len;
+    return lbig;
+}
+
+// Drop leading zero limbs, zero is never negative
+static LBig *lbig_trim(LBig *lbig) {
+    while (lbig->len > 0 && lbig->limbs[lbig->len - 1] == 0) {
+        lbig->len -= 1;
+    }
+    if (lbig->len == 0) {
+        lbig->neg = 0;
+    }
+    return lbig;
+}
+
+static LBig *lbig_dup(const LBig *lbig) {
+    LBig *copy = lbig_alloc(lbig->len);
+    copy->neg = lbig->neg;
+    memcpy(copy->limbs, lbig->limbs, sizeof(uint32_t) * (size_t)lbig->len);
+    return copy;
+}
+
+LBig *lbig_from_long(long num) {
+    unsigned long long mag =
+        num < 0 ? 0ull - (unsigned long long)num : (unsigned long long)num;
+    LBig *lbig = lbig_alloc(2);
+    lbig->neg = num < 0;
+    lbig->limbs[0] = (uint32_t)mag;
+    lbig->limbs[1] = (uint32_t)(mag >> 32);
+    return lbig_trim(lbig);
+}
+
+LBig *lbig_from_limbs(int neg, const uint32_t *limbs, int len) {
+    LBig *lbig = lbig_alloc(len);
+    lbig->neg = neg != 0;
+    memcpy(lbig->limbs, limbs, sizeof(uint32_t) * (size_t)len);
+    return lbig_trim(lbig);
+}
+
+int lbig_to_long(const LBig *lbig, long *num) {
+    if (lbig->len > 2) {
+        return 0;
+    }
+    unsigned long long mag = 0;
+    for (int i = lbig->len - 1; i >= 0; i--) {
+        mag = mag << 32 | lbig->limbs[i];
+    }
+    if (mag <= LONG_MAX) {
+        *num = lbig->neg ? -(long)mag : (long)mag;
+        return 1;
+    }
+    if (lbig->neg && mag == (unsigned long long)LONG_MAX + 1) {
+        *num = LONG_MIN;
+        return 1;
+    }
+    return 0;
+}
+
+void lbig_del(LBig *lbig) {
+    if (LATOMIC_ADD(lbig->refs, -1) == 0) {
+        free(lbig);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Magnitudes, arrays of limbs least significant first */
+///////////////////////////////////////////////////////////////////////////////
+
+static int lbig_cmp_mag(const uint32_t *a, int alen, const uint32_t *b,
+                        int blen) {
+    if (alen != blen) {
+        return alen < blen ? -1 : 1;
+    }
+    for (int i = alen - 1; i >= 0; i--) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// r = a + b with alen >= blen, r may be a. Returns the carry out of r[alen)
+static uint32_t lbig_add_mag(uint32_t *r, const uint32_t *a, int alen,
+                             const uint32_t *b, int blen) {
+    uint64_t carry = 0;
+    for (int i = 0; i < alen; i++) {
+        carry += (uint64_t)a[i] + (i < blen ? b[i] : 0);
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return (uint32_t)carry;
+}
+
+// r = a - b with a >= b (so alen >= blen once trimmed), r may be a
+static void lbig_sub_mag(uint32_t *r, const uint32_t *a, int alen,
+                         const uint32_t *b, int blen) {
+    uint32_t borrow = 0;
+    for (int i = 0; i < alen; i++) {
+        uint64_t sub = (uint64_t)(i < blen ? b[i] : 0) + borrow;
+        borrow = a[i] < sub;
+        r[i] = (uint32_t)(a[i] - sub);
+    }
+}
+
+// Length of a magnitude without its leading zero limbs
+static int lbig_len_mag(const uint32_t *a, int len) {
+    while (len > 0 && a[len - 1] == 0) {
+        len -= 1;
+    }
+    return len;
+}
+
+// r[0, alen + blen) = a * b, r overlapping neither
+static void lbig_mul_school(uint32_t *r, const uint32_t *a, int alen,
+                            const uint32_t *b, int blen) {
+    memset(r, 0, sizeof(uint32_t) * (size_t)(alen + blen));
+    for (int i = 0; i < blen; i++) {
+        uint64_t carry = 0;
+        uint64_t digit = b[i];
+        if (digit == 0) {
+            continue;
+        }
+        for (int j = 0; j < alen; j++) {
+            carry += digit * a[j] + r[i + j];
+            r[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        r[i + alen] = (uint32_t)carry;
+    }
+}
+
+// r[0, alen + blen) = a * b, r overlapping neither. Karatsuba, splitting
+// both at half of the longer: with a = a1 B^m + a0 and b = b1 B^m + b0,
+// a * b = z2 B^2m + (z1 - z2 - z0) B^m + z0 for z2 = a1 b1, z0 = a0 b0 and
+// z1 = (a1 + a0)(b1 + b0), three products of half the size instead of four
+static void lbig_mul_mag(uint32_t *r, const uint32_t *a, int alen,
+                         const uint32_t *b, int blen) {
+    if (alen < blen) {
+        const uint32_t *swap = a;
+        a = b;
+        b = swap;
+        int len = alen;
+        alen = blen;
+        blen = len;
+    }
+    if (blen < LBIG_KARATSUBA) {
+        lbig_mul_school(r, a, alen, b, blen);
+        return;
+    }
+
+    // Unbalanced, b multiplies each slice of blen limbs of a in turn
+    if (2 * blen <= alen) {
+        memset(r, 0, sizeof(uint32_t) * (size_t)(alen + blen));
+        uint32_t *part = malloc(sizeof(uint32_t) * (size_t)(2 * blen));
+        for (int i = 0; i < alen; i += blen) {
+            int len = alen - i < blen ? alen - i : blen;
+            lbig_mul_mag(part, a + i, len, b, blen);
+            int plen = lbig_len_mag(part, len + blen);
+            lbig_add_mag(r + i, r + i, alen + blen - i, part, plen);
+        }
+        free(part);
+        return;
+    }
+
+    // blen > alen / 2 = m, so b1 has limbs too
+    int m = alen / 2;
+    int a1len = alen - m;
+    int b1len = blen - m;
+    int salen = a1len + 1;
+    int sblen = (b1len > m ? b1len : m) + 1;
+
+    uint32_t *tmp = malloc(sizeof(uint32_t) * (size_t)(2 * (salen + sblen)));
+    uint32_t *sa = tmp;
+    uint32_t *sb = sa + salen;
+    uint32_t *z1 = sb + sblen;
+
+    sa[a1len] = lbig_add_mag(sa, a + m, a1len, a, m);
+    if (b1len >= m) {
+        sb[b1len] = lbig_add_mag(sb, b + m, b1len, b, m);
+    } else {
+        sb[m] = lbig_add_mag(sb, b, m, b + m, b1len);
+    }
+    int sa_len = lbig_len_mag(sa, salen);
+    int sb_len = lbig_len_mag(sb, sblen);
+    lbig_mul_mag(z1, sa, sa_len, sb, sb_len);
+    int z1len = sa_len + sb_len;
+
+    // z0 and z2 land in place in r, then come off z1
+    lbig_mul_mag(r, a, m, b, m);
+    lbig_mul_mag(r + 2 * m, a + m, a1len, b + m, b1len);
+    int z0len = lbig_len_mag(r, 2 * m);
+    int z2len = lbig_len_mag(r + 2 * m, a1len + b1len);
+    lbig_sub_mag(z1, z1, z1len, r, z0len);
+    lbig_sub_mag(z1, z1, z1len, r + 2 * m, z2len);
+    z1len = lbig_len_mag(z1, z1len);
+    lbig_add_mag(r + m, r + m, alen + blen - m, z1, z1len);
+    free(tmp);
+}
+
+// q = a / b and r = a % b of magnitudes with alen >= blen >= 2 and b's
+// leading limb non zero. Knuth's algorithm D: a and b are shifted so b's
+// leading limb has its top bit set, then each limb of the quotient is
+// estimated from the leading limbs and corrected by at most one
+static void lbig_divmod_mag(uint32_t *q, uint32_t *r, const uint32_t *a,
+                            int alen, const uint32_t *b, int blen) {
+    int shift = __builtin_clz(b[blen - 1]);
+    uint32_t *un = malloc(sizeof(uint32_t) * (size_t)(alen + 1 + blen));
+    uint32_t *vn = un + alen + 1;
+
+    for (int i = blen - 1; i > 0; i--) {
+        vn[i] = (uint32_t)(b[i] << shift |
+                           (uint64_t)b[i - 1] >> (32 - shift));
+    }
+    vn[0] = b[0] << shift;
+    un[alen] = (uint32_t)((uint64_t)a[alen - 1] >> (32 - shift));
+    for (int i = alen - 1; i > 0; i--) {
+        un[i] = (uint32_t)(a[i] << shift |
+                           (uint64_t)a[i - 1] >> (32 - shift));
+    }
+    un[0] = a[0] << shift;
+
+    const uint64_t base = (uint64_t)1 << 32;
+    for (int j = alen - blen; j >= 0; j--) {
+        uint64_t num = (uint64_t)un[j + blen] << 32 | un[j + blen - 1];
+        uint64_t qhat = num / vn[blen - 1];
+        uint64_t rhat = num % vn[blen - 1];
+        while (qhat >= base ||
+               qhat * vn[blen - 2] > (rhat << 32 | un[j + blen - 2])) {
+            qhat -= 1;
+            rhat += vn[blen - 1];
+            if (rhat >= base) {
+                break;
+            }
+        }
+
+        // un[j, j + blen] -= qhat * vn
+        int64_t borrow = 0;
+        int64_t diff;
+        for (int i = 0; i < blen; i++) {
+            uint64_t prod = qhat * vn[i];
+            diff = (int64_t)un[i + j] - borrow -
+                   (int64_t)(prod & 0xFFFFFFFFu);
+            un[i + j] = (uint32_t)diff;
+            borrow = (int64_t)(prod >> 32) - (diff >> 32);
+        }
+        diff = (int64_t)un[j + blen] - borrow;
+        un[j + blen] = (uint32_t)diff;
+
+        // qhat was one too many, add vn back
+        q[j] = (uint32_t)qhat;
+        if (diff < 0) {
+            q[j] -= 1;
+            uint64_t carry = 0;
+            for (int i = 0; i < blen; i++) {
+                carry += (uint64_t)un[i + j] + vn[i];
+                un[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            un[j + blen] += (uint32_t)carry;
+        }
+    }
+
+    for (int i = 0; i < blen; i++) {
+        r[i] = (uint32_t)(un[i] >> shift |
+                          (uint64_t)un[i + 1] << (32 - shift));
+    }
+    free(un);
+}
+
+// q = a / b (if q isn't NULL) and r = a % b of magnitudes, q having
+// alen - blen + 1 limbs and r blen of them. b isn't zero
+static void lbig_div_mag(uint32_t *q, uint32_t *r, const uint32_t *a,
+                         int alen, const uint32_t *b, int blen) {
+    uint32_t *quot = q ? q : malloc(sizeof(uint32_t) * (size_t)alen);
+    if (blen == 1) {
+        uint64_t rem = 0;
+        for (int i = alen - 1; i >= 0; i--) {
+            uint64_t num = rem << 32 | a[i];
+            quot[i] = (uint32_t)(num / b[0]);
+            rem = num % b[0];
+        }
+        r[0] = (uint32_t)rem;
+    } else {
+        lbig_divmod_mag(quot, r, a, alen, b, blen);
+    }
+    if (!q) {
+        free(quot);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Signed arithmetic */
+///////////////////////////////////////////////////////////////////////////////
+
+int lbig_cmp(const LBig *first, const LBig *second) {
+    if (first->neg != second->neg) {
+        return first->neg ? -1 : 1;
+    }
+    int cmp = lbig_cmp_mag(first->limbs, first->len, second->limbs,
+                           second->len);
+    return first->neg ? -cmp : cmp;
+}
+
+LBig *lbig_neg(const LBig *lbig) {
+    LBig *neg = lbig_dup(lbig);
+    neg->neg = lbig->len > 0 && !lbig->neg;
+    return neg;
+}
+
+// first + second, with second negative if `neg`
+static LBig *lbig_add_signed(const LBig *first, const LBig *second,
+                             int neg) {
+    if (first->neg == neg) {
+        if (first->len < second->len) {
+            const LBig *swap = first;
+            first = second;
+            second = swap;
+        }
+        LBig *sum = lbig_alloc(first->len + 1);
+        sum->neg = neg;
+        sum->limbs[first->len] =
+            lbig_add_mag(sum->limbs, first->limbs, first->len,
+                         second->limbs, second->len);
+        return lbig_trim(sum);
+    }
+
+    // Signs differ, the smaller magnitude comes off the larger one
+    int cmp = lbig_cmp_mag(first->limbs, first->len, second->limbs,
+                           second->len);
+    if (cmp < 0) {
+        const LBig *swap = first;
+        first = second;
+        second = swap;
+    }
+    LBig *diff = lbig_alloc(first->len);
+    diff->neg = cmp < 0 ? neg : first->neg;
+    lbig_sub_mag(diff->limbs, first->limbs, first->len, second->limbs,
+                 second->len);
+    return lbig_trim(diff);
+}
+
+LBig *lbig_add(const LBig *first, const LBig *second) {
+    return lbig_add_signed(first, second, second->neg);
+}
+
+LBig *lbig_sub(const LBig *first, const LBig *second) {
+    return lbig_add_signed(first, second, second->len > 0 && !second->neg);
+}
+
+LBig *lbig_mul(const LBig *first, const LBig *second) {
+    if (first->len == 0 || second->len == 0) {
+        return lbig_alloc(0);
+    }
+    LBig *prod = lbig_alloc(first->len + second->len);
+    prod->neg = first->neg != second->neg;
+    lbig_mul_mag(prod->limbs, first->limbs, first->len, second->limbs,
+                 second->len);
+    return lbig_trim(prod);
+}
+
+LBig *lbig_div(const LBig *first, const LBig *second) {
+    if (first->len < second->len) {
+        return lbig_alloc(0);
+    }
+    LBig *quot = lbig_alloc(first->len - second->len + 1);
+    quot->neg = first->neg != second->neg;
+    uint32_t *rem = malloc(sizeof(uint32_t) * (size_t)second->len);
+    lbig_div_mag(quot->limbs, rem, first->limbs, first->len, second->limbs,
+                 second->len);
+    free(rem);
+    return lbig_trim(quot);
+}
+
+LBig *lbig_mod(const LBig *first, const LBig *second) {
+    if (first->len < second->len) {
+        return lbig_dup(first);
+    }
+    LBig *rem = lbig_alloc(second->len);
+    rem->neg = first->neg;
+    lbig_div_mag(NULL, rem->limbs, first->limbs, first->len, second->limbs,
+                 second->len);
+    return lbig_trim(rem);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Decimal */
+///////////////////////////////////////////////////////////////////////////////
+
+LBig *lbig_parse(const char *digits) {
+    int neg = *digits == '-';
+    digits += neg;
+    size_t count = strlen(digits);
+
+    // Every 9 digits fit in a limb, each chunk multiplying in 10^9
+    LBig *lbig = lbig_alloc((int)(count / LBIG_DEC_DIGITS + 1));
+    lbig->len = 0;
+    size_t first = count % LBIG_DEC_DIGITS;
+    for (size_t i = 0; i < count;) {
+        size_t chunk = i == 0 && first ? first : LBIG_DEC_DIGITS;
+        uint32_t scale = 1;
+        uint64_t carry = 0;
+        for (size_t k = 0; k < chunk; k++, i++) {
+            carry = carry * 10 + (uint64_t)(digits[i] - '0');
+            scale *= 10;
+        }
+        for (int k = 0; k < lbig->len; k++) {
+            carry += (uint64_t)lbig->limbs[k] * scale;
+            lbig->limbs[k] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry) {
+            lbig->limbs[lbig->len++] = (uint32_t)carry;
+        }
+    }
+    lbig->neg = neg;
+    return lbig_trim(lbig);
+}
+
+void lbig_print(LBuf *lbuf, const LBig *lbig) {
+    if (lbig->len == 0) {
+        lbuf_putc(lbuf, '0');
+        return;
+    }
+
+    // Chunks of 9 digits come off the end, from a copy divided in place
+    uint32_t *mag = malloc(sizeof(uint32_t) * (size_t)lbig->len);
+    memcpy(mag, lbig->limbs, sizeof(uint32_t) * (size_t)lbig->len);
+    size_t cap = (size_t)lbig->len * 10 + 2;
+    char *digits = malloc(cap);
+    size_t start = cap;
+
+    int len = lbig->len;
+    while (len > 0) {
+        uint64_t rem = 0;
+        for (int i = len - 1; i >= 0; i--) {
+            uint64_t num = rem << 32 | mag[i];
+            mag[i] = (uint32_t)(num / LBIG_DEC);
+            rem = num % LBIG_DEC;
+        }
+        len = lbig_len_mag(mag, len);
+        for (int k = 0; k < LBIG_DEC_DIGITS && (len > 0 || rem); k++) {
+            digits[--start] = (char)('0' + rem % 10);
+            rem /= 10;
+        }
+    }
+    if (lbig->neg) {
+        digits[--start] = '-';
+    }
+    lbuf_putn(lbuf, digits + start, cap - start);
+    free(digits);
+    free(mag);
+}
@@ -0,0 +1,120 @@
+#ifndef LBIG_H
+#define LBIG_H
+
+#include <stdint.h>
+#include "lval.h"
+
+/* Below this many limbs (of the shorter factor) multiplication is done
+ * schoolbook, Karatsuba's extra additions costing more than they save */
+#define LBIG_KARATSUBA 32
+
+/**
+ * @brief  Immutable integer of any size, shared by all copies of a LVAL_BIG
+ * @note   Sign and magnitude, the magnitude in base 2^32 limbs. Numbers that
+ *         fit a long are never LVAL_BIG (@see lval_wrap_big), so a LBig is
+ *         only made when arithmetic on LVAL_NUMs overflows
+ */
+struct LBig {
+    int refs;
+    /* 1 if negative, 0 for zero */
+    int neg;
+    /* Number of limbs, the most significant one is never 0 */
+    int len;
+    /* Least significant first */
+    uint32_t limbs[];
+};
+
+/**
+ * @brief  A LBig of a long
+ * @param  num: Any long
+ * @retval A new LBig
+ */
+LBig *lbig_from_long(long num);
+
+/**
+ * @brief  Parse decimal digits
+ * @param  *digits: Digits with an optional leading `-`, as read by the parser
+ * @retval A new LBig
+ */
+LBig *lbig_parse(const char *digits);
+
+/**
+ * @brief  The value of a LBig as a long, if it fits one
+ * @param  *lbig: A LBig
+ * @param  *num: Set to the value if it fits
+ * @retval 1 if it fits, 0 otherwise
+ */
+int lbig_to_long(const LBig *lbig, long *num);
+
+/**
+ * @brief  Release a reference to a LBig, freeing it with the last one
+ * @param  *lbig: A LBig
+ * @retval None
+ */
+void lbig_del(LBig *lbig);
+
+/**
+ * @brief  Compare two LBigs
+ * @retval Negative, 0 or positive as `first` is less, equal or greater
+ */
+int lbig_cmp(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Negate a LBig
+ * @retval A new LBig
+ */
+LBig *lbig_neg(const LBig *lbig);
+
+/**
+ * @brief  Add two LBigs
+ * @retval A new LBig
+ */
+LBig *lbig_add(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Subtract a LBig from another
+ * @retval A new LBig
+ */
+LBig *lbig_sub(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Multiply two LBigs
+ * @note   Karatsuba once both have LBIG_KARATSUBA limbs, O(n^1.58)
+ * @retval A new LBig
+ */
+LBig *lbig_mul(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Divide a LBig by another, rounding towards 0 like C's `/`
+ * @note   Long division (Knuth's algorithm D), O(n^2)
+ * @param  *second: The divisor, not 0
+ * @retval A new LBig
+ */
+LBig *lbig_div(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Remainder of lbig_div, with the sign of `first` like C's `%`
+ * @param  *second: The divisor, not 0
+ * @retval A new LBig
+ */
+LBig *lbig_mod(const LBig *first, const LBig *second);
+
+/**
+ * @brief  Print a LBig in decimal
+ * @note   O(n^2) in the number of limbs, repeatedly dividing by 10^9
+ * @param  *lbuf: The LBuf written to
+ * @param  *lbig: A LBig
+ * @retval None
+ */
+void lbig_print(LBuf *lbuf, const LBig *lbig);
+
+/**
+ * @brief  A LBig of raw limbs, for decoders (@see lser.h)
+ * @param  neg: 1 if negative
+ * @param  *limbs: Limbs, least significant first, copied
+ * @param  len: Number of limbs, leading zero limbs are dropped
+ * @retval A new LBig
+ */
+LBig *lbig_from_limbs(int neg, const uint32_t *limbs, int len);
+
+#endif /* lbig.h */
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "lbuf.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Two digits at a time for lbuf_put_long
+static const char lbuf_digits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Escapes as used by mpcf_escape, indexed by the unescaped character
+static const char *lbuf_escapes[256] = {
+    ['\a'] = "\\a", ['\b'] = "\\b",  ['\f'] = "\\f",  ['\n'] = "\\n",
+    ['\r'] = "\\r", ['\t'] = "\\t",  ['\v'] = "\\v",  ['\\'] = "\\\\",
+    ['\''] = "\\'", ['\"'] = "\\\"", ['\0'] = "\\0",
+};
+
+static void lbuf_init(LBuf *lbuf, int sink) {
+    lbuf->sink = sink;
+    lbuf->file = NULL;
+    lbuf->fd = -1;
+    lbuf->data = lbuf->inl;
+    lbuf->len = 0;
+    lbuf->cap = LBUF_INLINE;
+    lbuf->err = 0;
+}
+
+void lbuf_init_file(LBuf *lbuf, FILE *file) {
+    lbuf_init(lbuf, LBUF_FILE);
+    lbuf->file = file;
+}
+
+void lbuf_init_fd(LBuf *lbuf, int fd) {
+    lbuf_init(lbuf, LBUF_FD);
+    lbuf->fd = fd;
+}
+
+void lbuf_init_str(LBuf *lbuf) { lbuf_init(lbuf, LBUF_STR); }
+
+// Make space for atleast `len` more bytes, either by flushing or by growing
+static void lbuf_reserve(LBuf *lbuf, size_t len) {
+    if (lbuf->len + len <= lbuf->cap) {
+        return;
+    }
+
+    if (lbuf->sink != LBUF_STR) {
+        lbuf_flush(lbuf);
+        if (len <= lbuf->cap) {
+            return;
+        }
+    }
+
+    // Grow geometrically so appending is amortized O(1)
+    size_t cap = lbuf->cap * 2;
+    while (cap < lbuf->len + len) {
+        cap *= 2;
+    }
+
+    if (lbuf->data == lbuf->inl) {
+        lbuf->data = malloc(cap);
+        memcpy(lbuf->data, lbuf->inl, lbuf->len);
+    } else {
+        lbuf->data = realloc(lbuf->data, cap);
+    }
+    lbuf->cap = cap;
+}
+
+void lbuf_putc(LBuf *lbuf, char c) {
+    if (lbuf->len == lbuf->cap) {
+        lbuf_reserve(lbuf, 1);
+    }
+    lbuf->data[lbuf->len++] = c;
+}
+
+void lbuf_putn(LBuf *lbuf, const char *str, size_t len) {
+    lbuf_reserve(lbuf, len);
+    memcpy(lbuf->data + lbuf->len, str, len);
+    lbuf->len += len;
+}
+
+void lbuf_puts(LBuf *lbuf, const char *str) {
+    lbuf_putn(lbuf, str, strlen(str));
+}
+
+void lbuf_put_long(LBuf *lbuf, long num) {
+    // Enough for 64-bit LONG_MIN with sign
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *cur = end;
+
+    // Work on the magnitude as unsigned so LONG_MIN does not overflow
+    unsigned long mag = num < 0 ? 0UL - (unsigned long)num : (unsigned long)num;
+
+    while (mag >= 100) {
+        unsigned long pair = (mag % 100) * 2;
+        mag /= 100;
+        *--cur = lbuf_digits[pair + 1];
+        *--cur = lbuf_digits[pair];
+    }
+    if (mag >= 10) {
+        *--cur = lbuf_digits[mag * 2 + 1];
+        *--cur = lbuf_digits[mag * 2];
+    } else {
+        *--cur = (char)('0' + mag);
+    }
+
+    if (num < 0) {
+        *--cur = '-';
+    }
+
+    lbuf_putn(lbuf, cur, (size_t)(end - cur));
+}
+
+void lbuf_put_escaped(LBuf *lbuf, const char *str, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        const char *escape = lbuf_escapes[(unsigned char)str[i]];
+        if (escape) {
+            // Copy the unescaped run before this character in one go
+            lbuf_putn(lbuf, str + start, i - start);
+            lbuf_putn(lbuf, escape, 2);
+            start = i + 1;
+        }
+    }
+    lbuf_putn(lbuf, str + start, len - start);
+}
+
+void lbuf_flush(LBuf *lbuf) {
+    switch (lbuf->sink) {
+        case LBUF_FILE:
+            // stdio doesn't tell why, only that it failed
+            if ((fwrite(lbuf->data, 1, lbuf->len, lbuf->file) < lbuf->len ||
+                 fflush(lbuf->file) != 0) &&
+                !lbuf->err) {
+                lbuf->err = EIO;
+            }
+            break;
+        case LBUF_FD: {
+            size_t done = 0;
+            while (done < lbuf->len) {
+                ssize_t wrote =
+                    write(lbuf->fd, lbuf->data + done, lbuf->len - done);
+                if (wrote < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    // Nothing sensible to do on a broken sink, drop the bytes
+                    if (!lbuf->err) {
+                        lbuf->err = errno;
+                    }
+                    break;
+                }
+                done += (size_t)wrote;
+            }
+            break;
+        }
+        case LBUF_STR:
+            return;
+    }
+    lbuf->len = 0;
+}
+
+char *lbuf_take(LBuf *lbuf, size_t *len) {
+    char *str;
+    if (lbuf->data == lbuf->inl) {
+        str = malloc(lbuf->len + 1);
+        memcpy(str, lbuf->inl, lbuf->len);
+    } else {
+        str = realloc(lbuf->data, lbuf->len + 1);
+    }
+    str[lbuf->len] = '\0';
+
+    if (len) {
+        *len = lbuf->len;
+    }
+
+    lbuf->data = lbuf->inl;
+    lbuf->len = 0;
+    lbuf->cap = LBUF_INLINE;
+    return str;
+}
+
+void lbuf_free(LBuf *lbuf) {
+    lbuf_flush(lbuf);
+    if (lbuf->data != lbuf->inl) {
+        free(lbuf->data);
+    }
+    lbuf->data = lbuf->inl;
+    lbuf->len = 0;
+    lbuf->cap = LBUF_INLINE;
+}
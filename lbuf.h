@@ -0,0 +1,125 @@
+#ifndef LBUF_H
+#define LBUF_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Bytes buffered on the stack before flushing or spilling to heap */
+#define LBUF_INLINE 4096
+
+/* LBuf sinks */
+enum {
+    LBUF_FILE, /* Flushed with fwrite to a FILE (eg: stdout) */
+    LBUF_FD,   /* Flushed with write(2) to a file descriptor */
+    LBUF_STR   /* Never flushed, grows into a heap string */
+};
+
+/**
+ * @brief  A buffered writer used for all of lispy's output
+ * @note   Usually lives on the stack, only LBUF_STR ever touches the heap
+ */
+typedef struct LBuf {
+    int sink;
+
+    /* Destination for LBUF_FILE/LBUF_FD */
+    FILE *file;
+    int fd;
+
+    /* Buffered bytes, points either to `inl` or to a heap buffer */
+    char *data;
+    size_t len;
+    size_t cap;
+
+    /* errno of the first flush which failed to write everything (eg:
+     * ENOSPC), else 0. The bytes it failed to write are dropped */
+    int err;
+
+    char inl[LBUF_INLINE];
+} LBuf;
+
+/**
+ * @brief  Initialize a LBuf flushing to a FILE
+ * @param  *lbuf: The LBuf to be initialized
+ * @param  *file: The FILE written to on flush
+ * @retval None
+ */
+void lbuf_init_file(LBuf *lbuf, FILE *file);
+
+/**
+ * @brief  Initialize a LBuf flushing to a file descriptor
+ * @param  *lbuf: The LBuf to be initialized
+ * @param  fd: The file descriptor written to on flush
+ * @retval None
+ */
+void lbuf_init_fd(LBuf *lbuf, int fd);
+
+/**
+ * @brief  Initialize a LBuf collecting output into a growable string
+ * @param  *lbuf: The LBuf to be initialized
+ * @retval None
+ */
+void lbuf_init_str(LBuf *lbuf);
+
+/**
+ * @brief  Append a single character
+ * @param  *lbuf: The LBuf to append to
+ * @param  c: The character
+ * @retval None
+ */
+void lbuf_putc(LBuf *lbuf, char c);
+
+/**
+ * @brief  Append `len` bytes of `str`
+ * @param  *lbuf: The LBuf to append to
+ * @param  *str: The bytes, need not be null terminated
+ * @param  len: Number of bytes
+ * @retval None
+ */
+void lbuf_putn(LBuf *lbuf, const char *str, size_t len);
+
+/* lbuf_putn for null terminated strings */
+void lbuf_puts(LBuf *lbuf, const char *str);
+
+/**
+ * @brief  Append a long in decimal without going through printf
+ * @param  *lbuf: The LBuf to append to
+ * @param  num: The number to be formatted
+ * @retval None
+ */
+void lbuf_put_long(LBuf *lbuf, long num);
+
+/**
+ * @brief  Append `len` bytes of `str` escaped the same way as mpcf_escape
+ * @note   Escapes directly into the buffer, no intermediate copy is made
+ * @param  *lbuf: The LBuf to append to
+ * @param  *str: The unescaped bytes
+ * @param  len: Number of bytes
+ * @retval None
+ */
+void lbuf_put_escaped(LBuf *lbuf, const char *str, size_t len);
+
+/**
+ * @brief  Write out buffered bytes of a LBUF_FILE/LBUF_FD LBuf
+ * @note   No-op for LBUF_STR
+ * @param  *lbuf: The LBuf to be flushed
+ * @retval None
+ */
+void lbuf_flush(LBuf *lbuf);
+
+/**
+ * @brief  Take the string collected by a LBUF_STR LBuf
+ * @note   The LBuf is reset and can be reused afterwards
+ * @param  *lbuf: A LBuf with sink LBUF_STR
+ * @param  *len: Set to length of the string if not NULL
+ * @retval A null terminated heap string owned by the caller
+ */
+char *lbuf_take(LBuf *lbuf, size_t *len);
+
+/**
+ * @brief  Flush and release any memory held by a LBuf
+ * @param  *lbuf: The LBuf to be released
+ * @retval None
+ */
+void lbuf_free(LBuf *lbuf);
+
+#endif /* lbuf.h */
@@ -0,0 +1,67 @@
+#ifndef LBUILTIN_H
+#define LBUILTIN_H
+
+#include "lval.h"
+
+/* How calls of a builtin are folded into constants (@see lval_fold) */
+enum {
+    LFOLD_NONE,  /* Never folded */
+    LFOLD_PURE,  /* No side-effects, calls on literals are folded */
+    LFOLD_BRANCH /* Never called, but its branches are folded (`if`) */
+};
+
+/* Most arguments a signature lists, the repeated one counted once */
+#define LBUILTIN_MAX_ARGS 4
+
+/**
+ * @brief  Signature of a builtin, compiled from builtins.def by mkbuiltins
+ * @note   Checking arguments is then a compare and a mask per argument,
+ *         instead of parsing the signature on every call
+ *         (@see lbuiltin_check)
+ */
+typedef struct LBuiltinSig {
+    /* Number of required arguments, -1 if the builtin checks them itself */
+    int count;
+    /* 1 if any number of arguments like the last one may follow */
+    int variadic;
+    /* Types accepted for each argument, as bits `1 << type` */
+    unsigned masks[LBUILTIN_MAX_ARGS];
+    /* Type reported as expected when an argument isn't accepted */
+    int expected[LBUILTIN_MAX_ARGS];
+} LBuiltinSig;
+
+/**
+ * @brief  A builtin of the global LEnv, as listed in builtins.def
+ * @note   Builtins aren't bound in the global LEnv, names it doesn't bind
+ *         are looked up in the static table of them instead
+ *         (@see lenv_get_global), so starting up allocates nothing for them
+ */
+typedef struct LBuiltinDef {
+    const char *sym;
+    /* Types of the arguments (@see builtins.def) */
+    const LBuiltinSig *sig;
+    int fold;
+    /* The builtin as a value, LFLAG_STATIC so it's never copied or freed */
+    LVal lval;
+} LBuiltinDef;
+
+/**
+ * @brief  Hash of the name of a builtin
+ * @note   Shared by mkbuiltins, which searches the seed making it perfect
+ *         over builtins.def, and lbuiltin_index using that seed
+ * @param  *sym: A null terminated name
+ * @param  seed: Seed of the hash
+ * @retval The hash, to be masked to the number of slots
+ */
+static unsigned lbuiltin_hash(const char *sym, unsigned seed) {
+    // FNV-1a, with a final mix as the low bits are used
+    unsigned hash = 2166136261u ^ seed;
+    for (; *sym; sym++) {
+        hash = (hash ^ (unsigned char)*sym) * 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bu;
+    return hash ^ (hash >> 16);
+}
+
+#endif /* lbuiltin.h */
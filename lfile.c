@@ -0,0 +1,170 @@
+#define _DEFAULT_SOURCE
+
+#include "lfile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int lfile_open(LFile *lfile, const char *path) {
+    lfile->owner = NULL;
+    lfile->data = NULL;
+    lfile->len = 0;
+    lfile->pos = 0;
+    lfile->dropped = 0;
+    lfile->fd = -1;
+    lfile->eof = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        close(fd);
+        return EISDIR;
+    }
+    // Only regular files of a known size can be mapped, /proc files say
+    // they are empty
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        lfile->fd = fd;
+        return 0;
+    }
+
+    // The mapping outlives the descriptor
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = map == MAP_FAILED ? errno : 0;
+    close(fd);
+    if (err) {
+        return err;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    // An owner without bytes of its own, only views point into the mapping
+    lfile->owner = malloc(sizeof(LStrBuf));
+    lfile->owner->refs = 1;
+    lfile->owner->map = map;
+    lfile->owner->map_len = (size_t)st.st_size;
+
+    lfile->data = map;
+    lfile->len = (size_t)st.st_size;
+    return 0;
+}
+
+// Move the bytes not read yet into a new chunk, with room for as many more
+static int lfile_chunk(LFile *lfile) {
+    size_t left = lfile->len - lfile->pos;
+    size_t cap = LFILE_CHUNK;
+    while (cap < left * 2) {
+        cap *= 2;
+    }
+    void *map = mmap(NULL, cap, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    if (left) {
+        memcpy(map, lfile->data + lfile->pos, left);
+    }
+
+    // Views of lines in the previous chunk keep it alive
+    lstrbuf_del(lfile->owner);
+    lfile->owner = malloc(sizeof(LStrBuf));
+    lfile->owner->refs = 1;
+    lfile->owner->map = map;
+    lfile->owner->map_len = cap;
+
+    lfile->data = map;
+    lfile->len = left;
+    lfile->pos = 0;
+    return 1;
+}
+
+// Read until a whole line is in the chunk, or the whole file if `all`
+static void lfile_fill(LFile *lfile, int all) {
+    size_t scanned = lfile->pos;
+    while (!lfile->eof) {
+        if (!all && lfile->len > scanned &&
+            memchr(lfile->data + scanned, '\n', lfile->len - scanned)) {
+            return;
+        }
+        scanned = lfile->len;
+
+        if (!lfile->owner || lfile->len == lfile->owner->map_len) {
+            size_t pos = lfile->pos;
+            if (!lfile_chunk(lfile)) {
+                lfile->eof = 1;
+                return;
+            }
+            scanned -= pos;
+        }
+
+        char *dst = (char *)lfile->data + lfile->len;
+        ssize_t n = read(lfile->fd, dst, lfile->owner->map_len - lfile->len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            lfile->eof = 1;
+        } else {
+            lfile->len += (size_t)n;
+        }
+    }
+}
+
+int lfile_line(LFile *lfile, const char **line, size_t *len) {
+    if (lfile->fd >= 0) {
+        lfile_fill(lfile, 0);
+    }
+    if (lfile->pos >= lfile->len) {
+        return 0;
+    }
+
+    const char *start = lfile->data + lfile->pos;
+    size_t left = lfile->len - lfile->pos;
+    const char *newline = memchr(start, '\n', left);
+
+    size_t line_len = newline ? (size_t)(newline - start) : left;
+    lfile->pos += line_len + (newline ? 1 : 0);
+    if (line_len > 0 && start[line_len - 1] == '\r') {
+        line_len -= 1;
+    }
+    *line = start;
+    *len = line_len;
+
+    // Whole windows behind the line just read won't be needed again. Chunks
+    // are anonymous memory, which would come back zeroed
+    while (lfile->fd < 0 &&
+           (size_t)(start - lfile->data) >= lfile->dropped + LFILE_WINDOW) {
+        madvise((char *)lfile->data + lfile->dropped, LFILE_WINDOW,
+                MADV_DONTNEED);
+        lfile->dropped += LFILE_WINDOW;
+    }
+    return 1;
+}
+
+void lfile_read_all(LFile *lfile) {
+    if (lfile->fd >= 0) {
+        lfile_fill(lfile, 1);
+    }
+}
+
+void lfile_close(LFile *lfile) {
+    lstrbuf_del(lfile->owner);
+    lfile->owner = NULL;
+    if (lfile->fd >= 0) {
+        close(lfile->fd);
+        lfile->fd = -1;
+    }
+}
+
+void lfile_unmap(void *map, size_t len) { munmap(map, len); }
@@ -0,0 +1,89 @@
+#ifndef LFILE_H
+#define LFILE_H
+
+#include <stddef.h>
+#include "lval.h"
+
+/* Bytes of a file dropped from memory at a time, once reading is past them */
+#define LFILE_WINDOW ((size_t)16 << 20)
+
+/* Bytes read at a time from files which can't be mapped */
+#define LFILE_CHUNK ((size_t)64 << 10)
+
+/**
+ * @brief  A file mapped into memory, read line by line
+ * @note   Lines are handed out as pointers into the mapping, which stays
+ *         mapped as long as `owner` is referenced (eg: by string views).
+ *         Pages already read are dropped from memory every LFILE_WINDOW
+ *         bytes, so memory stays flat however large the file is. Pages of
+ *         views still alive are simply read again from the file.
+ *         Pipes, devices and files whose size isn't known upfront (eg: in
+ *         /proc) are read with read() into anonymous mappings of
+ *         LFILE_CHUNK bytes instead, each owned like the file's mapping and
+ *         freed once its lines are no longer viewed
+ */
+typedef struct LFile {
+    /* Owner of the mapping, NULL for empty files which aren't mapped */
+    LStrBuf *owner;
+
+    const char *data;
+    size_t len;
+
+    /* Start of the next line */
+    size_t pos;
+    /* Bytes before this were dropped from memory */
+    size_t dropped;
+
+    /* Descriptor of a file read in chunks, else -1, and whether its end was
+     * reached */
+    int fd;
+    int eof;
+} LFile;
+
+/**
+ * @brief  Map a file for reading
+ * @note   The file must not be truncated while it is mapped. Directories
+ *         are an EISDIR error
+ * @param  *lfile: The LFile to be initialized
+ * @param  *path: Path of the file
+ * @retval 0 on success, else an errno value
+ */
+int lfile_open(LFile *lfile, const char *path);
+
+/**
+ * @brief  Read the next line
+ * @note   Lines end with "\n" or "\r\n", which aren't part of the line. The
+ *         last line need not end with either
+ * @param  *lfile: An open LFile
+ * @param  **line: Set to the start of the line, within the mapping
+ * @param  *len: Set to the length of the line
+ * @retval 1 if a line was read, 0 at the end of the file
+ */
+int lfile_line(LFile *lfile, const char **line, size_t *len);
+
+/**
+ * @brief  Read the rest of a file, so `data` and `len` hold all of it
+ * @note   Nothing to do for mapped files, chunks are gathered into one
+ * @param  *lfile: An open LFile no line was read from
+ * @retval None
+ */
+void lfile_read_all(LFile *lfile);
+
+/**
+ * @brief  Drop the reference of a LFile to its mapping, closing the file if
+ *         it was read in chunks
+ * @param  *lfile: An open LFile
+ * @retval None
+ */
+void lfile_close(LFile *lfile);
+
+/**
+ * @brief  Unmap a mapping made by lfile_open
+ * @note   Called once the last reference to the owner LStrBuf is dropped
+ * @param  *map: Start of the mapping
+ * @param  len: Length of the mapping
+ * @retval None
+ */
+void lfile_unmap(void *map, size_t len);
+
+#endif /* lfile.h */
@@ -0,0 +1,765 @@
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jit.h"
+#include "lbuf.h"
+#include "lser.h"
+#include "lval.h"
+#include "mpc.h"
+#include "parser.h"
+
+/* Deepest expression compiled, deeper lambdas are interpreted */
+#define LISPYC_MAX_DEPTH 256
+/* Bytes of an encoding per line of the generated code */
+#define LISPYC_BYTES_PER_LINE 12
+
+/* Kinds of builtins compiled inline */
+enum { LISPYC_ARITH, LISPYC_DIV, LISPYC_CMP, LISPYC_IF };
+
+// Arithmetic is checked by __builtin_*_overflow, the rest are C operators
+static const struct {
+    const char *sym;
+    int kind;
+    const char *op;
+} lispyc_ops[] = {
+    {"+", LISPYC_ARITH, "add"}, {"-", LISPYC_ARITH, "sub"},
+    {"*", LISPYC_ARITH, "mul"}, {"/", LISPYC_DIV, "/"},
+    {"%", LISPYC_DIV, "%"},     {"<", LISPYC_CMP, "<"},
+    {">", LISPYC_CMP, ">"},     {"<=", LISPYC_CMP, "<="},
+    {">=", LISPYC_CMP, ">="},   {"==", LISPYC_CMP, "=="},
+    {"!=", LISPYC_CMP, "!="},   {"if", LISPYC_IF, NULL},
+};
+
+#define LISPYC_OP_COUNT (int)(sizeof(lispyc_ops) / sizeof(lispyc_ops[0]))
+
+/**
+ * @brief  A name bound by a `def` at the top level of the source
+ * @note   Only names bound once, to a number or a lambda, are compiled in.
+ *         Whether they are still bound so at runtime is checked by laot.c
+ */
+typedef struct LcDef {
+    const char *sym;
+    /* Times the name is bound at the top level */
+    int defs;
+
+    int is_num;
+    long num;
+
+    /* Formals and body of a lambda, owned by the forms */
+    LVal *lformals;
+    LVal *lbody;
+    /* Still compilable, as far as the lambdas it calls are */
+    int ok;
+    /* Generated C function, and its index among compiled lambdas. LBuf's
+     * hold storage inline, so it's set up once `defs` stops moving */
+    LBuf code;
+    int index;
+
+    /* Names compiled in: indices in `defs`, or -1 - index in lispyc_ops */
+    int *deps;
+    int dep_count;
+    /* Names compiled into it and every lambda it calls */
+    int dep_total;
+} LcDef;
+
+/**
+ * @brief  State of compiling a source file
+ */
+typedef struct Lc {
+    LcDef *defs;
+    int def_count;
+
+    /* Lambda being compiled */
+    LcDef *def;
+    int temps;
+    int indent;
+    int depth;
+} Lc;
+
+static void lispyc_printf(LBuf *lbuf, const char *fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    lbuf_putn(lbuf, buf, (size_t)len < sizeof(buf) ? (size_t)len : 0);
+}
+
+// A long as a C constant, LONG_MIN has no literal of its own
+static void lispyc_put_num(LBuf *lbuf, long num) {
+    if (num == LONG_MIN) {
+        lbuf_puts(lbuf, "(-9223372036854775807L - 1)");
+    } else {
+        lispyc_printf(lbuf, "%ldL", num);
+    }
+}
+
+// A C string literal, escaping anything but plain characters
+static void lispyc_put_str(LBuf *lbuf, const char *str) {
+    lbuf_putc(lbuf, '"');
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c < 0x20 || *c >= 0x7F || *c == '"' || *c == '\\' ||
+            *c == '?') {
+            lispyc_printf(lbuf, "\\%03o", *c);
+        } else {
+            lbuf_putc(lbuf, (char)*c);
+        }
+    }
+    lbuf_putc(lbuf, '"');
+}
+
+// The encoding of a LVal as an array of bytes, 0 if it can't be encoded
+static int lispyc_put_bytes(LBuf *lbuf, const char *name, LVal *lval) {
+    LBuf bytes;
+    lbuf_init_str(&bytes);
+    if (!lser_encode(&bytes, lval)) {
+        lbuf_free(&bytes);
+        return 0;
+    }
+
+    lispyc_printf(lbuf, "static const unsigned char %s[] = {", name);
+    for (size_t i = 0; i < bytes.len; i++) {
+        lbuf_puts(lbuf, i % LISPYC_BYTES_PER_LINE ? " " : "\n    ");
+        lispyc_printf(lbuf, "0x%02X,", (unsigned char)bytes.data[i]);
+    }
+    lbuf_puts(lbuf, "\n};\n\n");
+    lbuf_free(&bytes);
+    return 1;
+}
+
+static LcDef *lispyc_find(Lc *c, const char *sym) {
+    for (int i = 0; i < c->def_count; i++) {
+        if (strcmp(c->defs[i].sym, sym) == 0) {
+            return &c->defs[i];
+        }
+    }
+    return NULL;
+}
+
+// The LcDef of a name, added on its first `def`
+static LcDef *lispyc_def(Lc *c, const char *sym) {
+    LcDef *found = lispyc_find(c, sym);
+    if (found) {
+        return found;
+    }
+    c->defs = realloc(c->defs, sizeof(LcDef) * (size_t)(c->def_count + 1));
+    LcDef *def = &c->defs[c->def_count++];
+    def->sym = sym;
+    def->defs = 0;
+    def->is_num = 0;
+    def->num = 0;
+    def->lformals = NULL;
+    def->lbody = NULL;
+    def->ok = 0;
+    def->index = -1;
+    def->deps = NULL;
+    def->dep_count = 0;
+    def->dep_total = 0;
+    return def;
+}
+
+// Lambdas with formals the compiled code can take as longs
+static int lispyc_formals_ok(LVal *lformals) {
+    if (lformals->child_count > LJIT_MAX_ARGS) {
+        return 0;
+    }
+    for (int i = 0; i < lformals->child_count; i++) {
+        LVal *lformal = lformals->children[i];
+        if (lformal->type != LVAL_SYM || strcmp(lformal->sym, "&") == 0) {
+            return 0;
+        }
+        for (int j = 0; j < i; j++) {
+            if (strcmp(lformal->sym, lformals->children[j]->sym) == 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Record the names bound by a top level form
+static void lispyc_scan(Lc *c, LVal *lform) {
+    if (lform->type != LVAL_SEXPR || lform->child_count < 2 ||
+        lform->children[0]->type != LVAL_SYM ||
+        lform->children[1]->type != LVAL_QEXPR) {
+        return;
+    }
+    int is_def = strcmp(lform->children[0]->sym, "def") == 0;
+    if (!is_def && strcmp(lform->children[0]->sym, "=") != 0) {
+        return;
+    }
+
+    LVal *lsyms = lform->children[1];
+    for (int i = 0; i < lsyms->child_count; i++) {
+        if (lsyms->children[i]->type != LVAL_SYM) {
+            continue;
+        }
+        LcDef *def = lispyc_def(c, lsyms->children[i]->sym);
+        def->defs += 1;
+        if (!is_def || lsyms->child_count != lform->child_count - 2) {
+            continue;
+        }
+
+        LVal *lval = lform->children[2 + i];
+        if (lval->type == LVAL_NUM) {
+            def->is_num = 1;
+            def->num = lval->num;
+        } else if (lval->type == LVAL_SEXPR && lval->child_count == 3 &&
+                   lval->children[0]->type == LVAL_SYM &&
+                   strcmp(lval->children[0]->sym, "\\") == 0 &&
+                   lval->children[1]->type == LVAL_QEXPR &&
+                   lval->children[2]->type == LVAL_QEXPR &&
+                   lispyc_formals_ok(lval->children[1])) {
+            def->lformals = lval->children[1];
+            def->lbody = lval->children[2];
+        }
+    }
+}
+
+// Start an indented line of the lambda being compiled
+static LBuf *lispyc_line(Lc *c) {
+    for (int i = 0; i < c->indent; i++) {
+        lbuf_puts(&c->def->code, "    ");
+    }
+    return &c->def->code;
+}
+
+// Return 1 (the call is interpreted instead) if `cond` holds
+static void lispyc_bail(Lc *c, const char *cond) {
+    lispyc_printf(lispyc_line(c), "if (%s) {\n", cond);
+    lbuf_puts(lispyc_line(c), "    return 1;\n");
+    lbuf_puts(lispyc_line(c), "}\n");
+}
+
+static void lispyc_dep(Lc *c, int dep) {
+    LcDef *def = c->def;
+    for (int i = 0; i < def->dep_count; i++) {
+        if (def->deps[i] == dep) {
+            return;
+        }
+    }
+    def->deps = realloc(def->deps, sizeof(int) * (size_t)(def->dep_count + 1));
+    def->deps[def->dep_count++] = dep;
+}
+
+// Index of a formal named `sym`, or -1
+static int lispyc_formal(LVal *lformals, const char *sym) {
+    for (int i = 0; i < lformals->child_count; i++) {
+        if (strcmp(lformals->children[i]->sym, sym) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Index in lispyc_ops of a builtin applied by `lsym`, or -1
+static int lispyc_op(Lc *c, LVal *lsym) {
+    if (lispyc_formal(c->def->lformals, lsym->sym) >= 0 ||
+        lispyc_find(c, lsym->sym)) {
+        return -1;
+    }
+    for (int i = 0; i < LISPYC_OP_COUNT; i++) {
+        if (strcmp(lispyc_ops[i].sym, lsym->sym) == 0) {
+            lispyc_dep(c, -1 - i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int lispyc_expr(Lc *c, LVal *lval);
+static int lispyc_sexpr(Lc *c, LVal *lval);
+
+// Compile an expression into a new temporary, its index or -1
+static int lispyc_temp(Lc *c, long num, int formal) {
+    int temp = c->temps++;
+    LBuf *code = lispyc_line(c);
+    lispyc_printf(code, "long t%d = ", temp);
+    if (formal >= 0) {
+        lispyc_printf(code, "a%d", formal);
+    } else {
+        lispyc_put_num(code, num);
+    }
+    lbuf_puts(code, ";\n");
+    return temp;
+}
+
+static int lispyc_arith(Lc *c, int op, LVal **args, int count) {
+    int acc = lispyc_expr(c, args[0]);
+    if (acc < 0) {
+        return -1;
+    }
+    const char *cop = lispyc_ops[op].op;
+    char cond[128];
+
+    // Negation by a lone `-`
+    if (count == 1 && strcmp(lispyc_ops[op].sym, "-") == 0) {
+        int temp = c->temps++;
+        lispyc_printf(lispyc_line(c), "long t%d;\n", temp);
+        snprintf(cond, sizeof(cond), "__builtin_sub_overflow(0, t%d, &t%d)",
+                 acc, temp);
+        lispyc_bail(c, cond);
+        return temp;
+    }
+
+    for (int i = 1; i < count; i++) {
+        int rhs = lispyc_expr(c, args[i]);
+        if (rhs < 0) {
+            return -1;
+        }
+        int temp = c->temps++;
+        if (lispyc_ops[op].kind == LISPYC_DIV) {
+            // Division by 0 or -1 is left to the interpreter, like the JIT
+            if (args[i]->type != LVAL_NUM || args[i]->num == 0 ||
+                args[i]->num == -1) {
+                snprintf(cond, sizeof(cond), "t%d == 0 || t%d == -1", rhs,
+                         rhs);
+                lispyc_bail(c, cond);
+            }
+            lispyc_printf(lispyc_line(c), "long t%d = t%d %s t%d;\n", temp,
+                          acc, cop, rhs);
+        } else {
+            lispyc_printf(lispyc_line(c), "long t%d;\n", temp);
+            snprintf(cond, sizeof(cond),
+                     "__builtin_%s_overflow(t%d, t%d, &t%d)", cop, acc, rhs,
+                     temp);
+            lispyc_bail(c, cond);
+        }
+        acc = temp;
+    }
+    return acc;
+}
+
+static int lispyc_cmp(Lc *c, int op, LVal **args, int count) {
+    if (count != 2) {
+        return -1;
+    }
+    int lhs = lispyc_expr(c, args[0]);
+    int rhs = lhs < 0 ? -1 : lispyc_expr(c, args[1]);
+    if (rhs < 0) {
+        return -1;
+    }
+    int temp = c->temps++;
+    lispyc_printf(lispyc_line(c), "long t%d = t%d %s t%d;\n", temp, lhs,
+                  lispyc_ops[op].op, rhs);
+    return temp;
+}
+
+// An `if` branch, a Q-Expression evaluated as a S-Expression, assigned to
+// the result of the `if`
+static int lispyc_branch(Lc *c, LVal *lval, int result) {
+    if (lval->type != LVAL_QEXPR) {
+        return 0;
+    }
+    c->indent += 1;
+    int temp = lispyc_sexpr(c, lval);
+    if (temp >= 0) {
+        lispyc_printf(lispyc_line(c), "t%d = t%d;\n", result, temp);
+    }
+    c->indent -= 1;
+    return temp >= 0;
+}
+
+static int lispyc_if(Lc *c, LVal **args, int count) {
+    if (count != 3) {
+        return -1;
+    }
+    int cond = lispyc_expr(c, args[0]);
+    if (cond < 0) {
+        return -1;
+    }
+
+    int result = c->temps++;
+    lispyc_printf(lispyc_line(c), "long t%d;\n", result);
+    lispyc_printf(lispyc_line(c), "if (t%d) {\n", cond);
+    if (!lispyc_branch(c, args[1], result)) {
+        return -1;
+    }
+    lbuf_puts(lispyc_line(c), "} else {\n");
+    if (!lispyc_branch(c, args[2], result)) {
+        return -1;
+    }
+    lbuf_puts(lispyc_line(c), "}\n");
+    return result;
+}
+
+// Call a compiled lambda directly, its arguments being numbers already
+static int lispyc_call(Lc *c, LcDef *callee, LVal **args, int count) {
+    if (count != callee->lformals->child_count) {
+        return -1;
+    }
+
+    int temps[LJIT_MAX_ARGS];
+    for (int i = 0; i < count; i++) {
+        temps[i] = lispyc_expr(c, args[i]);
+        if (temps[i] < 0) {
+            return -1;
+        }
+    }
+
+    int result = c->temps++;
+    lispyc_printf(lispyc_line(c), "long t%d;\n", result);
+    char cond[256];
+    int len = snprintf(cond, sizeof(cond), "lc_fun_%d(limit, ",
+                       (int)(callee - c->defs));
+    for (int i = 0; i < count; i++) {
+        len += snprintf(cond + len, sizeof(cond) - (size_t)len, "t%d, ",
+                        temps[i]);
+    }
+    snprintf(cond + len, sizeof(cond) - (size_t)len, "&t%d)", result);
+    lispyc_bail(c, cond);
+    return result;
+}
+
+// A S-Expression (or a body) applying a builtin or a compiled lambda
+static int lispyc_sexpr(Lc *c, LVal *lval) {
+    if (lval->child_count == 0) {
+        return -1;
+    }
+    if (lval->child_count == 1) {
+        return lispyc_expr(c, lval->children[0]);
+    }
+
+    LVal *lhead = lval->children[0];
+    if (lhead->type != LVAL_SYM ||
+        lispyc_formal(c->def->lformals, lhead->sym) >= 0) {
+        return -1;
+    }
+    LVal **args = lval->children + 1;
+    int count = lval->child_count - 1;
+
+    int op = lispyc_op(c, lhead);
+    if (op >= 0) {
+        switch (lispyc_ops[op].kind) {
+            case LISPYC_IF:
+                return lispyc_if(c, args, count);
+            case LISPYC_CMP:
+                return lispyc_cmp(c, op, args, count);
+            default:
+                return lispyc_arith(c, op, args, count);
+        }
+    }
+
+    LcDef *callee = lispyc_find(c, lhead->sym);
+    if (!callee || callee->defs != 1 || !callee->ok) {
+        return -1;
+    }
+    lispyc_dep(c, (int)(callee - c->defs));
+    return lispyc_call(c, callee, args, count);
+}
+
+static int lispyc_expr(Lc *c, LVal *lval) {
+    if (++c->depth > LISPYC_MAX_DEPTH) {
+        return -1;
+    }
+
+    int temp = -1;
+    switch (lval->type) {
+        case LVAL_NUM:
+            temp = lispyc_temp(c, lval->num, -1);
+            break;
+        case LVAL_SYM: {
+            int index = lispyc_formal(c->def->lformals, lval->sym);
+            if (index >= 0) {
+                temp = lispyc_temp(c, 0, index);
+                break;
+            }
+            // Global numbers are compiled in as constants
+            LcDef *def = lispyc_find(c, lval->sym);
+            if (def && def->defs == 1 && def->is_num) {
+                lispyc_dep(c, (int)(def - c->defs));
+                temp = lispyc_temp(c, def->num, -1);
+            }
+            break;
+        }
+        case LVAL_SEXPR:
+            temp = lispyc_sexpr(c, lval);
+            break;
+    }
+
+    c->depth -= 1;
+    return temp;
+}
+
+// Compile a lambda into a C function, 0 if it can't be
+static int lispyc_compile(Lc *c, LcDef *def) {
+    lbuf_free(&def->code);
+    lbuf_init_str(&def->code);
+    free(def->deps);
+    def->deps = NULL;
+    def->dep_count = 0;
+
+    c->def = def;
+    c->temps = 0;
+    c->indent = 1;
+    c->depth = 0;
+
+    LBuf *code = &def->code;
+    lispyc_printf(code, "static int lc_fun_%d(uintptr_t limit, ",
+                  (int)(def - c->defs));
+    for (int i = 0; i < def->lformals->child_count; i++) {
+        lispyc_printf(code, "long a%d, ", i);
+    }
+    lbuf_puts(code, "long *out) {\n");
+    lbuf_puts(code, "    char marker;\n");
+    lispyc_bail(c, "(uintptr_t)&marker < limit");
+
+    int result = lispyc_sexpr(c, def->lbody);
+    if (result < 0) {
+        return 0;
+    }
+    lispyc_printf(code, "    *out = t%d;\n", result);
+    lbuf_puts(code, "    return 0;\n}\n\n");
+    return 1;
+}
+
+// Whether a lambda called (directly or not) by `def` depends on a name
+// which is a formal of `def`. Interpreted, dynamic scoping would make it
+// see the formal rather than the global
+static int lispyc_shadows(Lc *c, LcDef *def) {
+    char *seen = calloc((size_t)c->def_count, 1);
+    int *queue = malloc(sizeof(int) * (size_t)c->def_count);
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = (int)(def - c->defs);
+    seen[queue[0]] = 1;
+
+    int shadows = 0;
+    while (!shadows && head < tail) {
+        LcDef *fun = &c->defs[queue[head++]];
+        for (int i = 0; !shadows && i < fun->dep_count; i++) {
+            int dep = fun->deps[i];
+            const char *sym =
+                dep < 0 ? lispyc_ops[-1 - dep].sym : c->defs[dep].sym;
+            shadows = lispyc_formal(def->lformals, sym) >= 0;
+            if (dep >= 0 && !c->defs[dep].is_num && !seen[dep]) {
+                seen[dep] = 1;
+                queue[tail++] = dep;
+            }
+        }
+    }
+
+    free(seen);
+    free(queue);
+    return shadows;
+}
+
+// Compile every lambda bound once, until all left call only compiled ones
+static void lispyc_compile_all(Lc *c) {
+    for (int i = 0; i < c->def_count; i++) {
+        lbuf_init_str(&c->defs[i].code);
+        c->defs[i].ok = c->defs[i].defs == 1 && c->defs[i].lformals;
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < c->def_count; i++) {
+            if (c->defs[i].ok && (!lispyc_compile(c, &c->defs[i]) ||
+                                  lispyc_shadows(c, &c->defs[i]))) {
+                c->defs[i].ok = 0;
+                changed = 1;
+            }
+        }
+    }
+}
+
+// Dependencies of a lambda and every lambda it calls
+static void lispyc_put_deps(Lc *c, LBuf *lbuf, LcDef *def) {
+    char *seen = calloc((size_t)c->def_count + LISPYC_OP_COUNT, 1);
+    int *queue = malloc(sizeof(int) * (size_t)c->def_count);
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = (int)(def - c->defs);
+    seen[queue[0]] = 1;
+
+    lispyc_printf(lbuf, "static const LAotDep lc_deps_%d[] = {\n",
+                  (int)(def - c->defs));
+    while (head < tail) {
+        LcDef *fun = &c->defs[queue[head++]];
+        lbuf_puts(lbuf, "    {");
+        lispyc_put_str(lbuf, fun->sym);
+        lispyc_printf(lbuf, ", LAOT_FUN, %dL},\n", fun->index);
+
+        for (int i = 0; i < fun->dep_count; i++) {
+            int dep = fun->deps[i];
+            int slot = dep < 0 ? c->def_count - 1 - dep : dep;
+            if (seen[slot]) {
+                continue;
+            }
+            seen[slot] = 1;
+            if (dep >= 0 && !c->defs[dep].is_num) {
+                queue[tail++] = dep;
+                continue;
+            }
+
+            lbuf_puts(lbuf, "    {");
+            if (dep < 0) {
+                lispyc_put_str(lbuf, lispyc_ops[-1 - dep].sym);
+                lbuf_puts(lbuf, ", LAOT_BUILTIN, 0L},\n");
+            } else {
+                lispyc_put_str(lbuf, c->defs[dep].sym);
+                lbuf_puts(lbuf, ", LAOT_NUM, ");
+                lispyc_put_num(lbuf, c->defs[dep].num);
+                lbuf_puts(lbuf, "},\n");
+            }
+        }
+    }
+    lbuf_puts(lbuf, "};\n\n");
+
+    // Every compiled lambda depends on itself at least
+    def->dep_total = 0;
+    for (int i = 0; i < c->def_count + LISPYC_OP_COUNT; i++) {
+        def->dep_total += seen[i];
+    }
+
+    free(seen);
+    free(queue);
+}
+
+static int lispyc_emit(Lc *c, LBuf *lbuf, const char *path, LVal *lforms) {
+    lbuf_puts(lbuf, "/* Generated by lispyc from ");
+    lispyc_put_str(lbuf, path);
+    lbuf_puts(lbuf, " */\n\n#include <stdint.h>\n#include \"laot.h\"\n\n");
+
+    int fun_count = 0;
+    for (int i = 0; i < c->def_count; i++) {
+        if (c->defs[i].ok) {
+            c->defs[i].index = fun_count++;
+            lispyc_printf(lbuf, "static int lc_fun_%d(uintptr_t limit, ", i);
+            for (int j = 0; j < c->defs[i].lformals->child_count; j++) {
+                lbuf_puts(lbuf, "long, ");
+            }
+            lbuf_puts(lbuf, "long *out);\n");
+        }
+    }
+    if (fun_count) {
+        lbuf_putc(lbuf, '\n');
+    }
+
+    char name[64];
+    for (int i = 0; i < c->def_count; i++) {
+        LcDef *def = &c->defs[i];
+        if (!def->ok) {
+            continue;
+        }
+        lbuf_putn(lbuf, def->code.data, def->code.len);
+
+        // Called as compiled by the JIT (@see LJitFn)
+        lispyc_printf(lbuf,
+                      "static int lc_entry_%d(const long *args, long *result, "
+                      "uintptr_t limit) {\n    return lc_fun_%d(limit, ",
+                      i, i);
+        for (int j = 0; j < def->lformals->child_count; j++) {
+            lispyc_printf(lbuf, "args[%d], ", j);
+        }
+        lbuf_puts(lbuf, "result);\n}\n\n");
+
+        LVal *lsrc = lval_add(lval_wrap_sexpr(), lval_copy(def->lformals));
+        lsrc = lval_add(lsrc, lval_copy(def->lbody));
+        snprintf(name, sizeof(name), "lc_src_%d", i);
+        int ok = lispyc_put_bytes(lbuf, name, lsrc);
+        lval_del(lsrc);
+        if (!ok) {
+            return 0;
+        }
+        lispyc_put_deps(c, lbuf, def);
+    }
+
+    if (fun_count) {
+        lbuf_puts(lbuf, "static const LAotFun lc_funs[] = {\n");
+        for (int i = 0; i < c->def_count; i++) {
+            if (c->defs[i].ok) {
+                lbuf_puts(lbuf, "    {");
+                lispyc_put_str(lbuf, c->defs[i].sym);
+                lispyc_printf(lbuf,
+                              ", lc_src_%d, sizeof(lc_src_%d), lc_entry_%d,"
+                              " lc_deps_%d, %d},\n",
+                              i, i, i, i, c->defs[i].dep_total);
+            }
+        }
+        lbuf_puts(lbuf, "};\n\n");
+    }
+
+    if (!lispyc_put_bytes(lbuf, "lc_forms", lforms)) {
+        return 0;
+    }
+
+    lbuf_puts(lbuf, "const LAotProgram lispyc_program = {");
+    lispyc_put_str(lbuf, path);
+    lbuf_puts(lbuf, ", lc_forms, sizeof(lc_forms), ");
+    lbuf_puts(lbuf, fun_count ? "lc_funs, " : "NULL, ");
+    lispyc_printf(lbuf, "%d};\n\n", fun_count);
+
+    lbuf_puts(lbuf,
+              "#ifndef LISPYC_NO_MAIN\n"
+              "int main(void) { return laot_main(&lispyc_program); }\n"
+              "#endif\n");
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    const char *out = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s FILE.lspy [-o FILE.c]\n", argv[0]);
+        return 2;
+    }
+
+    parser_init();
+    mpc_result_t result;
+    if (!mpc_parse_contents(path, Notation, &result)) {
+        mpc_err_print(result.error);
+        mpc_err_delete(result.error);
+        parser_cleanup();
+        return 1;
+    }
+    LVal *lforms = lval_read_ast(result.output);
+    mpc_ast_delete(result.output);
+
+    Lc c;
+    c.defs = NULL;
+    c.def_count = 0;
+    for (int i = 0; i < lforms->child_count; i++) {
+        lispyc_scan(&c, lforms->children[i]);
+    }
+    lispyc_compile_all(&c);
+
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    int status = 0;
+    if (!lispyc_emit(&c, &lbuf, path, lforms)) {
+        fprintf(stderr, "%s: only numbers in range can be compiled\n", path);
+        status = 1;
+    } else {
+        FILE *file = out ? fopen(out, "w") : stdout;
+        if (!file || fwrite(lbuf.data, 1, lbuf.len, file) != lbuf.len ||
+            (out && fclose(file) != 0)) {
+            perror(out ? out : "stdout");
+            status = 1;
+        }
+    }
+    lbuf_free(&lbuf);
+
+    for (int i = 0; i < c.def_count; i++) {
+        lbuf_free(&c.defs[i].code);
+        free(c.defs[i].deps);
+    }
+    free(c.defs);
+    lval_del(lforms);
+    parser_cleanup();
+    return status;
+}
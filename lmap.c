@@ -0,0 +1,348 @@
+#include "lmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Hash bits past which a LMapNode holds colliding entries */
+#define LMAP_HASH_BITS 64
+
+// FNV-1a, seeded with the type so eg: "a" and a are different keys
+static uint64_t lmap_hash(LVal *key) {
+    uint64_t hash = 14695981039346656037ULL ^ (uint64_t)key->type;
+    if (key->type == LVAL_NUM) {
+        // Mix the bits of numbers so sequential keys spread over the slots
+        hash ^= (uint64_t)key->num;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    const char *bytes = key->type == LVAL_STR ? key->str : key->sym;
+    for (size_t i = 0; i < key->len; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Bit of the slot of `hash` in the bitmap of a node at `shift`
+static uint32_t lmap_bit(uint64_t hash, int shift) {
+    return (uint32_t)1 << ((hash >> shift) & ((1 << LMAP_BITS) - 1));
+}
+
+// Index among the slots present of the slot of `bit`
+static int lmap_pos(LMapNode *node, uint32_t bit) {
+    return __builtin_popcount(node->bitmap & (bit - 1));
+}
+
+static LMapNode *lmap_node_new(int count) {
+    LMapNode *node =
+        malloc(sizeof(LMapNode) + sizeof(LMapSlot) * (size_t)count);
+    node->refs = 1;
+    node->bitmap = 0;
+    node->nodemap = 0;
+    node->count = 0;
+    return node;
+}
+
+// Depth is bounded by LMAP_DEPTH, so recursing is safe
+static void lmap_node_del(LMapNode *node) {
+    if (LATOMIC_ADD(node->refs, -1) > 0) {
+        return;
+    }
+
+    // Colliding entries have no bitmap, every bit is then 0
+    uint32_t bits = node->bitmap;
+    for (int i = 0; i < node->count; i++) {
+        uint32_t bit = bits & -bits;
+        bits &= bits - 1;
+        if (node->nodemap & bit) {
+            lmap_node_del(node->slots[i].node);
+        } else {
+            lval_del(node->slots[i].entry.key);
+            lval_del(node->slots[i].entry.val);
+        }
+    }
+    free(node);
+}
+
+// The node at `*ref`, first replaced by a copy if it is shared
+static LMapNode *lmap_node_own(LMapNode **ref) {
+    LMapNode *node = *ref;
+    if (LATOMIC_GET(node->refs) == 1) {
+        return node;
+    }
+
+    LMapNode *copy = lmap_node_new(node->count);
+    copy->bitmap = node->bitmap;
+    copy->nodemap = node->nodemap;
+    copy->count = node->count;
+    uint32_t bits = node->bitmap;
+    for (int i = 0; i < node->count; i++) {
+        uint32_t bit = bits & -bits;
+        bits &= bits - 1;
+        if (node->nodemap & bit) {
+            copy->slots[i].node = node->slots[i].node;
+            LATOMIC_ADD(copy->slots[i].node->refs, 1);
+        } else {
+            copy->slots[i].entry.key = lval_copy(node->slots[i].entry.key);
+            copy->slots[i].entry.val = lval_copy(node->slots[i].entry.val);
+            copy->slots[i].entry.hash = node->slots[i].entry.hash;
+        }
+    }
+
+    // The other references may have been dropped meanwhile
+    lmap_node_del(node);
+    *ref = copy;
+    return copy;
+}
+
+// Make room for a slot at `pos` of an owned node
+static LMapSlot *lmap_node_insert(LMapNode **ref, int pos) {
+    LMapNode *node = *ref;
+    node = realloc(node, sizeof(LMapNode) +
+                             sizeof(LMapSlot) * (size_t)(node->count + 1));
+    memmove(&node->slots[pos + 1], &node->slots[pos],
+            sizeof(LMapSlot) * (size_t)(node->count - pos));
+    node->count += 1;
+    *ref = node;
+    return &node->slots[pos];
+}
+
+// Close the slot at `pos` of an owned node
+static void lmap_node_erase(LMapNode *node, int pos) {
+    memmove(&node->slots[pos], &node->slots[pos + 1],
+            sizeof(LMapSlot) * (size_t)(node->count - pos - 1));
+    node->count -= 1;
+}
+
+// Insert or replace a key below `*ref`, returns 1 if the key is new
+static int lmap_node_put(LMapNode **ref, int shift, LVal *key, LVal *val,
+                         uint64_t hash) {
+    LMapNode *node = lmap_node_own(ref);
+
+    if (shift >= LMAP_HASH_BITS) {
+        for (int i = 0; i < node->count; i++) {
+            LMapEntry *entry = &node->slots[i].entry;
+            if (lval_eq(entry->key, key)) {
+                lval_del(key);
+                lval_del(entry->val);
+                entry->val = val;
+                return 0;
+            }
+        }
+        LMapEntry *entry = &lmap_node_insert(ref, node->count)->entry;
+        entry->key = key;
+        entry->val = val;
+        entry->hash = hash;
+        return 1;
+    }
+
+    uint32_t bit = lmap_bit(hash, shift);
+    int pos = lmap_pos(node, bit);
+    if (!(node->bitmap & bit)) {
+        LMapEntry *entry = &lmap_node_insert(ref, pos)->entry;
+        entry->key = key;
+        entry->val = val;
+        entry->hash = hash;
+        (*ref)->bitmap |= bit;
+        return 1;
+    }
+
+    LMapSlot *slot = &node->slots[pos];
+    if (node->nodemap & bit) {
+        return lmap_node_put(&slot->node, shift + LMAP_BITS, key, val, hash);
+    }
+
+    LMapEntry *entry = &slot->entry;
+    if (entry->hash == hash && lval_eq(entry->key, key)) {
+        lval_del(key);
+        lval_del(entry->val);
+        entry->val = val;
+        return 0;
+    }
+
+    // Two keys share the slot, both move down into a new node
+    LMapNode *child = lmap_node_new(0);
+    lmap_node_put(&child, shift + LMAP_BITS, entry->key, entry->val,
+                  entry->hash);
+    slot->node = child;
+    node->nodemap |= bit;
+    return lmap_node_put(&slot->node, shift + LMAP_BITS, key, val, hash);
+}
+
+// Remove a key known to be below `*ref`
+static void lmap_node_remove(LMapNode **ref, int shift, LVal *key,
+                             uint64_t hash) {
+    LMapNode *node = lmap_node_own(ref);
+
+    if (shift >= LMAP_HASH_BITS) {
+        for (int i = 0; i < node->count; i++) {
+            LMapEntry *entry = &node->slots[i].entry;
+            if (lval_eq(entry->key, key)) {
+                lval_del(entry->key);
+                lval_del(entry->val);
+                lmap_node_erase(node, i);
+                return;
+            }
+        }
+        return;
+    }
+
+    uint32_t bit = lmap_bit(hash, shift);
+    int pos = lmap_pos(node, bit);
+    LMapSlot *slot = &node->slots[pos];
+    if (!(node->nodemap & bit)) {
+        lval_del(slot->entry.key);
+        lval_del(slot->entry.val);
+        lmap_node_erase(node, pos);
+        node->bitmap &= ~bit;
+        return;
+    }
+
+    lmap_node_remove(&slot->node, shift + LMAP_BITS, key, hash);
+
+    // A child left with a single entry is replaced by it, so lookups don't
+    // descend more than needed and emptied nodes go away
+    LMapNode *child = slot->node;
+    if (child->count == 1 && !child->nodemap) {
+        slot->entry = child->slots[0].entry;
+        node->nodemap &= ~bit;
+        free(child);
+    } else if (child->count == 0) {
+        lmap_node_erase(node, pos);
+        node->bitmap &= ~bit;
+        node->nodemap &= ~bit;
+        free(child);
+    }
+}
+
+LMap *lmap_new(void) {
+    LMap *lmap = malloc(sizeof(LMap));
+    lmap->refs = 1;
+    lmap->count = 0;
+    lmap->root = lmap_node_new(0);
+    return lmap;
+}
+
+void lmap_del(LMap *lmap) {
+    if (LATOMIC_ADD(lmap->refs, -1) > 0) {
+        return;
+    }
+
+    lmap_node_del(lmap->root);
+    free(lmap);
+}
+
+LMap *lmap_own(LMap *lmap) {
+    if (LATOMIC_GET(lmap->refs) == 1) {
+        return lmap;
+    }
+
+    // Nodes are copied lazily, as they are modified
+    LMap *clone = malloc(sizeof(LMap));
+    clone->refs = 1;
+    clone->count = lmap->count;
+    clone->root = lmap->root;
+    LATOMIC_ADD(clone->root->refs, 1);
+
+    // The other references may have been dropped meanwhile
+    lmap_del(lmap);
+    return clone;
+}
+
+int lmap_is_key(LVal *key) {
+    return key->type == LVAL_NUM || key->type == LVAL_STR ||
+           key->type == LVAL_SYM;
+}
+
+LVal *lmap_get(LMap *lmap, LVal *key) {
+    uint64_t hash = lmap_hash(key);
+    LMapNode *node = lmap->root;
+    for (int shift = 0; shift < LMAP_HASH_BITS; shift += LMAP_BITS) {
+        uint32_t bit = lmap_bit(hash, shift);
+        if (!(node->bitmap & bit)) {
+            return NULL;
+        }
+        LMapSlot *slot = &node->slots[lmap_pos(node, bit)];
+        if (node->nodemap & bit) {
+            node = slot->node;
+            continue;
+        }
+        return slot->entry.hash == hash && lval_eq(slot->entry.key, key)
+                   ? slot->entry.val
+                   : NULL;
+    }
+
+    for (int i = 0; i < node->count; i++) {
+        if (lval_eq(node->slots[i].entry.key, key)) {
+            return node->slots[i].entry.val;
+        }
+    }
+    return NULL;
+}
+
+void lmap_put(LMap *lmap, LVal *key, LVal *val) {
+    lmap->count += lmap_node_put(&lmap->root, 0, key, val, lmap_hash(key));
+}
+
+int lmap_remove(LMap *lmap, LVal *key) {
+    if (!lmap_get(lmap, key)) {
+        return 0;
+    }
+
+    lmap_node_remove(&lmap->root, 0, key, lmap_hash(key));
+    lmap->count -= 1;
+    return 1;
+}
+
+int lmap_eq(LMap *first, LMap *second) {
+    if (first == second || first->root == second->root) {
+        return 1;
+    }
+    if (first->count != second->count) {
+        return 0;
+    }
+
+    LMapIter iter;
+    lmap_iter_init(&iter, first);
+    for (LMapEntry *entry; (entry = lmap_iter_next(&iter));) {
+        LVal *val = lmap_get(second, entry->key);
+        if (!val || !lval_eq(val, entry->val)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void lmap_iter_init(LMapIter *iter, LMap *lmap) {
+    iter->nodes[0] = lmap->root;
+    iter->pos[0] = 0;
+    iter->bits[0] = lmap->root->bitmap;
+    iter->depth = 1;
+}
+
+LMapEntry *lmap_iter_next(LMapIter *iter) {
+    while (iter->depth > 0) {
+        int top = iter->depth - 1;
+        LMapNode *node = iter->nodes[top];
+        if (iter->pos[top] == node->count) {
+            iter->depth -= 1;
+            continue;
+        }
+
+        uint32_t bits = iter->bits[top];
+        uint32_t bit = bits & -bits;
+        iter->bits[top] = bits & (bits - 1);
+        LMapSlot *slot = &node->slots[iter->pos[top]++];
+        if (!(node->nodemap & bit)) {
+            return &slot->entry;
+        }
+
+        iter->nodes[top + 1] = slot->node;
+        iter->pos[top + 1] = 0;
+        iter->bits[top + 1] = slot->node->bitmap;
+        iter->depth += 1;
+    }
+    return NULL;
+}
@@ -0,0 +1,157 @@
+#ifndef LMAP_H
+#define LMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lval.h"
+
+/* Bits of the hash consumed by each level of a LMap's trie */
+#define LMAP_BITS 5
+/* Levels of a LMap's trie, the last one holding keys whose hashes are equal */
+#define LMAP_DEPTH 14
+
+/**
+ * @brief  A key of a LMap and its value
+ */
+typedef struct LMapEntry {
+    LVal *key;
+    LVal *val;
+    /* Hash of `key`, kept to skip comparisons and rehashing */
+    uint64_t hash;
+} LMapEntry;
+
+typedef struct LMapNode LMapNode;
+
+/**
+ * @brief  A slot of a LMapNode, either an entry or a child node
+ */
+typedef union LMapSlot {
+    LMapEntry entry;
+    LMapNode *node;
+} LMapSlot;
+
+/**
+ * @brief  Node of a LMap's trie, shared (and reference counted) by all the
+ *         LMap's it is part of
+ * @note   Each level indexes LMAP_BITS more bits of the hash, only the slots
+ *         present being allocated. Nodes past the hash bits hold colliding
+ *         entries, without a bitmap
+ */
+struct LMapNode {
+    int refs;
+
+    /* Slots present, by the LMAP_BITS of the hash of this level */
+    uint32_t bitmap;
+    /* Those of them holding a child node rather than an entry */
+    uint32_t nodemap;
+    int count;
+    LMapSlot slots[];
+};
+
+/**
+ * @brief  Hash map from numbers, strings or symbols to LVals
+ * @note   Hash array mapped trie, shared (and reference counted) by all copies
+ *         of a LVAL_MAP, modified only through lmap_own. Modifying a map
+ *         copies only the nodes on the path to the key which are shared with
+ *         another map, so building a map one `dict-put` at a time is
+ *         O(log n) per key even if every version is kept
+ */
+struct LMap {
+    int refs;
+
+    /* Number of keys */
+    size_t count;
+    LMapNode *root;
+};
+
+/**
+ * @brief  Position of a walk over the entries of a LMap
+ */
+typedef struct LMapIter {
+    LMapNode *nodes[LMAP_DEPTH];
+    /* Next slot of each node and the bitmap bits from there */
+    int pos[LMAP_DEPTH];
+    uint32_t bits[LMAP_DEPTH];
+    int depth;
+} LMapIter;
+
+/**
+ * @brief  Create an empty LMap
+ * @retval A LMap with a single reference
+ */
+LMap *lmap_new(void);
+
+/**
+ * @brief  Drop a reference to a LMap, deleting its contents with the last one
+ * @param  *lmap: A LMap
+ * @retval None
+ */
+void lmap_del(LMap *lmap);
+
+/**
+ * @brief  Get a LMap which can be modified in place of `lmap`
+ * @note   Copy on write, `lmap` is cloned only if it is shared. The clone
+ *         shares the nodes, which lmap_put and lmap_remove copy as needed
+ * @param  *lmap: A LMap whose reference is handed over
+ * @retval `lmap` itself or a clone of it, with a single reference
+ */
+LMap *lmap_own(LMap *lmap);
+
+/**
+ * @brief  Check whether a LVal can be used as a key
+ * @param  *key: A LVal
+ * @retval 1 for numbers, strings and symbols, 0 otherwise
+ */
+int lmap_is_key(LVal *key);
+
+/**
+ * @brief  Look up a key
+ * @param  *lmap: A LMap
+ * @param  *key: The key, not consumed
+ * @retval The value which still belongs to the LMap, or NULL if not found
+ */
+LVal *lmap_get(LMap *lmap, LVal *key);
+
+/**
+ * @brief  Insert or replace the value of a key
+ * @param  *lmap: A LMap with a single reference
+ * @param  *key: The key, consumed
+ * @param  *val: The value, consumed
+ * @retval None
+ */
+void lmap_put(LMap *lmap, LVal *key, LVal *val);
+
+/**
+ * @brief  Remove a key along with its value
+ * @param  *lmap: A LMap with a single reference
+ * @param  *key: The key, not consumed
+ * @retval 1 if the key was found, 0 otherwise
+ */
+int lmap_remove(LMap *lmap, LVal *key);
+
+/**
+ * @brief  Compare two LMap's regardless of the order of their keys
+ * @param  *first: The first LMap
+ * @param  *second: The second LMap
+ * @retval 1 if they have the same keys with equal values, 0 otherwise
+ */
+int lmap_eq(LMap *first, LMap *second);
+
+/**
+ * @brief  Start a walk over the entries of a LMap
+ * @note   Entries come ordered by hash. `lmap` must not be modified during
+ *         the walk
+ * @param  *iter: The LMapIter to set up
+ * @param  *lmap: A LMap
+ * @retval None
+ */
+void lmap_iter_init(LMapIter *iter, LMap *lmap);
+
+/**
+ * @brief  Advance a walk over the entries of a LMap
+ * @param  *iter: A LMapIter set up by lmap_iter_init
+ * @retval The next entry, which still belongs to the LMap, or NULL at the end
+ */
+LMapEntry *lmap_iter_next(LMapIter *iter);
+
+#endif /* lmap.h */
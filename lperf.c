@@ -0,0 +1,123 @@
+#define _DEFAULT_SOURCE
+
+#include "lperf.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+const char *const lperf_names[LPERF_COUNTERS] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"};
+
+static long lperf_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+#ifdef __linux__
+
+static const unsigned long long lperf_configs[LPERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// Open a counter of the calling thread, disabled until lperf_start is done
+static int lperf_open(unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void lperf_start(LPerf *lperf) {
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        lperf->fds[i] = lperf_open(lperf_configs[i]);
+    }
+
+    // Enabled last, so opening isn't counted
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        if (lperf->fds[i] >= 0) {
+            ioctl(lperf->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(lperf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    lperf->start_ns = lperf_now();
+}
+
+void lperf_stop(LPerf *lperf) {
+    lperf->ns = lperf_now() - lperf->start_ns;
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        if (lperf->fds[i] >= 0) {
+            ioctl(lperf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        lperf->counts[i] = -1;
+        if (lperf->fds[i] < 0) {
+            continue;
+        }
+
+        // Value, time enabled, time running
+        unsigned long long values[3];
+        if (read(lperf->fds[i], values, sizeof(values)) ==
+                (ssize_t)sizeof(values) &&
+            values[2] > 0) {
+            double scale = values[2] < values[1]
+                               ? (double)values[1] / (double)values[2]
+                               : 1.0;
+            lperf->counts[i] = (long)((double)values[0] * scale);
+        }
+        close(lperf->fds[i]);
+        lperf->fds[i] = -1;
+    }
+}
+
+#else
+
+void lperf_start(LPerf *lperf) {
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        lperf->fds[i] = -1;
+    }
+    lperf->start_ns = lperf_now();
+}
+
+void lperf_stop(LPerf *lperf) {
+    lperf->ns = lperf_now() - lperf->start_ns;
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        lperf->counts[i] = -1;
+    }
+}
+
+#endif
+
+void lperf_print(LBuf *lbuf, const LPerf *lperf) {
+    lbuf_put_long(lbuf, lperf->ns / 1000000);
+    lbuf_putc(lbuf, '.');
+    long frac = lperf->ns / 1000 % 1000;
+    lbuf_putc(lbuf, (char)('0' + frac / 100));
+    lbuf_putc(lbuf, (char)('0' + frac / 10 % 10));
+    lbuf_putc(lbuf, (char)('0' + frac % 10));
+    lbuf_puts(lbuf, " ms");
+
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        if (lperf->counts[i] >= 0) {
+            lbuf_puts(lbuf, ", ");
+            lbuf_put_long(lbuf, lperf->counts[i]);
+            lbuf_putc(lbuf, ' ');
+            lbuf_puts(lbuf, lperf_names[i]);
+        }
+    }
+}
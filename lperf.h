@@ -0,0 +1,61 @@
+#ifndef LPERF_H
+#define LPERF_H
+
+#include "lbuf.h"
+
+/* Hardware counters read by a LPerf, indexes of LPerf.counts */
+enum {
+    LPERF_CYCLES,
+    LPERF_INSTRUCTIONS,
+    LPERF_CACHE_MISSES,
+    LPERF_BRANCH_MISSES,
+    LPERF_COUNTERS
+};
+
+/* Names of the counters, as reported by measure and `--perf` */
+extern const char *const lperf_names[LPERF_COUNTERS];
+
+/**
+ * @brief  Wall time and hardware counters of a stretch of code
+ * @note   Counters are read with Linux perf_event_open, counting user space
+ *         of the calling OS thread only. Where they can't be opened (eg: no
+ *         PMU in a VM, perf_event_paranoid, not Linux) only the wall time is
+ *         measured, from clock_gettime
+ */
+typedef struct LPerf {
+    /* Descriptors of the counters, -1 if unavailable */
+    int fds[LPERF_COUNTERS];
+    /* CLOCK_MONOTONIC at lperf_start */
+    long start_ns;
+
+    /* Set by lperf_stop, counts are -1 if unavailable */
+    long ns;
+    long counts[LPERF_COUNTERS];
+} LPerf;
+
+/**
+ * @brief  Open the counters and start measuring
+ * @param  *lperf: The LPerf to be initialized
+ * @retval None
+ */
+void lperf_start(LPerf *lperf);
+
+/**
+ * @brief  Stop measuring, read the counters and close them
+ * @note   Counts of counters multiplexed with other events are scaled to the
+ *         time they were enabled
+ * @param  *lperf: A LPerf started by lperf_start
+ * @retval None
+ */
+void lperf_stop(LPerf *lperf);
+
+/**
+ * @brief  Print what a LPerf measured, eg: `1.250 ms, 2100 cycles, ...`
+ * @note   Unavailable counters are left out
+ * @param  *lbuf: LBuf to print to
+ * @param  *lperf: A LPerf stopped by lperf_stop
+ * @retval None
+ */
+void lperf_print(LBuf *lbuf, const LPerf *lperf);
+
+#endif /* lperf.h */
@@ -0,0 +1,485 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "lser.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lbig.h"
+#include "lfile.h"
+#include "lmap.h"
+
+/* Start of every cache file */
+#define LSER_MAGIC "LSPYC"
+#define LSER_MAGIC_LEN 5
+
+/* Start of every dump, followed by LSER_VERSION */
+#define LSER_DUMP_MAGIC "LSPYD"
+
+static void lser_put_varint(LBuf *lbuf, unsigned long long u) {
+    while (u >= 0x80) {
+        lbuf_putc(lbuf, (char)(u | 0x80));
+        u >>= 7;
+    }
+    lbuf_putc(lbuf, (char)u);
+}
+
+// Zigzag so numbers of small magnitude take few bytes either sign
+static void lser_put_signed(LBuf *lbuf, long long num) {
+    lser_put_varint(lbuf, ((unsigned long long)num << 1) ^
+                              (unsigned long long)(num < 0 ? -1 : 0));
+}
+
+static int lser_get_varint(const char **cur, const char *end,
+                           unsigned long long *u) {
+    *u = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*cur == end) {
+            return 0;
+        }
+        unsigned char byte = (unsigned char)*(*cur)++;
+        *u |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int lser_get_signed(const char **cur, const char *end,
+                           long long *num) {
+    unsigned long long u;
+    if (!lser_get_varint(cur, end, &u)) {
+        return 0;
+    }
+    *num = (long long)(u >> 1) ^ -(long long)(u & 1);
+    return 1;
+}
+
+// Encode a LVal, pushing its children on `work` to be encoded after it
+static int lser_encode_node(LBuf *lbuf, LVal *lval, LWork *work) {
+    switch (lval->type) {
+        case LVAL_NUM:
+            lbuf_putc(lbuf, LSER_NUM);
+            lser_put_signed(lbuf, lval->num);
+            return 1;
+        case LVAL_BIG: {
+            LBig *lbig = lval->lbig;
+            lbuf_putc(lbuf, LSER_BIG);
+            lser_put_varint(lbuf, (unsigned long long)lbig->len << 1 |
+                                      (unsigned long long)lbig->neg);
+            for (int i = 0; i < lbig->len; i++) {
+                lser_put_varint(lbuf, lbig->limbs[i]);
+            }
+            return 1;
+        }
+        case LVAL_SYM:
+        case LVAL_STR:
+            lbuf_putc(lbuf, lval->type == LVAL_SYM ? LSER_SYM : LSER_STR);
+            lser_put_varint(lbuf, lval->len);
+            lbuf_putn(lbuf, lval->type == LVAL_SYM ? lval->sym : lval->str,
+                      lval->len);
+            return 1;
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            lbuf_putc(lbuf,
+                      lval->type == LVAL_SEXPR ? LSER_SEXPR : LSER_QEXPR);
+            lser_put_varint(lbuf, (unsigned long long)lval->child_count);
+            for (int i = lval->child_count - 1; i >= 0; i--) {
+                lwork_push(work, lval->children[i]);
+            }
+            return 1;
+        case LVAL_MAP: {
+            LMap *lmap = lval->lmap;
+            lbuf_putc(lbuf, LSER_MAP);
+            lser_put_varint(lbuf, lmap->count);
+
+            // Pushed in iteration order then reversed, so each key is
+            // popped first followed by its value
+            size_t base = work->len;
+            LMapIter iter;
+            lmap_iter_init(&iter, lmap);
+            for (LMapEntry *entry; (entry = lmap_iter_next(&iter));) {
+                lwork_push(work, entry->key);
+                lwork_push(work, entry->val);
+            }
+            for (size_t i = base, j = work->len - 1; i < j; i++, j--) {
+                void *item = work->items[i];
+                work->items[i] = work->items[j];
+                work->items[j] = item;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int lser_encode(LBuf *lbuf, LVal *lval) {
+    LWork work;
+    lwork_init(&work);
+    int ok = lser_encode_node(lbuf, lval, &work);
+    while (ok && work.len) {
+        ok = lser_encode_node(lbuf, lwork_pop(&work), &work);
+    }
+    lwork_free(&work);
+    return ok;
+}
+
+/* Expressions decoded by lser_decode_in are pushed on its LWork with the
+ * number of children they expect, shifted left by one, and this bit if
+ * they hold the keys and values of a dict */
+#define LSER_FRAME_MAP 1
+
+// Decode a LVal. Expressions and dicts come back as expressions without
+// children, with room for the `*count` children to decode next: for a dict
+// its keys and values, `*map` being set
+static LVal *lser_decode_node(const char **cur, const char *end,
+                              LStrBuf *owner, size_t *count, int *map) {
+    *count = 0;
+    *map = 0;
+    if (*cur == end) {
+        return NULL;
+    }
+
+    char tag = *(*cur)++;
+    unsigned long long u;
+    switch (tag) {
+        case LSER_NUM: {
+            long long num;
+            if (!lser_get_signed(cur, end, &num)) {
+                return NULL;
+            }
+            return lval_wrap_long((long)num);
+        }
+        case LSER_BIG: {
+            // Every limb takes atleast a byte
+            if (!lser_get_varint(cur, end, &u) ||
+                u >> 1 > (unsigned long long)(end - *cur)) {
+                return NULL;
+            }
+            int len = (int)(u >> 1);
+            uint32_t *limbs = malloc(sizeof(uint32_t) * (size_t)(len + 1));
+            for (int i = 0; i < len; i++) {
+                unsigned long long limb;
+                if (!lser_get_varint(cur, end, &limb) || limb > 0xFFFFFFFFu) {
+                    free(limbs);
+                    return NULL;
+                }
+                limbs[i] = (uint32_t)limb;
+            }
+            LBig *lbig = lbig_from_limbs((int)(u & 1), limbs, len);
+            free(limbs);
+            return lval_wrap_big(lbig);
+        }
+        case LSER_SYM:
+        case LSER_STR: {
+            if (!lser_get_varint(cur, end, &u) ||
+                u > (unsigned long long)(end - *cur)) {
+                return NULL;
+            }
+            const char *bytes = *cur;
+            *cur += u;
+            if (tag == LSER_STR) {
+                return owner ? lval_wrap_view(owner, bytes, (size_t)u)
+                             : lval_wrap_strn(bytes, (size_t)u);
+            }
+            LVal *lsym = lval_wrap_symn(bytes, (size_t)u);
+            lsym->icache = licache_new();
+            return lsym;
+        }
+        case LSER_SEXPR:
+        case LSER_QEXPR:
+        case LSER_MAP: {
+            // Every child takes atleast 2 bytes, so a bogus count is caught
+            // before allocating anything for it
+            *map = tag == LSER_MAP;
+            if (!lser_get_varint(cur, end, &u) ||
+                u > (unsigned long long)(end - *cur) / (*map ? 4 : 2)) {
+                return NULL;
+            }
+            *count = (size_t)u * (*map ? 2 : 1);
+            LVal *lexpr =
+                tag == LSER_SEXPR ? lval_wrap_sexpr() : lval_wrap_qexpr();
+            if (*count) {
+                lexpr->children = malloc(sizeof(LVal *) * *count);
+            }
+            return lexpr;
+        }
+    }
+    return NULL;
+}
+
+// The dict of the keys and values decoded into `lexpr`, which is consumed,
+// or NULL if a key can't be one
+static LVal *lser_decode_map(LVal *lexpr) {
+    for (int i = 0; i < lexpr->child_count; i += 2) {
+        if (!lmap_is_key(lexpr->children[i])) {
+            lval_del(lexpr);
+            return NULL;
+        }
+    }
+
+    LMap *lmap = lmap_new();
+    for (int i = 0; i < lexpr->child_count; i += 2) {
+        lmap_put(lmap, lexpr->children[i], lexpr->children[i + 1]);
+    }
+    lexpr->child_count = 0;
+    lval_del(lexpr);
+    return lval_wrap_map(lmap);
+}
+
+// lser_decode, strings viewing the bytes if `owner` isn't NULL. Loops over
+// a LWork of the expressions being filled instead of recursing, so nesting
+// isn't limited by the C stack
+static LVal *lser_decode_in(const char **cur, const char *end,
+                            LStrBuf *owner) {
+    LWork work;
+    lwork_init(&work);
+    LVal *lval = NULL;
+    while (1) {
+        size_t count;
+        int map;
+        lval = lser_decode_node(cur, end, owner, &count, &map);
+        if (!lval) {
+            break;
+        }
+        if (count) {
+            lwork_push(&work, lval);
+            lwork_push(&work, (void *)(uintptr_t)(count << 1 | (size_t)map));
+            continue;
+        }
+        if (map) {
+            lval = lser_decode_map(lval);
+        }
+
+        // Move the LVal into its parent, which is complete in turn once its
+        // last child is in
+        int placed = 0;
+        while (lval && work.len && !placed) {
+            size_t frame = (size_t)(uintptr_t)work.items[work.len - 1];
+            LVal *lexpr = work.items[work.len - 2];
+            lexpr->children[lexpr->child_count++] = lval;
+            placed = (size_t)lexpr->child_count < frame >> 1;
+            if (!placed) {
+                work.len -= 2;
+                lval = frame & LSER_FRAME_MAP ? lser_decode_map(lexpr)
+                                              : lexpr;
+            }
+        }
+
+        // Done with the outermost LVal, or failed
+        if (!placed) {
+            break;
+        }
+    }
+
+    // Expressions left were cut short, their decoded children go with them
+    while (work.len) {
+        lwork_pop(&work);
+        lval_del(lwork_pop(&work));
+    }
+    lwork_free(&work);
+    return lval;
+}
+
+LVal *lser_decode(const char **cur, const char *end) {
+    return lser_decode_in(cur, end, NULL);
+}
+
+LVal *lser_decode_view(const char **cur, const char *end, LStrBuf *owner) {
+    return lser_decode_in(cur, end, owner);
+}
+
+// Path of the cache of `path`, to be freed
+static char *lser_cache_path(const char *path) {
+    size_t len = strlen(path);
+    char *cache = malloc(len + 2);
+    memcpy(cache, path, len);
+    cache[len] = 'c';
+    cache[len + 1] = '\0';
+    return cache;
+}
+
+static void lser_put_header(LBuf *lbuf, LSerStamp *stamp) {
+    lbuf_putn(lbuf, LSER_MAGIC, LSER_MAGIC_LEN);
+    lser_put_varint(lbuf, LSER_VERSION);
+    lser_put_signed(lbuf, stamp->size);
+    lser_put_signed(lbuf, stamp->sec);
+    lser_put_signed(lbuf, stamp->nsec);
+}
+
+LVal *lser_cache_load(const char *path, LSerStamp *stamp) {
+    struct stat st;
+    stamp->ok = stat(path, &st) == 0;
+    if (!stamp->ok) {
+        return NULL;
+    }
+    stamp->size = (long long)st.st_size;
+    stamp->sec = (long long)st.st_mtim.tv_sec;
+    stamp->nsec = (long long)st.st_mtim.tv_nsec;
+    stamp->mode = (int)(st.st_mode & 0666);
+
+    char *cache = lser_cache_path(path);
+    FILE *file = fopen(cache, "rb");
+    free(cache);
+    if (!file) {
+        return NULL;
+    }
+
+    // The whole cache is read at once, it is decoded entirely anyway
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    char chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        lbuf_putn(&lbuf, chunk, got);
+    }
+    fclose(file);
+
+    size_t len;
+    char *data = lbuf_take(&lbuf, &len);
+    const char *cur = data;
+    const char *end = data + len;
+
+    // The header must match byte for byte what would be written now
+    LBuf header;
+    lbuf_init_str(&header);
+    lser_put_header(&header, stamp);
+    int valid =
+        header.len <= len && memcmp(header.data, data, header.len) == 0;
+    cur += header.len;
+    lbuf_free(&header);
+
+    LVal *lforms = NULL;
+    if (valid) {
+        lforms = lser_decode(&cur, end);
+        if (lforms && (lforms->type != LVAL_SEXPR || cur != end)) {
+            lval_del(lforms);
+            lforms = NULL;
+        }
+    }
+    free(data);
+    return lforms;
+}
+
+void lser_cache_save(const char *path, LSerStamp *stamp, LVal *lforms) {
+    if (!stamp->ok) {
+        return;
+    }
+
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lser_put_header(&lbuf, stamp);
+    if (!lser_encode(&lbuf, lforms)) {
+        lbuf_free(&lbuf);
+        return;
+    }
+
+    char *cache = lser_cache_path(path);
+    char *tmp = malloc(strlen(cache) + 8);
+    strcpy(tmp, cache);
+    strcat(tmp, ".XXXXXX");
+
+    // mkstemp creates files only the owner can read, caches are as readable
+    // as their source
+    int fd = mkstemp(tmp);
+    if (fd >= 0) {
+        fchmod(fd, (mode_t)stamp->mode);
+        size_t done = 0;
+        while (done < lbuf.len) {
+            ssize_t wrote = write(fd, lbuf.data + done, lbuf.len - done);
+            if (wrote < 0 && errno == EINTR) {
+                continue;
+            }
+            if (wrote <= 0) {
+                break;
+            }
+            done += (size_t)wrote;
+        }
+        if (close(fd) != 0 || done < lbuf.len || rename(tmp, cache) != 0) {
+            unlink(tmp);
+        }
+    }
+
+    free(tmp);
+    free(cache);
+    lbuf_free(&lbuf);
+}
+
+int lser_dump(const char *path, LVal *lval) {
+    char *tmp = malloc(strlen(path) + 8);
+    strcpy(tmp, path);
+    strcat(tmp, ".XXXXXX");
+
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        int err = errno;
+        free(tmp);
+        return err;
+    }
+
+    // mkstemp creates files only the owner can read, dumps are created as
+    // any other file
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+
+    LBuf lbuf;
+    lbuf_init_fd(&lbuf, fd);
+    lbuf_putn(&lbuf, LSER_DUMP_MAGIC, LSER_MAGIC_LEN);
+    lser_put_varint(&lbuf, LSER_VERSION);
+    int err = lser_encode(&lbuf, lval) ? 0 : -1;
+    lbuf_flush(&lbuf);
+    if (!err) {
+        err = lbuf.err;
+    }
+    lbuf_free(&lbuf);
+
+    if (close(fd) != 0 && !err) {
+        err = errno;
+    }
+    if (!err && rename(tmp, path) != 0) {
+        err = errno;
+    }
+    if (err) {
+        unlink(tmp);
+    }
+    free(tmp);
+    return err;
+}
+
+LVal *lser_undump(const char *path, int *err) {
+    LFile lfile;
+    *err = lfile_open(&lfile, path);
+    if (*err) {
+        return NULL;
+    }
+    lfile_read_all(&lfile);
+
+    const char *cur = lfile.data;
+    const char *end = cur + lfile.len;
+    unsigned long long version;
+    LVal *lval = NULL;
+    if (lfile.len > LSER_MAGIC_LEN &&
+        memcmp(cur, LSER_DUMP_MAGIC, LSER_MAGIC_LEN) == 0) {
+        cur += LSER_MAGIC_LEN;
+        if (lser_get_varint(&cur, end, &version) &&
+            version == LSER_VERSION) {
+            lval = lser_decode_view(&cur, end, lfile.owner);
+        }
+    }
+    if (lval && cur != end) {
+        lval_del(lval);
+        lval = NULL;
+    }
+
+    // Strings viewing the mapping keep it alive
+    lfile_close(&lfile);
+    if (!lval) {
+        *err = -1;
+    }
+    return lval;
+}
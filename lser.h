@@ -0,0 +1,111 @@
+#ifndef LSER_H
+#define LSER_H
+
+#include <stddef.h>
+#include "lbuf.h"
+#include "lval.h"
+
+/* Version of the encoding, caches and dumps of any other version are
+ * ignored */
+#define LSER_VERSION 2
+
+/* Tags of encoded LVal's */
+enum {
+    LSER_NUM = 'n',   /* Zigzag varint */
+    LSER_SYM = 'y',   /* Varint length, bytes */
+    LSER_STR = 's',   /* Varint length, bytes */
+    LSER_SEXPR = '(', /* Varint count, children */
+    LSER_QEXPR = '{', /* Varint count, children */
+    LSER_MAP = 'm',   /* Varint count, then each key followed by its value */
+    LSER_BIG = 'b'    /* Varint count of limbs * 2 + sign, varint limbs */
+};
+
+/**
+ * @brief  Size and modification time of a source file
+ * @note   A cache is valid only for the exact stamp it was written for
+ */
+typedef struct LSerStamp {
+    int ok;
+    long long size;
+    long long sec;
+    long long nsec;
+    /* Permissions given to the cache, not part of the stamp */
+    int mode;
+} LSerStamp;
+
+/**
+ * @brief  Append the binary encoding of a LVal to a LBuf
+ * @note   Varints are little endian base 128, so the encoding is portable
+ * @param  *lbuf: A LBuf with sink LBUF_STR
+ * @param  *lval: A LVal, only numbers, symbols, strings, expressions and
+ *         dicts can be encoded
+ * @retval 1 on success, 0 if `lval` holds anything else
+ */
+int lser_encode(LBuf *lbuf, LVal *lval);
+
+/**
+ * @brief  Decode a LVal encoded by lser_encode
+ * @note   Symbols get an inline cache, like symbols read from source
+ * @param  **cur: Start of the encoding, advanced past it
+ * @param  *end: End of the available bytes
+ * @retval The LVal, or NULL if the bytes are malformed
+ */
+LVal *lser_decode(const char **cur, const char *end);
+
+/**
+ * @brief  Decode a LVal encoded by lser_encode, strings viewing the bytes
+ * @note   Same as lser_decode, except strings are views into the bytes
+ *         (@see lval_wrap_view) instead of copies
+ * @param  **cur: Start of the encoding, advanced past it
+ * @param  *end: End of the available bytes
+ * @param  *owner: Owner of the mapping the bytes lie in
+ * @retval The LVal, or NULL if the bytes are malformed
+ */
+LVal *lser_decode_view(const char **cur, const char *end, LStrBuf *owner);
+
+/**
+ * @brief  Write a LVal to a file, encoded by lser_encode after a header
+ * @note   Streamed to a temporary file renamed over `path`, so the LVal is
+ *         never encoded whole in memory and readers never see a partial dump
+ * @param  *path: Path of the file
+ * @param  *lval: The LVal, not consumed
+ * @retval 0 on success, -1 if `lval` can't be encoded, else an errno value
+ */
+int lser_dump(const char *path, LVal *lval);
+
+/**
+ * @brief  Read a LVal written by lser_dump
+ * @note   The file is mapped rather than read, and long strings are views
+ *         into the mapping (@see lser_decode_view), which stays mapped as
+ *         long as any of them is alive
+ * @param  *path: Path of the file
+ * @param  *err: Set to 0, an errno value, or -1 if the file isn't a dump
+ *         of this LSER_VERSION
+ * @retval The LVal, or NULL on error
+ */
+LVal *lser_undump(const char *path, int *err);
+
+/**
+ * @brief  Read the cache of a source file, written by lser_cache_save
+ * @note   The cache of `path` lives next to it, at `path` followed by "c"
+ * @param  *path: Path of the source file
+ * @param  *stamp: Set to the stamp of the source file, `ok` is 0 if it
+ *         couldn't be taken
+ * @retval The forms of the source as a LVAL_SEXPR, or NULL if there's no
+ *         valid cache for the source as it is now
+ */
+LVal *lser_cache_load(const char *path, LSerStamp *stamp);
+
+/**
+ * @brief  Write the cache of a source file
+ * @note   Written to a temporary file renamed over the cache, so readers
+ *         never see a partial cache. Failures are ignored, the source is
+ *         parsed on the next load
+ * @param  *path: Path of the source file
+ * @param  *stamp: Stamp of the source taken before it was read
+ * @param  *lforms: The forms read from the source, not consumed
+ * @retval None
+ */
+void lser_cache_save(const char *path, LSerStamp *stamp, LVal *lforms);
+
+#endif /* lser.h */
@@ -0,0 +1,254 @@
+#include "lsort.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Bits of a radix sort digit, one pass each */
+#define LSORT_DIGIT 11
+#define LSORT_BUCKETS (1 << LSORT_DIGIT)
+
+/**
+ * @brief  A number moved through the passes of lsort_nums
+ * @note   The key is kept next to the pointer, so passes don't chase the
+ *         pointers into the elements
+ */
+typedef struct LSortKey {
+    unsigned long key;
+    LVal *lval;
+} LSortKey;
+
+static int lsort_less_num(LVal *first, LVal *second, void *ctx) {
+    (void)ctx;
+    return first->num < second->num;
+}
+
+// Bytes compared unsigned, a prefix orders before what it prefixes
+static int lsort_less_str(LVal *first, LVal *second, void *ctx) {
+    (void)ctx;
+    size_t len = first->len < second->len ? first->len : second->len;
+    int cmp = memcmp(first->str, second->str, len);
+    return cmp < 0 || (cmp == 0 && first->len < second->len);
+}
+
+static void lsort_swap(LVal **lvals, int i, int j) {
+    LVal *lval = lvals[i];
+    lvals[i] = lvals[j];
+    lvals[j] = lval;
+}
+
+// Stable, used for short ranges by both sorts
+static void lsort_insertion(LVal **lvals, int count, LLess less, void *ctx) {
+    for (int i = 1; i < count; i++) {
+        LVal *lval = lvals[i];
+        int j = i;
+        while (j > 0 && less(lval, lvals[j - 1], ctx)) {
+            lvals[j] = lvals[j - 1];
+            j--;
+        }
+        lvals[j] = lval;
+    }
+}
+
+static void lsort_sift(LVal **lvals, int root, int count, LLess less,
+                       void *ctx) {
+    LVal *lval = lvals[root];
+    while (2 * root + 1 < count) {
+        int child = 2 * root + 1;
+        if (child + 1 < count && less(lvals[child], lvals[child + 1], ctx)) {
+            child++;
+        }
+        if (!less(lval, lvals[child], ctx)) {
+            break;
+        }
+        lvals[root] = lvals[child];
+        root = child;
+    }
+    lvals[root] = lval;
+}
+
+static void lsort_heap(LVal **lvals, int count, LLess less, void *ctx) {
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        lsort_sift(lvals, i, count, less, ctx);
+    }
+    for (int end = count - 1; end > 0; end--) {
+        lsort_swap(lvals, 0, end);
+        lsort_sift(lvals, 0, end, less, ctx);
+    }
+}
+
+static void lsort_intro_range(LVal **lvals, int count, int depth, LLess less,
+                              void *ctx) {
+    while (count > LSORT_INSERTION) {
+        if (depth-- == 0) {
+            lsort_heap(lvals, count, less, ctx);
+            return;
+        }
+
+        // Median of the first, middle and last elements, moved to the front
+        int mid = count / 2;
+        if (less(lvals[mid], lvals[0], ctx)) {
+            lsort_swap(lvals, 0, mid);
+        }
+        if (less(lvals[count - 1], lvals[mid], ctx)) {
+            lsort_swap(lvals, mid, count - 1);
+            if (less(lvals[mid], lvals[0], ctx)) {
+                lsort_swap(lvals, 0, mid);
+            }
+        }
+        lsort_swap(lvals, 0, mid);
+        LVal *pivot = lvals[0];
+
+        // Both scans stop on elements equal to the pivot, so runs of equal
+        // elements are split evenly instead of degrading to O(n^2)
+        int i = 0;
+        int j = count;
+        while (1) {
+            do {
+                i++;
+            } while (i < count && less(lvals[i], pivot, ctx));
+            do {
+                j--;
+            } while (less(pivot, lvals[j], ctx));
+            if (i >= j) {
+                break;
+            }
+            lsort_swap(lvals, i, j);
+        }
+        lsort_swap(lvals, 0, j);
+
+        // Recurse into the shorter side, so the C stack stays O(log n)
+        if (j < count - j - 1) {
+            lsort_intro_range(lvals, j, depth, less, ctx);
+            lvals += j + 1;
+            count -= j + 1;
+        } else {
+            lsort_intro_range(lvals + j + 1, count - j - 1, depth, less, ctx);
+            count = j;
+        }
+    }
+    lsort_insertion(lvals, count, less, ctx);
+}
+
+void lsort_intro(LVal **lvals, int count, LLess less, void *ctx) {
+    int depth = 0;
+    for (int n = count; n > 1; n >>= 1) {
+        depth += 2;
+    }
+    lsort_intro_range(lvals, count, depth, less, ctx);
+}
+
+void lsort_nums(LVal **lvals, int count) {
+    if (count < LSORT_RADIX_MIN) {
+        lsort_intro(lvals, count, lsort_less_num, NULL);
+        return;
+    }
+
+    // Keys are offsets from the smallest number, so only the digits the
+    // range of the numbers spans are sorted on
+    size_t n = (size_t)count;
+    LSortKey *from = malloc(sizeof(LSortKey) * n * 2);
+    LSortKey *to = from + n;
+    LSortKey *keys = from;
+    long min = lvals[0]->num;
+    long max = min;
+    for (size_t i = 0; i < n; i++) {
+        long num = lvals[i]->num;
+        min = num < min ? num : min;
+        max = num > max ? num : max;
+        from[i].key = (unsigned long)num;
+        from[i].lval = lvals[i];
+    }
+    unsigned long range = (unsigned long)max - (unsigned long)min;
+    int digits = 0;
+    for (unsigned long rest = range; rest; rest >>= LSORT_DIGIT) {
+        digits++;
+    }
+
+    // Counts of every digit of the keys, taken in a single pass
+    size_t *counts = calloc((size_t)digits * LSORT_BUCKETS, sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        unsigned long key = from[i].key - (unsigned long)min;
+        from[i].key = key;
+        for (int d = 0; d < digits; d++) {
+            counts[d * LSORT_BUCKETS + ((key >> (LSORT_DIGIT * d)) &
+                                        (LSORT_BUCKETS - 1))]++;
+        }
+    }
+
+    for (int d = 0; d < digits; d++) {
+        size_t *bucket = counts + d * LSORT_BUCKETS;
+        int shift = LSORT_DIGIT * d;
+
+        // A digit every key shares doesn't reorder anything
+        if (bucket[(from[0].key >> shift) & (LSORT_BUCKETS - 1)] == n) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int b = 0; b < LSORT_BUCKETS; b++) {
+            size_t size = bucket[b];
+            bucket[b] = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < n; i++) {
+            to[bucket[(from[i].key >> shift) & (LSORT_BUCKETS - 1)]++] =
+                from[i];
+        }
+
+        LSortKey *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        lvals[i] = from[i].lval;
+    }
+    free(counts);
+    free(keys);
+}
+
+void lsort_strs(LVal **lvals, int count) {
+    lsort_intro(lvals, count, lsort_less_str, NULL);
+}
+
+static void lsort_merge_range(LVal **lvals, LVal **buf, int count, LLess less,
+                              void *ctx) {
+    if (count <= LSORT_INSERTION) {
+        lsort_insertion(lvals, count, less, ctx);
+        return;
+    }
+
+    int mid = count / 2;
+    lsort_merge_range(lvals, buf, mid, less, ctx);
+    lsort_merge_range(lvals + mid, buf, count - mid, less, ctx);
+
+    // Halves already in order (eg: sorted input) need no merging
+    if (!less(lvals[mid], lvals[mid - 1], ctx)) {
+        return;
+    }
+
+    // Only the first half is moved out, the merge never overtakes the second.
+    // Ties are taken from the first half, which keeps the sort stable
+    memcpy(buf, lvals, sizeof(LVal *) * (size_t)mid);
+    int i = 0;
+    int j = mid;
+    int k = 0;
+    while (i < mid && j < count) {
+        if (less(lvals[j], buf[i], ctx)) {
+            lvals[k++] = lvals[j++];
+        } else {
+            lvals[k++] = buf[i++];
+        }
+    }
+    while (i < mid) {
+        lvals[k++] = buf[i++];
+    }
+}
+
+void lsort_merge(LVal **lvals, int count, LLess less, void *ctx) {
+    if (count < 2) {
+        return;
+    }
+    LVal **buf = malloc(sizeof(LVal *) * (size_t)(count / 2));
+    lsort_merge_range(lvals, buf, count, less, ctx);
+    free(buf);
+}
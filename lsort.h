@@ -0,0 +1,70 @@
+#ifndef LSORT_H
+#define LSORT_H
+
+#include "lval.h"
+
+/* Below this many elements, numbers are sorted by comparison, not radix */
+#define LSORT_RADIX_MIN 256
+
+/* Below this many elements, a range is finished with insertion sort */
+#define LSORT_INSERTION 16
+
+/**
+ * @brief  Ordering of elements passed to the sorts
+ * @param  *first: An element
+ * @param  *second: Another element
+ * @param  *ctx: Context given to the sort
+ * @retval Non zero if `first` must come before `second`
+ */
+typedef int (*LLess)(LVal *first, LVal *second, void *ctx);
+
+/**
+ * @brief  Sort LVAL_NUMs ascending
+ * @note   LSD radix sort over 11 bit digits of the offsets of the numbers
+ *         from the smallest one, so numbers spanning a small range (eg: a
+ *         million of them within +-1M) take two passes, and 64 bit ones six.
+ *         Short arrays are sorted with lsort_intro instead
+ * @param  **lvals: Array of LVal of type LVAL_NUM
+ * @param  count: Number of elements
+ * @retval None
+ */
+void lsort_nums(LVal **lvals, int count);
+
+/**
+ * @brief  Sort LVAL_STRs ascending, by bytes compared as unsigned
+ * @note   A string orders before the strings it is a prefix of
+ *         (@see lsort_intro)
+ * @param  **lvals: Array of LVal of type LVAL_STR
+ * @param  count: Number of elements
+ * @retval None
+ */
+void lsort_strs(LVal **lvals, int count);
+
+/**
+ * @brief  Sort in place, not stable
+ * @note   Introsort: quicksort with a median of three pivot, switching to
+ *         heapsort past 2*log2(count) levels so the worst case stays
+ *         O(n log n), and to insertion sort for short ranges
+ * @param  **lvals: Array of LVal
+ * @param  count: Number of elements
+ * @param  less: Ordering of the elements
+ * @param  *ctx: Passed to `less`
+ * @retval None
+ */
+void lsort_intro(LVal **lvals, int count, LLess less, void *ctx);
+
+/**
+ * @brief  Sort stably, elements `less` doesn't order keep their order
+ * @note   Top down merge sort through a buffer of `count` pointers, with
+ *         insertion sort for short ranges. `less` is called O(n log n) times
+ *         and may fail: as long as it returns it, the array stays a
+ *         permutation of the elements
+ * @param  **lvals: Array of LVal
+ * @param  count: Number of elements
+ * @param  less: Ordering of the elements
+ * @param  *ctx: Passed to `less`
+ * @retval None
+ */
+void lsort_merge(LVal **lvals, int count, LLess less, void *ctx);
+
+#endif /* lsort.h */
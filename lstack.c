@@ -0,0 +1,83 @@
+#include "lstack.h"
+#include <stdlib.h>
+#include "ltask.h"
+
+/* Arguments and frames of the main program, tasks have their own */
+static LStack lstack_main = {NULL};
+
+static LStackChunk *lstack_chunk(LStackChunk *prev, size_t cap) {
+    LStackChunk *chunk = malloc(sizeof(LStackChunk) + sizeof(LStackSlot) * cap);
+    chunk->prev = prev;
+    chunk->next = NULL;
+    chunk->cap = cap;
+    chunk->len = 0;
+    return chunk;
+}
+
+void lstack_init(LStack *lstack) {
+    lstack->top = NULL;
+    lstack->borrows = 0;
+    lwork_init(&lstack->retired);
+}
+
+void lstack_free(LStack *lstack) {
+    LStackChunk *chunk = lstack->top;
+    if (chunk) {
+        free(chunk->next);
+    }
+    while (chunk) {
+        LStackChunk *prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+    lstack->top = NULL;
+    lwork_free(&lstack->retired);
+}
+
+// Slots covering `size` bytes
+static size_t lstack_slots(size_t size) {
+    return (size + sizeof(LStackSlot) - 1) / sizeof(LStackSlot);
+}
+
+void *lstack_push(LStack *lstack, size_t size) {
+    size_t count = lstack_slots(size);
+    LStackChunk *top = lstack->top;
+    if (!top) {
+        top = lstack->top = lstack_chunk(NULL, LSTACK_CHUNK);
+    }
+
+    // Pushes never straddle chunks, the rest of `top` is skipped
+    if (top->cap - top->len < count) {
+        LStackChunk *next = top->next;
+        if (next && next->cap < count) {
+            free(next);
+            next = NULL;
+        }
+        if (!next) {
+            next = top->next =
+                lstack_chunk(top, count > LSTACK_CHUNK ? count : LSTACK_CHUNK);
+        }
+        top = lstack->top = next;
+    }
+
+    LStackSlot *slots = top->slots + top->len;
+    top->len += count;
+    return slots;
+}
+
+void lstack_pop(LStack *lstack, size_t size) {
+    LStackChunk *top = lstack->top;
+    top->len -= lstack_slots(size);
+
+    // The emptied chunk is kept as the spare, a previous spare is freed
+    if (top->len == 0 && top->prev) {
+        free(top->next);
+        top->next = NULL;
+        lstack->top = top->prev;
+    }
+}
+
+LStack *lstack_self(void) {
+    LStack *lstack = ltask_lstack();
+    return lstack ? lstack : &lstack_main;
+}
@@ -0,0 +1,84 @@
+#ifndef LSTACK_H
+#define LSTACK_H
+
+#include <stddef.h>
+#include "lval.h"
+
+/* Slots of a LStackChunk, unless a single push needs more */
+#define LSTACK_CHUNK 4096
+
+/**
+ * @brief  Unit of allocation of a LStack, aligned for anything pushed
+ */
+typedef union LStackSlot {
+    void *ptr;
+    long num;
+} LStackSlot;
+
+/**
+ * @brief  A chunk of a LStack
+ * @note   Chunks never move, so what's pushed stays valid while calls nested
+ *         in it push more
+ */
+typedef struct LStackChunk {
+    struct LStackChunk *prev;
+    struct LStackChunk *next;
+    size_t cap;
+    size_t len;
+    LStackSlot slots[];
+} LStackChunk;
+
+/**
+ * @brief  Bump allocated region of the calls being evaluated
+ * @note   Holds the arguments of calls, contiguous and passed to builtins as
+ *         an (argc, argv) view (@see LBuiltinV), and the frames lambdas bind
+ *         their formals in (@see lenv_frame). Every green thread has its
+ *         own, as a task may park in the middle of a call
+ */
+typedef struct LStack {
+    /* Chunk pushed to, with at most one spare chunk after it */
+    LStackChunk *top;
+    /* Calls of functions borrowed from the global environment under way */
+    int borrows;
+    /* Functions rebound while borrowed, freed once no call is under way */
+    LWork retired;
+} LStack;
+
+/**
+ * @brief  Initialize an empty LStack, which allocates nothing until used
+ * @param  *lstack: The LStack to be initialized
+ * @retval None
+ */
+void lstack_init(LStack *lstack);
+
+/**
+ * @brief  Free the chunks of an empty LStack
+ * @param  *lstack: A LStack
+ * @retval None
+ */
+void lstack_free(LStack *lstack);
+
+/**
+ * @brief  Reserve contiguous bytes on top of a LStack
+ * @param  *lstack: A LStack
+ * @param  size: Number of bytes, greater than 0
+ * @retval The bytes, uninitialized and aligned as a LStackSlot
+ */
+void *lstack_push(LStack *lstack, size_t size);
+
+/**
+ * @brief  Release the bytes last reserved by lstack_push
+ * @note   Whatever they hold is left alone
+ * @param  *lstack: A LStack
+ * @param  size: Number of bytes, as passed to lstack_push
+ * @retval None
+ */
+void lstack_pop(LStack *lstack, size_t size);
+
+/**
+ * @brief  Get the LStack of the caller
+ * @retval The LStack of the running task, or the one of the main program
+ */
+LStack *lstack_self(void);
+
+#endif /* lstack.h */
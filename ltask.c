@@ -0,0 +1,462 @@
+#define _DEFAULT_SOURCE
+
+#include "ltask.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+struct LTask {
+    int refs;
+    /* Set (with `lock` held) once `result` is, may be read without it */
+    int done;
+    /* The main thread is blocked until this task is done */
+    int blocked;
+    pthread_mutex_t lock;
+
+    /* What's left to run, freed once it ran */
+    LVal *lthunk;
+    LEnv *lenv;
+    LVal *result;
+
+    /* Tasks parked until this one is done, linked through their `next` */
+    LTask *waiters;
+    LTask *next;
+
+    /* Green thread, NULL `stack` until it first runs */
+    ucontext_t ctx;
+    void *stack;
+    /* Arguments of the calls the task is evaluating (@see lstack.h) */
+    LStack lstack;
+};
+
+/**
+ * @brief  An OS thread running tasks, along with its queue of tasks
+ * @note   The owner pushes and pops the newest tasks, so a task which spawns
+ *         subtasks goes on depth first, other threads steal the oldest ones
+ */
+typedef struct LWorker {
+    int id;
+    pthread_t thread;
+
+    /* Ring of queued tasks, `head` and `tail` only grow and wrap by `cap` */
+    pthread_mutex_t lock;
+    LTask **items;
+    size_t head;
+    size_t tail;
+    size_t cap;
+
+    /* Task running on this OS thread, NULL in its scheduler loop */
+    LTask *task;
+    /* Context of the scheduler loop, running tasks switch back to it */
+    ucontext_t sched;
+    /* Lock of the LTask a task parked on, released by the scheduler once the
+     * task switched away, so no OS thread resumes it before that */
+    pthread_mutex_t *unlock;
+
+    /* Stacks of finished tasks */
+    void *stacks[LTASK_STACK_CACHE];
+    int stack_count;
+
+    /* State of the xorshift picking whom to steal from */
+    unsigned seed;
+} LWorker;
+
+int ltask_threads = 0;
+
+// Worker 0 is the main thread, which runs tasks only while it waits for them
+static LWorker ltask_workers[LTASK_MAX_THREADS];
+static int ltask_count = 0;
+static pthread_key_t ltask_key;
+
+// Idle OS threads sleep on `ltask_wake`, woken when tasks are queued or the
+// task the main thread waits for is done
+static pthread_mutex_t ltask_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ltask_wake = PTHREAD_COND_INITIALIZER;
+static int ltask_sleepers = 0;
+static int ltask_stop = 0;
+
+// Tasks queued in any LWorker, and spawned but not done
+static long ltask_queued = 0;
+static long ltask_pending = 0;
+
+static LWorker *ltask_self(void) {
+    return ltask_count ? pthread_getspecific(ltask_key) : NULL;
+}
+
+static void *ltask_stack(LWorker *lworker) {
+    if (lworker->stack_count) {
+        return lworker->stacks[--lworker->stack_count];
+    }
+
+    void *stack = mmap(NULL, LTASK_STACK, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                       -1, 0);
+    if (stack == MAP_FAILED) {
+        perror("spawn");
+        abort();
+    }
+    // The lowest page guards against overflowing the stack
+    mprotect(stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+    return stack;
+}
+
+static void ltask_stack_free(LWorker *lworker, void *stack) {
+    if (lworker->stack_count < LTASK_STACK_CACHE) {
+        lworker->stacks[lworker->stack_count++] = stack;
+    } else {
+        munmap(stack, LTASK_STACK);
+    }
+}
+
+static void ltask_push(LWorker *lworker, LTask *ltask) {
+    pthread_mutex_lock(&lworker->lock);
+    size_t count = lworker->tail - lworker->head;
+    if (count == lworker->cap) {
+        size_t cap = lworker->cap ? lworker->cap * 2 : 64;
+        LTask **items = malloc(sizeof(LTask *) * cap);
+        for (size_t i = 0; i < count; i++) {
+            items[i] = lworker->items[(lworker->head + i) % lworker->cap];
+        }
+        free(lworker->items);
+        lworker->items = items;
+        lworker->head = 0;
+        lworker->tail = count;
+        lworker->cap = cap;
+    }
+    lworker->items[lworker->tail++ % lworker->cap] = ltask;
+    pthread_mutex_unlock(&lworker->lock);
+
+    // Sleepers count themselves before checking for tasks, so either they see
+    // this task or it sees them
+    __atomic_add_fetch(&ltask_queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ltask_sleepers, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&ltask_lock);
+        pthread_cond_signal(&ltask_wake);
+        pthread_mutex_unlock(&ltask_lock);
+    }
+}
+
+// Take the newest task of the caller's own queue, or the oldest of another's
+static LTask *ltask_take(LWorker *lworker, int newest) {
+    LTask *ltask = NULL;
+    pthread_mutex_lock(&lworker->lock);
+    if (lworker->tail != lworker->head) {
+        ltask = newest ? lworker->items[--lworker->tail % lworker->cap]
+                       : lworker->items[lworker->head++ % lworker->cap];
+    }
+    pthread_mutex_unlock(&lworker->lock);
+
+    if (ltask) {
+        __atomic_sub_fetch(&ltask_queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return ltask;
+}
+
+static LTask *ltask_find(LWorker *lworker) {
+    LTask *ltask = ltask_take(lworker, 1);
+    if (ltask || !__atomic_load_n(&ltask_queued, __ATOMIC_SEQ_CST)) {
+        return ltask;
+    }
+
+    lworker->seed ^= lworker->seed << 13;
+    lworker->seed ^= lworker->seed >> 17;
+    lworker->seed ^= lworker->seed << 5;
+    int start = (int)(lworker->seed % (unsigned)ltask_count);
+    for (int i = 0; i < ltask_count && !ltask; i++) {
+        int victim = (start + i) % ltask_count;
+        if (victim != lworker->id) {
+            ltask = ltask_take(&ltask_workers[victim], 0);
+        }
+    }
+    return ltask;
+}
+
+// Entry of every green thread, never returns but switches to the scheduler
+static void ltask_entry(void) {
+    LTask *ltask = ltask_self()->task;
+
+    LVal *result;
+    if (ltask->lthunk->type == LVAL_FUN) {
+        result = lval_apply(ltask->lenv, ltask->lthunk, lval_wrap_sexpr());
+        lval_del(ltask->lthunk);
+    } else {
+        ltask->lthunk->type = LVAL_SEXPR;
+        result = lval_eval(ltask->lenv, ltask->lthunk);
+    }
+    ltask->lthunk = NULL;
+    lenv_del(ltask->lenv);
+    ltask->lenv = NULL;
+    lstack_free(&ltask->lstack);
+
+    pthread_mutex_lock(&ltask->lock);
+    ltask->result = result;
+    __atomic_store_n(&ltask->done, 1, __ATOMIC_RELEASE);
+    LTask *waiters = ltask->waiters;
+    ltask->waiters = NULL;
+    int blocked = ltask->blocked;
+    pthread_mutex_unlock(&ltask->lock);
+
+    // Awaiting tasks may have parked on another OS thread than this one
+    LWorker *lworker = ltask_self();
+    while (waiters) {
+        LTask *next = waiters->next;
+        ltask_push(lworker, waiters);
+        waiters = next;
+    }
+
+    if (__atomic_sub_fetch(&ltask_pending, 1, __ATOMIC_SEQ_CST) == 0 ||
+        blocked) {
+        pthread_mutex_lock(&ltask_lock);
+        pthread_cond_broadcast(&ltask_wake);
+        pthread_mutex_unlock(&ltask_lock);
+    }
+
+    setcontext(&lworker->sched);
+}
+
+static void ltask_run(LWorker *lworker, LTask *ltask) {
+    if (!ltask->stack) {
+        ltask->stack = ltask_stack(lworker);
+        getcontext(&ltask->ctx);
+        ltask->ctx.uc_stack.ss_sp = ltask->stack;
+        ltask->ctx.uc_stack.ss_size = LTASK_STACK;
+        ltask->ctx.uc_link = NULL;
+        makecontext(&ltask->ctx, ltask_entry, 0);
+    }
+
+    lworker->task = ltask;
+    swapcontext(&lworker->sched, &ltask->ctx);
+    lworker->task = NULL;
+
+    // Parked, whoever finishes the awaited task queues it again
+    if (lworker->unlock) {
+        pthread_mutex_unlock(lworker->unlock);
+        lworker->unlock = NULL;
+        return;
+    }
+
+    ltask_stack_free(lworker, ltask->stack);
+    ltask->stack = NULL;
+    ltask_del(ltask);
+}
+
+// Whether the main thread may stop running tasks, `until` is NULL to wait
+// for all of them
+static int ltask_finished(LTask *until) {
+    if (until) {
+        return __atomic_load_n(&until->done, __ATOMIC_ACQUIRE);
+    }
+    return __atomic_load_n(&ltask_pending, __ATOMIC_SEQ_CST) == 0;
+}
+
+// Block until there are tasks to steal, the pool stops or `until` finished
+static void ltask_sleep(LTask *until, int main) {
+    pthread_mutex_lock(&ltask_lock);
+    __atomic_add_fetch(&ltask_sleepers, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&ltask_queued, __ATOMIC_SEQ_CST) && !ltask_stop &&
+           !(main && ltask_finished(until))) {
+        pthread_cond_wait(&ltask_wake, &ltask_lock);
+    }
+    __atomic_sub_fetch(&ltask_sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ltask_lock);
+}
+
+static void ltask_help(LTask *until) {
+    LWorker *lworker = &ltask_workers[0];
+    while (!ltask_finished(until)) {
+        LTask *ltask = ltask_find(lworker);
+        if (ltask) {
+            ltask_run(lworker, ltask);
+        } else {
+            ltask_sleep(until, 1);
+        }
+    }
+}
+
+static void *ltask_main(void *arg) {
+    LWorker *lworker = arg;
+    pthread_setspecific(ltask_key, lworker);
+
+    while (1) {
+        LTask *ltask = ltask_find(lworker);
+        if (ltask) {
+            ltask_run(lworker, ltask);
+            continue;
+        }
+
+        ltask_sleep(NULL, 0);
+        pthread_mutex_lock(&ltask_lock);
+        int stop = ltask_stop;
+        pthread_mutex_unlock(&ltask_lock);
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+static void ltask_start(void) {
+    int count = ltask_threads;
+    if (count <= 0) {
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > LTASK_MAX_THREADS) {
+        count = LTASK_MAX_THREADS;
+    }
+
+    pthread_key_create(&ltask_key, NULL);
+    for (int i = 0; i < count; i++) {
+        LWorker *lworker = &ltask_workers[i];
+        memset(lworker, 0, sizeof(LWorker));
+        lworker->id = i;
+        pthread_mutex_init(&lworker->lock, NULL);
+        lworker->seed = (unsigned)i * 2654435761u + 1;
+    }
+    pthread_setspecific(ltask_key, &ltask_workers[0]);
+    ltask_count = count;
+
+    for (int i = 1; i < count; i++) {
+        pthread_create(&ltask_workers[i].thread, NULL, ltask_main,
+                       &ltask_workers[i]);
+    }
+}
+
+// Private LEnv of a task, the local bindings visible from `lenv` over the
+// global LEnv. Inner bindings shadow outer ones, so those are copied first
+static LEnv *ltask_env(LEnv *lenv) {
+    LEnv *lprivate = lenv_new();
+    while (lenv->parent) {
+        for (int i = 0; i < lenv->child_count; i++) {
+            int bound = 0;
+            for (int j = 0; j < lprivate->child_count && !bound; j++) {
+                bound = strcmp(lprivate->syms[j], lenv->syms[i]) == 0;
+            }
+            if (!bound) {
+                LVal *lsym =
+                    lval_wrap_symn(lenv->syms[i], strlen(lenv->syms[i]));
+                lenv_put(lprivate, lsym, lenv->lvals[i]);
+                lval_del(lsym);
+            }
+        }
+        lenv = lenv->parent;
+    }
+    lprivate->parent = lenv;
+    return lprivate;
+}
+
+LTask *ltask_spawn(LEnv *lenv, LVal *lthunk) {
+    if (!ltask_count) {
+        ltask_start();
+    }
+
+    LTask *ltask = malloc(sizeof(LTask));
+    // One reference for the caller, one for the pool until the task ran
+    ltask->refs = 2;
+    ltask->done = 0;
+    ltask->blocked = 0;
+    pthread_mutex_init(&ltask->lock, NULL);
+    ltask->lthunk = lthunk;
+    ltask->lenv = ltask_env(lenv);
+    ltask->result = NULL;
+    ltask->waiters = NULL;
+    ltask->next = NULL;
+    ltask->stack = NULL;
+    lstack_init(&ltask->lstack);
+
+    __atomic_add_fetch(&ltask_pending, 1, __ATOMIC_SEQ_CST);
+    ltask_push(ltask_self(), ltask);
+    return ltask;
+}
+
+LVal *ltask_await(LTask *ltask) {
+    if (!__atomic_load_n(&ltask->done, __ATOMIC_ACQUIRE)) {
+        LWorker *lworker = ltask_self();
+        LTask *lself = lworker->task;
+
+        pthread_mutex_lock(&ltask->lock);
+        if (ltask->done) {
+            pthread_mutex_unlock(&ltask->lock);
+        } else if (lself) {
+            // Park, the scheduler unlocks once this context is saved
+            lself->next = ltask->waiters;
+            ltask->waiters = lself;
+            lworker->unlock = &ltask->lock;
+            swapcontext(&lself->ctx, &lworker->sched);
+        } else {
+            ltask->blocked = 1;
+            pthread_mutex_unlock(&ltask->lock);
+            ltask_help(ltask);
+        }
+    }
+    return lval_copy(ltask->result);
+}
+
+LTask *ltask_ref(LTask *ltask) {
+    __atomic_add_fetch(&ltask->refs, 1, __ATOMIC_ACQ_REL);
+    return ltask;
+}
+
+void ltask_del(LTask *ltask) {
+    if (__atomic_sub_fetch(&ltask->refs, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+    if (ltask->result) {
+        lval_del(ltask->result);
+    }
+    pthread_mutex_destroy(&ltask->lock);
+    free(ltask);
+}
+
+int ltask_busy(void) {
+    return __atomic_load_n(&ltask_pending, __ATOMIC_SEQ_CST) > 0;
+}
+
+int ltask_inside(void) {
+    LWorker *lworker = ltask_self();
+    return lworker && lworker->task;
+}
+
+LStack *ltask_lstack(void) {
+    LWorker *lworker = ltask_self();
+    return lworker && lworker->task ? &lworker->task->lstack : NULL;
+}
+
+void ltask_quiesce(void) {
+    if (ltask_count && !ltask_inside()) {
+        ltask_help(NULL);
+    }
+}
+
+void ltask_shutdown(void) {
+    if (!ltask_count) {
+        return;
+    }
+    ltask_quiesce();
+
+    pthread_mutex_lock(&ltask_lock);
+    ltask_stop = 1;
+    pthread_cond_broadcast(&ltask_wake);
+    pthread_mutex_unlock(&ltask_lock);
+
+    for (int i = 0; i < ltask_count; i++) {
+        LWorker *lworker = &ltask_workers[i];
+        if (i > 0) {
+            pthread_join(lworker->thread, NULL);
+        }
+        while (lworker->stack_count) {
+            munmap(lworker->stacks[--lworker->stack_count], LTASK_STACK);
+        }
+        free(lworker->items);
+        pthread_mutex_destroy(&lworker->lock);
+    }
+
+    pthread_key_delete(ltask_key);
+    ltask_count = 0;
+    ltask_stop = 0;
+}
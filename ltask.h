@@ -0,0 +1,98 @@
+#ifndef LTASK_H
+#define LTASK_H
+
+#include "lstack.h"
+#include "lval.h"
+
+/* Stack of a green thread, reserved up front and committed as it's touched */
+#define LTASK_STACK ((size_t)8 << 20)
+/* Most OS threads running tasks, including the main thread */
+#define LTASK_MAX_THREADS 64
+/* Stacks of finished tasks kept by each OS thread for the next tasks */
+#define LTASK_STACK_CACHE 4
+
+/**
+ * @brief  A task spawned by `spawn`, and the future of its result
+ * @note   Every task runs on its own green thread (a ucontext with its own
+ *         stack), so a task awaiting an unfinished task is parked and its OS
+ *         thread goes on with other tasks. Tasks are queued on the OS thread
+ *         which spawned (or woke) them and idle OS threads steal from the
+ *         others. Shared (and reference counted) by all copies of the future
+ *         and the pool until it ran. Private to ltask.c
+ */
+struct LTask;
+
+/* OS threads running tasks (including the main thread), 0 for one per online
+ * CPU. Set before the first task is spawned */
+extern int ltask_threads;
+
+/**
+ * @brief  Spawn a task, starting the pool of OS threads on first use
+ * @note   Tasks see the global LEnv read only and a private LEnv of their
+ *         own, which starts with a copy of the local bindings of `lenv`
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lthunk: A LVAL_QEXPR evaluated as a S-Expression, or a LVAL_FUN
+ *         called without arguments. Consumed
+ * @retval The LTask, with a reference owned by the caller
+ */
+LTask *ltask_spawn(LEnv *lenv, LVal *lthunk);
+
+/**
+ * @brief  Wait for the result of a task
+ * @note   Parks the calling task, or runs other tasks on the calling OS
+ *         thread until `ltask` is done
+ * @param  *ltask: A LTask
+ * @retval A copy of the result
+ */
+LVal *ltask_await(LTask *ltask);
+
+/**
+ * @brief  Add a reference to a LTask
+ * @param  *ltask: A LTask
+ * @retval `ltask`
+ */
+LTask *ltask_ref(LTask *ltask);
+
+/**
+ * @brief  Drop a reference to a LTask, freeing it (and its result) with the
+ *         last one
+ * @param  *ltask: A LTask
+ * @retval None
+ */
+void ltask_del(LTask *ltask);
+
+/**
+ * @brief  Check whether tasks are spawned but not done
+ * @note   While they are, the global LEnv is read only and lambdas are shared
+ *         between OS threads (@see ljit_call)
+ * @retval 1 if tasks are running, 0 otherwise
+ */
+int ltask_busy(void);
+
+/**
+ * @brief  Check whether the caller is a task, rather than the main program
+ * @retval 1 inside a task, 0 otherwise
+ */
+int ltask_inside(void);
+
+/**
+ * @brief  Get the LStack of the running task
+ * @note   Cheap while no task was ever spawned (@see lstack_self)
+ * @retval The LStack, or NULL outside of tasks
+ */
+LStack *ltask_lstack(void);
+
+/**
+ * @brief  Run tasks on the main thread until no task is left
+ * @note   Only called outside of tasks, eg: before binding a global
+ * @retval None
+ */
+void ltask_quiesce(void);
+
+/**
+ * @brief  Wait for all tasks and stop the pool of OS threads
+ * @retval None
+ */
+void ltask_shutdown(void);
+
+#endif /* ltask.h */
@@ -1,11 +1,21 @@
 #include "lval.h"
 #include <errno.h>
 #include <string.h>
+#include "jit.h"
+#include "lbig.h"
+#include "lbuf.h"
+#include "lbuiltin.h"
+#include "lbuiltins.h"
+#include "lfile.h"
+#include "lmap.h"
+#include "lperf.h"
+#include "lser.h"
+#include "lsort.h"
+#include "lstack.h"
+#include "ltask.h"
 #include "mpc.h"
 #include "parser.h"
 
-#define MAX_ERR 4096
-
 // TODO: Add shorter error descriptions
 // TODO: Prototype remaining builtins
 // TODO: Refactor some fields and variable names
@@ -13,37 +23,56 @@
 // TODO: Fix some descriptions of parameters in comments
 // TODO: Split source file to multiple modular files
 
-// Asserts condition `cond` is false, if not throws an error and deletes `lval`
-#define LASSERT(lval, cond, fmt, ...)                                 \
-    if (!(cond)) {                                                    \
-        lval_del(lval);                                               \
-        /* __VA_ARGS__ allows to variable number of arguments */      \
-        /* ## in front eats "," on expansion if __VA_ARGS is empty */ \
-        return lval_wrap_err(fmt, ##__VA_ARGS__);                     \
+// Asserts condition `cond` is true, if not deletes `lval` and returns `lerr`
+// `lerr` is evaluated before `lval` is deleted so it may refer to `lval`
+#define LASSERT(lval, cond, lerr)   \
+    if (!(cond)) {                  \
+        LVal *lassert_err = (lerr); \
+        lval_del(lval);             \
+        return lassert_err;         \
+    }
+
+// Same as LASSERT for a builtin taking a vector of arguments, deleting them
+#define LASSERT_ARGV(argc, argv, cond, lerr) \
+    if (!(cond)) {                           \
+        LVal *lassert_err = (lerr);          \
+        lval_del_argv(argc, argv);           \
+        return lassert_err;                  \
     }
 
 // Asserts if child of `lval` at given index has the same type as `expected` or
 // else, throw error
-#define LASSERT_CHILD_TYPE(lbuiltin, lval, index, expected)                \
-    LASSERT(lval, lval->children[index]->type == expected,                 \
-            "Function '%s' was passed incorrect type of argument for "     \
-            "argument: %i\n"                                               \
-            "Got '%s' expected '%s'",                                      \
-            lbuiltin, index, lval_print_type(lval->children[index]->type), \
-            lval_print_type(expected))
+#define LASSERT_CHILD_TYPE(lbuiltin, lval, index, expected) \
+    LASSERT(lval, lval->children[index]->type == expected,  \
+            lval_wrap_err(LERR_ARG_TYPE, lbuiltin, index,   \
+                          lval->children[index]->type, expected))
 
 // Asserts if correct number of arguments were passed, i.e by counting children
 #define LASSERT_CHILD_COUNT(lbuiltin, lval, count)                     \
     LASSERT(lval, lval->child_count == count,                          \
-            "Function '%s' was passed incorrect number of arguments\n" \
-            "Got %i, expected %i",                                     \
-            lbuiltin, lval->child_count, count)
+            lval_wrap_err(LERR_ARG_COUNT, lbuiltin, lval->child_count, \
+                          count, 0))
 
 // Asserts if function `lbuiltin` was passed with no arguments
-#define LASSERT_CHILD_NOT_EMPTY(lbuiltin, lval, index)                         \
-    LASSERT(lval, lval->children[index]->child_count != 0,                     \
-            "Functions '%s' was passed {} for argument at index %i", lbuiltin, \
-            index)
+#define LASSERT_CHILD_NOT_EMPTY(lbuiltin, lval, index)     \
+    LASSERT(lval, lval->children[index]->child_count != 0, \
+            lval_wrap_err(LERR_ARG_EMPTY, lbuiltin, index, 0, 0))
+
+// Asserts if child of `lval` at given index can be used as a key of a LMap
+#define LASSERT_CHILD_KEY(lbuiltin, lval, index)         \
+    LASSERT(lval, lmap_is_key(lval->children[index]),    \
+            lval_wrap_err(LERR_BAD_KEY, lbuiltin, index, \
+                          lval->children[index]->type, 0))
+
+// Asserts if the transient at given index of `lval` was frozen
+#define LASSERT_CHILD_THAWED(lbuiltin, lval, index)           \
+    LASSERT(lval, !lval->children[index]->ltransient->frozen, \
+            lval_wrap_err(LERR_THAWED, lbuiltin, 0, 0, 0))
+
+// Asserts if `num` indexes one of `count` elements, for `lval`
+#define LASSERT_INDEX(lbuiltin, lval, num, count) \
+    LASSERT(lval, (num) >= 0 && (num) < (count),  \
+            lval_wrap_err(LERR_BAD_INDEX, lbuiltin, num, count, 0))
 
 ///////////////////////////////////////////////////////////////////////////////
 /* Function Declarations */
@@ -66,13 +95,32 @@ LVal *lval_wrap_long(long val);
 LVal *lval_wrap_sym(char *sym);
 
 /**
- * @brief  Wrap error with variable arguments to LVal
- * @note Copies a maximum of MAX_ERR bytes including null,
- *       may lead to truncated error string
- * @param *fmt: Format of the given variable argument error string
+ * @brief  Wrap `len` bytes as a LVal symbol
+ * @param  *sym: The bytes, need not be null terminated
+ * @param  len: Number of bytes
+ * @retval A LVal of type LVAL_SYM
+ */
+LVal *lval_wrap_symn(const char *sym, size_t len);
+
+/**
+ * @brief  Wrap an error code and its arguments as a LVal
+ * @note   Nothing is formatted here, the message is only built when the
+ *         error is printed (@see lval_print_err)
+ * @param  errcode: One of LERR_*
+ * @param  *errfn: Name of the function raising the error, must be static
+ * @param  arg0, arg1, arg2: Arguments of the error, depending on `errcode`
+ * @retval A LVal of type LVAL_ERR
+ */
+LVal *lval_wrap_err(int errcode, const char *errfn, long arg0, long arg1,
+                    long arg2);
+
+/**
+ * @brief  Wrap an error carrying a string (eg: a symbol or a message)
+ * @param  errcode: One of LERR_*
+ * @param  *str: The string which is copied into the error
  * @retval A LVal of type LVAL_ERR
  */
-LVal *lval_wrap_err(char *fmt, ...);
+LVal *lval_wrap_err_str(int errcode, const char *str);
 
 /**
  * @brief  Wrap S/Q-Expressions
@@ -93,6 +141,25 @@ LVal *lval_wrap_qexpr(void);
  * @retval A LVal with type LVAL_FUN
  */
 LVal *lval_wrap_lbuiltin(LBuiltin lbuiltin);
+
+/**
+ * @brief  Wrap a builtin taking a vector of arguments as an LVal
+ * @note   `lbuiltin` is the same builtin taking a S-Expression, which
+ *         builtins calling functions (eg: `map`) and constant folding use
+ * @param  lbuiltin: A LBuiltin, usually calling `lbuiltinv` (@see
+ *         lbuiltinv_call)
+ * @param  lbuiltinv: A LBuiltinV
+ * @retval A LVal with type LVAL_FUN
+ */
+LVal *lval_wrap_lbuiltinv(LBuiltin lbuiltin, LBuiltinV lbuiltinv);
+
+/**
+ * @brief  Wrap a vector of arguments as a S-Expression
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments, moved into the S-Expression
+ * @retval A LVal with type LVAL_SEXPR
+ */
+LVal *lval_wrap_argv(int argc, LVal **argv);
 /* LVal methods for modification and evaluation */
 
 /**
@@ -111,6 +178,58 @@ LVal *lval_wrap_lambda(LVal *lformals, LVal *lbody);
  */
 LVal *lval_wrap_str(char *str);
 
+/**
+ * @brief  Wrap a LMap as a LVal
+ * @param  *lmap: The LMap, whose reference is handed over
+ * @retval A LVal of type LVAL_MAP
+ */
+LVal *lval_wrap_map(LMap *lmap);
+
+/**
+ * @brief  Make room for a symbol or string of `len` bytes in a LVal
+ * @note   Short ones go inline, longer ones in a new LStrBuf. Sets `len`,
+ *         the caller fills in the bytes and the null terminator
+ * @param  *lval: A LVal of type LVAL_SYM or LVAL_STR
+ * @param  len: Number of bytes, excluding the null terminator
+ * @retval Pointer to the storage, to be assigned to `sym` or `str`
+ */
+char *lval_alloc_chars(LVal *lval, size_t len);
+
+/**
+ * @brief  Give `copy` the symbol or string `src` of `lval`
+ * @note   Inline bytes are copied, a LStrBuf is shared
+ * @param  *copy: The LVal being copied into
+ * @param  *lval: The LVal being copied
+ * @param  *src: `sym` or `str` of `lval`
+ * @retval Pointer to be assigned to `sym` or `str` of `copy`
+ */
+char *lval_copy_chars(LVal *copy, LVal *lval, const char *src);
+
+// Release a LStrBuf (if any), freeing it with its last reference
+void lstrbuf_del(LStrBuf *lstrbuf);
+
+/**
+ * @brief  Copy a string view out of its mapping, so it is null terminated
+ * @note   Needed before `str` is passed on as a C string (eg: a path)
+ * @param  *lstr: A LVal of type LVAL_STR, a view or not
+ * @retval None
+ */
+void lval_str_terminate(LVal *lstr);
+
+/* Work stacks of traversals */
+
+// Initialize an empty LWork
+void lwork_init(LWork *work);
+
+// Push an item, growing the LWork as needed
+void lwork_push(LWork *work, void *item);
+
+// Pop the item pushed last, the LWork must not be empty
+void *lwork_pop(LWork *work);
+
+// Release heap memory of a LWork, which is empty afterwards
+void lwork_free(LWork *work);
+
 /* Functions to operate on LVal */
 
 /**
@@ -120,6 +239,48 @@ LVal *lval_wrap_str(char *str);
  */
 void lval_del(LVal *lval);
 
+/**
+ * @brief  Queue a LVal to be deleted later by lval_reclaim
+ * @note   For large trees whose lval_del would stall the caller, eg: the
+ *         previous result of a REPL line
+ * @param  *lval: The LVal which need to be freed along with its contents
+ * @retval None
+ */
+void lval_del_deferred(LVal *lval);
+
+/**
+ * @brief  Free LVal's queued by lval_del_deferred
+ * @param  budget: Most LVal's freed by this call, 0 to free all of them
+ * @retval 1 if LVal's are left to be freed, 0 otherwise
+ */
+int lval_reclaim(size_t budget);
+
+/**
+ * @brief  Free a single LVal, leaving the LVal's it holds for later
+ * @param  *lval: The LVal to be freed
+ * @param  *work: Where LVal's held by `lval` are pushed to be freed
+ * @retval None
+ */
+void lval_del_node(LVal *lval, LWork *work);
+
+/**
+ * @brief  Copy a single LVal, leaving the LVal's it holds for later
+ * @param  *lval: The LVal to be copied
+ * @param  *work: Where pairs of a LVal held by `lval` and the slot its copy
+ *                goes in are pushed
+ * @retval The copy
+ */
+LVal *lval_copy_node(LVal *lval, LWork *work);
+
+/**
+ * @brief  Compare two LVal's, leaving the LVal's they hold for later
+ * @param  *first: The first LVal
+ * @param  *second: The second LVal
+ * @param  *work: Where pairs of LVal's which have to be equal are pushed
+ * @retval 0 if they differ, 1 if they are equal as far as compared
+ */
+int lval_eq_node(LVal *first, LVal *second, LWork *work);
+
 /**
  * @brief  Add a LVal to another LVal
  * @param  *parent: The parent LVal, the child is added to this LVal
@@ -152,6 +313,14 @@ LVal *lval_pop(LVal *lval, int index);
  */
 LVal *lval_take(LVal *lval, int index);
 
+/**
+ * @brief  Delete a vector of arguments, but not the vector itself
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments
+ * @retval None
+ */
+void lval_del_argv(int argc, LVal **argv);
+
 /**
  * @brief  Call a function `lfun` with `largs` as arguments
  * @note   TODO: Expand on inner-workings
@@ -163,6 +332,62 @@ LVal *lval_take(LVal *lval, int index);
  */
 LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs);
 
+/**
+ * @brief  Call a function with a vector of arguments, as lval_call would
+ * @note   Builtins with a LBuiltinV and complete calls of lambdas take the
+ *         arguments from the vector, other calls wrap them in a S-Expression
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A LVal of type LVAL_FUN, arguments are bound into it
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments, consumed but not the vector itself
+ * @retval Result of the call
+ */
+LVal *lval_call_argv(LEnv *lenv, LVal *lfun, int argc, LVal **argv);
+
+/**
+ * @brief  Evaluate the body of a lambda in a frame on the LStack
+ * @note   For complete calls of lambdas without bound formals, the frame is
+ *         released as a whole once the body is evaluated (@see lenv_frame)
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A lambda, not consumed
+ * @param  argc: Number of arguments, one per formal and greater than 0
+ * @param  **argv: The arguments, consumed but not the vector itself
+ * @retval Result of the call
+ */
+LVal *lval_call_frame(LEnv *lenv, LVal *lfun, int argc, LVal **argv);
+
+/**
+ * @brief  Call a LBuiltinV with the children of a S-Expression
+ * @note   Converts a LBuiltinV to a LBuiltin
+ * @param  *lenv: The LEnv of the caller
+ * @param  lbuiltinv: A LBuiltinV
+ * @param  *largs: A LVAL_SEXPR of arguments, consumed
+ * @retval Result of the call
+ */
+LVal *lbuiltinv_call(LEnv *lenv, LBuiltinV lbuiltinv, LVal *largs);
+
+/**
+ * @brief  Call a copy of a function, leaving the function itself untouched
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A LVal of type LVAL_FUN, not consumed
+ * @param  *largs: A LVAL_SEXPR of arguments, consumed
+ * @retval Result of the call
+ */
+LVal *lval_apply(LEnv *lenv, LVal *lfun, LVal *largs);
+
+/**
+ * @brief  Call a function with a vector of arguments, as lval_apply would
+ * @note   Calls of LBuiltinVs and complete calls of lambdas take the
+ *         arguments from the vector, so a caller reusing one vector (eg:
+ *         `map`) allocates no argument list per call
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A LVal of type LVAL_FUN, not consumed
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments, consumed but not the vector itself
+ * @retval Result of the call
+ */
+LVal *lval_apply_argv(LEnv *lenv, LVal *lfun, int argc, LVal **argv);
+
 /**
  * @brief  Compare two LVal's
  * @param  *first: The first LVal
@@ -182,12 +407,228 @@ LVal *lval_eval(LEnv *lenv, LVal *lval);
 
 /**
  * @brief  Evaluate a S-Expression
+ * @note   Children are evaluated onto the LStack (@see lstack.h) and the
+ *         function is called with them in place
  * @param  *lenv: A LEnv which contains symbol list
  * @param  *lval: A LVal of type LVAL_SEXPR
  * @retval Result wrapped as a LVal
  */
 LVal *lval_eval_sexpr(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  Call the first of evaluated children of a S-Expression
+ * @param  *lenv: The LEnv the function is called in
+ * @param  *lstack: The LStack `slots` were pushed on
+ * @param  count: Number of children, greater than 0
+ * @param  **slots: The evaluated children, consumed and popped off `lstack`
+ * @param  borrowed: 1 if the first child is borrowed (@see lval_eval_head),
+ *         which is then neither consumed nor modified, else 0
+ * @retval Result of the call, the error of a child or the only child
+ */
+LVal *lval_eval_slots(LEnv *lenv, LStack *lstack, int count, LVal **slots,
+                      int borrowed);
+
+/**
+ * @brief  Check if the head of a call can be borrowed by lval_eval_head
+ * @param  *lhead: First child of a S-Expression
+ * @retval 1 if a symbol, else 0
+ */
+int lval_is_head(LVal *lhead);
+
+/**
+ * @brief  Evaluate the symbol at the head of a call into its slot
+ * @note   A function bound in the global environment, or a builtin, is
+ *         borrowed rather than copied, as calling it doesn't modify it
+ * @param  *lenv: LEnv from which the symbol must be fetched
+ * @param  *lhead: A symbol, left untouched
+ * @param  **slot: Set to the value of the symbol
+ * @retval 1 if the value is borrowed, else 0
+ */
+int lval_eval_head(LEnv *lenv, LVal *lhead, LVal **slot);
+
+/**
+ * @brief  Evaluate an LVal, leaving it untouched
+ * @note   Only what is evaluated is copied (eg: literals, a sub-expression
+ *         isn't), so a form evaluated over and over (eg: body of a loop)
+ *         isn't copied whole each time and keeps the inline caches of its
+ *         symbols
+ * @param  *lenv: LEnv from which the symbols must be fetched
+ * @param  *lval: A LVal of any type, not modified
+ * @retval Same as lval_eval on a copy of `lval`
+ */
+LVal *lval_eval_borrowed(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Evaluate the children of an expression as a S-Expression, leaving
+ *         them untouched
+ * @note   Bodies of lambdas are evaluated this way, with neither the body nor
+ *         the lambda copied for a call
+ * @param  *lenv: LEnv from which the symbols must be fetched
+ * @param  *lbody: A LVal of type LVAL_SEXPR or LVAL_QEXPR, not modified
+ * @retval Same as lval_eval on a copy of `lbody` of type LVAL_SEXPR
+ */
+LVal *lval_eval_body(LEnv *lenv, LVal *lbody);
+
+/* Constant folding */
+
+/**
+ * @brief  Fold calls of pure builtins on literals into constants
+ * @note   Folded constants are flagged LFLAG_FOLDED and evaluate their source
+ *         expression instead, once a folded builtin is shadowed
+ * @param  *lval: The expression to fold, consumed
+ * @param  *lformals: Formals of the enclosing lambda, may be NULL
+ * @param  *changed: Set to 1 if anything was folded
+ * @retval The folded expression
+ */
+LVal *lval_fold(LVal *lval, LVal *lformals, int *changed);
+
+/**
+ * @brief  Fold a Q-Expression which is evaluated as a S-Expression
+ * @note   eg: Body of a lambda or branches of if
+ * @param  *lbody: A LVal of type LVAL_QEXPR, not modified
+ * @param  *lformals: Formals of the enclosing lambda, may be NULL
+ * @retval A folded copy of lbody or NULL if there was nothing to fold
+ */
+LVal *lval_fold_body(LVal *lbody, LVal *lformals);
+
+/**
+ * @brief  Evaluate a folded constant
+ * @param  *lenv: LEnv in which the source is evaluated if needed
+ * @param  *lval: A LVal flagged LFLAG_FOLDED
+ * @retval The constant, or evaluation of its source if it is no longer valid
+ */
+LVal *lval_eval_folded(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Create the shared source of a folded constant
+ * @param  *src: The expression which was folded, consumed
+ * @retval A LFold with a single reference
+ */
+LFold *lfold_new(LVal *src);
+
+/**
+ * @brief  Drop a reference to a LFold, deleting its source with the last one
+ * @param  *lfold: A LFold
+ * @retval None
+ */
+void lfold_del(LFold *lfold);
+
+/* Lazy sequences */
+
+/**
+ * @brief  Wrap a LSeq as a LVal
+ * @param  *lseq: The LSeq, whose reference is handed over
+ * @retval A LVal of type LVAL_SEQ
+ */
+LVal *lval_wrap_seq(LSeq *lseq);
+
+/**
+ * @brief  Wrap a LTask as the future of its result
+ * @param  *ltask: The LTask, whose reference is handed over
+ * @retval A LVal of type LVAL_FUTURE
+ */
+LVal *lval_wrap_future(LTask *ltask);
+
+/**
+ * @brief  Create a LSeq
+ * @param  kind: One of LSEQ_*
+ * @retval A LSeq with a single reference and all fields set to 0/NULL
+ */
+LSeq *lseq_new(int kind);
+
+/**
+ * @brief  Drop a reference to a LSeq, deleting its contents with the last one
+ * @param  *lseq: A LSeq
+ * @retval None
+ */
+void lseq_del(LSeq *lseq);
+
+/**
+ * @brief  Get a LSeq which can be advanced in place of `lseq`
+ * @param  *lseq: A LSeq whose reference is handed over
+ * @retval `lseq` itself or a clone of it, with a single reference
+ */
+LSeq *lseq_own(LSeq *lseq);
+
+/**
+ * @brief  Compute the current element of a LSeq, if not done already
+ * @note   Calls `fn` of LSEQ_ITERATE/LSEQ_GEN. As this only memoizes, the
+ *         sequence need not be owned
+ * @param  *lenv: The LEnv in which `fn` is called
+ * @param  *lseq: A LSeq
+ * @retval NULL, or the error raised by `fn`
+ */
+LVal *lseq_force(LEnv *lenv, LSeq *lseq);
+
+/**
+ * @brief  Check whether a forced LSeq has no more elements
+ * @param  *lseq: A LSeq on which lseq_force succeeded
+ * @retval 1 if empty, 0 otherwise
+ */
+int lseq_empty(LSeq *lseq);
+
+/**
+ * @brief  Take the current element of an owned LSeq and advance it
+ * @param  *lenv: The LEnv in which `fn` is called
+ * @param  *lseq: A LSeq with a single reference
+ * @retval The element, NULL if there is none, or the error raised by `fn`
+ */
+LVal *lseq_next(LEnv *lenv, LSeq *lseq);
+
+/**
+ * @brief  Skip elements of an owned LSeq
+ * @note   O(1) for LSEQ_RANGE/LSEQ_REPEAT
+ * @param  *lenv: The LEnv in which `fn` is called
+ * @param  *lseq: A LSeq with a single reference
+ * @param  count: Number of elements to skip
+ * @retval NULL, or the error raised by `fn`
+ */
+LVal *lseq_drop(LEnv *lenv, LSeq *lseq, long count);
+
+/**
+ * @brief  Take the first element of a lazy sequence
+ * @param  *lenv: The LEnv in which elements are computed
+ * @param  *lseq: A LVal of type LVAL_SEQ, advanced past the element
+ * @param  *lbuiltin: Name of the builtin taking the element, for errors
+ * @retval The element, or an error if there is none or computing it failed
+ */
+LVal *lval_seq_next(LEnv *lenv, LVal *lseq, char *lbuiltin);
+
+/* Transients */
+
+/**
+ * @brief  Wrap a LTransient as a LVal
+ * @param  *ltransient: The LTransient, whose reference is handed over
+ * @retval A LVal of type LVAL_TRANSIENT
+ */
+LVal *lval_wrap_transient(LTransient *ltransient);
+
+/**
+ * @brief  Create a LTransient holding the elements of a Q-Expression
+ * @note   O(1), the Q-Expression's array of children is taken over
+ * @param  *qexpr: A LVal of type LVAL_QEXPR, consumed
+ * @retval A LTransient with a single reference
+ */
+LTransient *ltransient_new(LVal *qexpr);
+
+/**
+ * @brief  Drop a reference to a LTransient, deleting its elements with the
+ *         last one
+ * @param  *ltransient: A LTransient
+ * @param  *work: Where the elements are pushed to be deleted
+ * @retval None
+ */
+void ltransient_del(LTransient *ltransient, LWork *work);
+
+/**
+ * @brief  Append an element to a LTransient
+ * @note   Amortized O(1), the elements grow geometrically
+ * @param  *ltransient: A LTransient which isn't frozen
+ * @param  *lval: The element, consumed
+ * @retval None
+ */
+void ltransient_push(LTransient *ltransient, LVal *lval);
+
 /* LEnv Functions */
 
 /**
@@ -213,6 +654,44 @@ void lenv_del(LEnv *lenv);
  */
 LVal *lenv_get(LEnv *hay, LVal *pin);
 
+/**
+ * @brief  Search for the LVal bound to a symbol, like lenv_get
+ * @param  *hay: LEnv to search the symbol in
+ * @param  *pin: The symbol(LVal) to be searched for
+ * @param  *local: Set to 1 if bound in a local environment, else 0
+ * @retval The LVal itself, owned by the LEnv or a builtin, else NULL
+ */
+LVal *lenv_find(LEnv *hay, LVal *pin, int *local);
+
+/**
+ * @brief  Get the value of a name bound in a LEnv itself, without copying it
+ * @note   Parents of `lenv` aren't looked into
+ * @param  *lenv: The LEnv
+ * @param  *sym: A null terminated name
+ * @retval The value, owned by `lenv`, or NULL if unbound
+ */
+LVal *lenv_get_local(LEnv *lenv, const char *sym);
+
+/**
+ * @brief  Get the value of a global name, without copying it
+ * @note   Names the global LEnv doesn't bind resolve to builtins
+ *         (@see builtins.def)
+ * @param  *root: The global LEnv
+ * @param  *sym: A null terminated name
+ * @retval The value, owned by `root` or static, or NULL if unbound
+ */
+LVal *lenv_get_global(LEnv *root, const char *sym);
+
+/**
+ * @brief  Get the index of a name bound in a LEnv itself
+ * @note   The index stays valid for the life of the LEnv, bindings are only
+ *         ever added or replaced
+ * @param  *lenv: The LEnv
+ * @param  *sym: A null terminated name
+ * @retval An index into `lvals` and `stamps`, or -1 if unbound
+ */
+int lenv_index(LEnv *lenv, const char *sym);
+
 /**
  * @brief  Put an LVal with symbol lsym inside a LEnv
  * @param  *lenv: A LEnv in which the LVal is to be added
@@ -229,6 +708,27 @@ void lenv_put(LEnv *lenv, LVal *lsym, LVal *lval);
  */
 LEnv *lenv_copy(LEnv *lenv);
 
+/**
+ * @brief  Push the frame of a call on a LStack, binding formals to arguments
+ * @note   The LEnv and its bindings are bump allocated in one go, arguments
+ *         are moved in and the names of formals borrowed. lenv_put still
+ *         works on the frame, it moves the bindings to the heap to grow
+ * @param  *lstack: The LStack of the caller
+ * @param  *lformals: Formals of the lambda, outliving the frame
+ * @param  argc: Number of formals and arguments, greater than 0
+ * @param  **argv: The arguments, consumed but not the vector itself
+ * @retval The frame, with no parent
+ */
+LEnv *lenv_frame(LStack *lstack, LVal *lformals, int argc, LVal **argv);
+
+/**
+ * @brief  Delete the bindings of a frame and pop it off its LStack
+ * @param  *lstack: The LStack the frame was pushed on
+ * @param  *lenv: The frame, the last thing pushed on `lstack`
+ * @retval None
+ */
+void lenv_frame_del(LStack *lstack, LEnv *lenv);
+
 /**
  * @brief  Put a symbol inside a global environment
  * @param  *lenv: Immediate LEnv environment
@@ -238,6 +738,27 @@ LEnv *lenv_copy(LEnv *lenv);
  */
 void lenv_put_global(LEnv *lenv, LVal *lsym, LVal *lval);
 
+/**
+ * @brief  Create an empty inline cache for a symbol
+ * @retval A LICache with a single reference which matches no LEnv
+ */
+LICache *licache_new(void);
+
+/**
+ * @brief  Drop a reference to a LICache, freeing it with the last one
+ * @param  *icache: A LICache, may be NULL
+ * @retval None
+ */
+void licache_del(LICache *icache);
+
+/**
+ * @brief  Check whether binding a symbol disables folded constants
+ * @param  *sym: The symbol being bound
+ * @param  *lval: The value it is bound to
+ * @retval 1 if `sym` is a folded builtin and `lval` is not that builtin
+ */
+int lenv_shadows(char *sym, LVal *lval);
+
 /* MPC AST handlers */
 
 /**
@@ -247,18 +768,29 @@ void lenv_put_global(LEnv *lenv, LVal *lsym, LVal *lval);
  */
 LVal *lval_read_ast(mpc_ast_t *node);
 
+/**
+ * @brief  Read a single ast node, leaving its children for later
+ * @param  *node: The ast node to be converted
+ * @param  *work: Where pairs of a child node and the LVal it's added to are
+ *                pushed
+ * @retval A LVal, an empty expression if the node has children
+ */
+LVal *lval_read_node(mpc_ast_t *node, LWork *work);
+
 /**
  * @brief  Handler for lval_wrap_long
- * @note   Converts string to long converts to LVal on success
+ * @note   Converts string to long converts to LVal on success, numbers
+ *         beyond a long are read as a LBig
  * @param  *node: ast node containing a long number as contents
- * @retval A LVal of type LVAL_NUM on success, LVAL_ERR otherwise
+ * @retval A LVal of type LVAL_NUM, or LVAL_BIG
  */
 LVal *lval_read_long(mpc_ast_t *node);
 
 /**
  * @brief  Handle unescaped wrapping of LVAL_STR
+ * @note   Unescapes within `node` in a single pass, so `\0` is kept
  * @param  *node: AST node having string as its contents
- * @retval A LVal of type
+ * @retval A LVal of type LVAL_STR
  */
 LVal *lval_read_str(mpc_ast_t *node);
 
@@ -279,27 +811,98 @@ void lval_println(LVal *lval);
  */
 void lval_print(LVal *lval);
 
+/**
+ * @brief  Print value of LVal into a LBuf
+ * @note   lval_print is a wrapper which flushes to stdout
+ * @param  *lbuf: The LBuf written to
+ * @param  *lval: An LVal
+ * @retval None
+ */
+void lval_print_lbuf(LBuf *lbuf, LVal *lval);
+
+/**
+ * @brief  Print a single LVal, leaving the LVal's it holds for later
+ * @param  *lbuf: The LBuf written to
+ * @param  *work: Where what's left to print is pushed (@see lval_print_later)
+ * @param  *lval: An LVal
+ * @retval None
+ */
+void lval_print_node(LBuf *lbuf, LWork *work, LVal *lval);
+
+/**
+ * @brief  Schedule a LVal or a text to be printed
+ * @note   Printed in the reverse order of scheduling
+ * @param  *work: The LWork of lval_print_lbuf
+ * @param  *lval: The LVal to be printed, or NULL to print `text`
+ * @param  *text: Text to be printed if `lval` is NULL, else NULL (or
+ *                lval_print_count to print the count of a repeated LVAL_SEQ)
+ * @retval None
+ */
+void lval_print_later(LWork *work, LVal *lval, const char *text);
+
 /**
  * @brief Print an S-Expression
  * @note lval_print handler for S-Expression
+ * @param  *lbuf: The LBuf written to
+ * @param  *work: Where the children are scheduled
  * @param  *lval: LVal with type LVAL_SEXPR
- * @param  open: Character to be inserted before S-Expression
- * @param  close: Character to be inserted at end of S-Expression
+ * @param  *open: Text to be inserted before S-Expression
+ * @param  *close: Text to be inserted at end of S-Expression
  * @retval None
  */
-void lval_print_expr(LVal *lval, char open, char close);
+void lval_print_expr(LBuf *lbuf, LWork *work, LVal *lval, const char *open,
+                     const char *close);
 
 // lval_print_expr wrapper for S-Expressions
-void lval_print_sexpr(LVal *lval);
+void lval_print_sexpr(LBuf *lbuf, LWork *work, LVal *lval);
 // lval_print_expr wrapper for Q-Expressions
-void lval_print_qexpr(LVal *lval);
+void lval_print_qexpr(LBuf *lbuf, LWork *work, LVal *lval);
+
+/**
+ * @brief  Print a hash map as the `dict` call which builds it
+ * @param  *lbuf: The LBuf written to
+ * @param  *work: Where keys and values are scheduled
+ * @param  *lmap: A LVal of type LVAL_MAP
+ * @retval None
+ */
+void lval_print_map(LBuf *lbuf, LWork *work, LVal *lmap);
+
+/**
+ * @brief  Print a lazy sequence as the call which builds it
+ * @note   Elements aren't computed for printing, so an iterated sequence
+ *         whose next element is pending prints as `(drop 1 (iterate ..))`
+ * @param  *lbuf: The LBuf written to
+ * @param  *work: Where held LVal's are scheduled
+ * @param  *lseq: A LVal of type LVAL_SEQ
+ * @retval None
+ */
+void lval_print_seq(LBuf *lbuf, LWork *work, LVal *lseq);
+
+/**
+ * @brief  Print a transient as the call which builds it
+ * @param  *lbuf: The LBuf written to
+ * @param  *work: Where the elements are scheduled
+ * @param  *lval: A LVal of type LVAL_TRANSIENT
+ * @retval None
+ */
+void lval_print_transient(LBuf *lbuf, LWork *work, LVal *lval);
 
 /**
  * @brief  Print a escaped string
+ * @note   Escapes while writing, the LVal's string is never copied
+ * @param  *lbuf: The LBuf written to
  * @param  *lstr: A LVal of type LVAL_STR
  * @retval None
  */
-void lval_print_str(LVal *lstr);
+void lval_print_str(LBuf *lbuf, LVal *lstr);
+
+/**
+ * @brief  Format the message of an error
+ * @param  *lbuf: The LBuf written to
+ * @param  *lerr: A LVal of type LVAL_ERR
+ * @retval None
+ */
+void lval_print_err(LBuf *lbuf, LVal *lerr);
 
 /**
  * @brief  Print type of LVal
@@ -318,6 +921,15 @@ char *lval_print_type(int type);
  */
 LVal *builtin_list(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_list taking a vector of arguments
+ * @param  *lenv: Not used
+ * @param  argc: Number of arguments
+ * @param  **argv: The elements, consumed
+ * @retval A LVal of type LVAL_QEXPR
+ */
+LVal *builtin_listv(LEnv *lenv, int argc, LVal **argv);
+
 /**
  * @brief  Returns head of a qexpr
  * @note   eg: head {0 1 2} => 0
@@ -327,6 +939,15 @@ LVal *builtin_list(LEnv *lenv, LVal *lval);
  */
 LVal *builtin_head(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_head taking a vector of arguments
+ * @param  *lenv: The LEnv a lazy sequence is forced in
+ * @param  argc: Number of arguments
+ * @param  **argv: A qexpr or a lazy sequence, consumed
+ * @retval Head of the qexpr
+ */
+LVal *builtin_headv(LEnv *lenv, int argc, LVal **argv);
+
 /**
  * @brief  Return the rest of the qexpr without the head
  * @note   eg: tail {0 1 2} => {1 2}
@@ -336,6 +957,15 @@ LVal *builtin_head(LEnv *lenv, LVal *lval);
  */
 LVal *builtin_tail(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_tail taking a vector of arguments
+ * @param  *lenv: The LEnv a lazy sequence is forced in
+ * @param  argc: Number of arguments
+ * @param  **argv: A qexpr or a lazy sequence, consumed
+ * @retval Tail of the qexpr
+ */
+LVal *builtin_tailv(LEnv *lenv, int argc, LVal **argv);
+
 /**
  * @brief  Evaluate a qexpr
  * @note   Evaluates a qexpr as a sexpr using lval_eval
@@ -345,6 +975,26 @@ LVal *builtin_tail(LEnv *lenv, LVal *lval);
  */
 LVal *builtin_eval(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_eval taking a vector of arguments
+ * @param  *lenv: The LEnv the qexpr is evaluated in
+ * @param  argc: Number of arguments
+ * @param  **argv: A qexpr, consumed
+ * @retval Value of the qexpr
+ */
+LVal *builtin_evalv(LEnv *lenv, int argc, LVal **argv);
+
+/**
+ * @brief  Evaluate a qexpr, measuring its wall time and hardware counters
+ * @note   Counters are those of the OS thread evaluating (@see LPerf), so
+ *         work of other tasks it runs or waits for is left out
+ * @param  *lenv: LEnv to evaluate in
+ * @param  *lval: LVal of type LVAL_SEXPR with a single LVAL_QEXPR
+ * @retval {result {ns N} {cycles N} ...}, counters which can't be read are
+ *         left out. Errors of the evaluation are returned as they are
+ */
+LVal *builtin_measure(LEnv *lenv, LVal *lval);
+
 /**
  * @brief  Join multiple qexpr
  * @param  *lenv: Not used
@@ -353,23 +1003,36 @@ LVal *builtin_eval(LEnv *lenv, LVal *lval);
  */
 LVal *builtin_join(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_join taking a vector of arguments
+ * @param  *lenv: Not used
+ * @param  argc: Number of arguments
+ * @param  **argv: The qexprs, consumed
+ * @retval The joined lval
+ */
+LVal *builtin_joinv(LEnv *lenv, int argc, LVal **argv);
+
 /**
  * @brief  Evaluate operation LVAL_SYM between LVAL_NUM
+ * @note   Overflowing a long, the result is promoted to a LVAL_BIG, which
+ *         following operations are done on
  * @param  *lenv: Not used
- * @param  *lval: LVal containing numbers as children
+ * @param  argc: Number of operands
+ * @param  **argv: Numbers as operands, consumed
  * @param  *op: Corresponding operator as string for the operation
  * @retval Result wrapped as LVal
  */
-LVal *builtin_op(LEnv *lenv, LVal *lval, char *op);
+LVal *builtin_op(LEnv *lenv, int argc, LVal **argv, char *op);
 
 /**
  * @brief  Evaluate comparision between two LVAL_NUM
  * @param  *lenv: Not used/Cast to void/Required for adding to a LEnv
- * @param  *lval: A LVal having children who are to be compared
+ * @param  argc: Number of arguments
+ * @param  **argv: The LVal's to be compared, consumed
  * @param  *op: The operator as a string
  * @retval Result wrapped as a LVal
  */
-LVal *builtin_cmp(LEnv *lenv, LVal *lval, char *op);
+LVal *builtin_cmp(LEnv *lenv, int argc, LVal **argv, char *op);
 
 /**
  * @brief  A builtin for if conditional
@@ -379,6 +1042,38 @@ LVal *builtin_cmp(LEnv *lenv, LVal *lval, char *op);
  */
 LVal *builtin_if(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  builtin_if taking a vector of arguments
+ * @param  *lenv: The LEnv the chosen branch is evaluated in
+ * @param  argc: Number of arguments
+ * @param  **argv: The condition and both branches, consumed
+ * @retval Evaluation of the branch chosen by the condition
+ */
+LVal *builtin_ifv(LEnv *lenv, int argc, LVal **argv);
+
+/**
+ * @brief  Evaluate forms as long as a condition holds
+ * @note   eg: `while {< i 10} {= {i} (+ i 1)}`. The condition and forms are
+ *         Q-Expressions evaluated as S-Expressions in `lenv`, without
+ *         copying them on each iteration (@see lval_eval_borrowed)
+ * @param  *lenv: The LEnv the condition and forms are evaluated in
+ * @param  *lval: The condition, then any number of forms
+ * @retval An empty S-Expression, or the first error
+ */
+LVal *builtin_while(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Evaluate forms a number of times, counting in a variable
+ * @note   eg: `dotimes {i} 10 {print i}`. The variable is bound in `lenv`
+ *         to 0 up to the count excluded, forms are evaluated as in
+ *         builtin_while
+ * @param  *lenv: The LEnv the variable is bound and forms evaluated in
+ * @param  *lval: The variable in a Q-Expression, the count, then any number
+ *                of forms
+ * @retval An empty S-Expression, or the first error
+ */
+LVal *builtin_dotimes(LEnv *lenv, LVal *lval);
+
 /**
  * @brief  Builtins for lambda expressions
  * @param  *lenv: The default LEnv
@@ -404,6 +1099,18 @@ LVal *builtin_def(LEnv *lenv, LVal *lval);
 /* A wrapper to builtin_var for local definitions */
 LVal *builtin_put(LEnv *lenv, LVal *lval);
 
+/**
+ * @brief  Evaluate the forms read from a file, like `load` does
+ * @note   Forms are folded first, errors they evaluate to are printed
+ * @param  *lenv: The environment where the forms are evaluated
+ * @param  *lforms: A LVAL_SEXPR of the forms, consumed
+ * @param  *after: Called after every form with `ctx`, may be NULL
+ * @param  *ctx: Passed to `after`
+ * @retval None
+ */
+void lval_eval_forms(LEnv *lenv, LVal *lforms,
+                     void (*after)(LEnv *lenv, void *ctx), void *ctx);
+
 /**
  * @brief  Load files containing valid lispy expression
  * @param  *lenv: The environment where the expressions are loaded
@@ -413,10 +1120,32 @@ LVal *builtin_put(LEnv *lenv, LVal *lval);
 LVal *builtin_load(LEnv *lenv, LVal *lval);
 
 /**
- * @brief  Print a expression
- * @param  *lenv: A LEnv
- * @param  *lval: A LVal containing the expressions
- * @retval A LVal of type LVAL_SEXPR
+ * @brief  Write a value to a file in a compact binary encoding
+ * @note   eg: dump "data.bin" {1 "a" (dict "k" {2})}. Much faster to read
+ *         back with undump than printing and loading it (@see lser.h).
+ *         Functions, errors, sequences, futures and transients can't be
+ *         dumped
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the path and the value
+ * @retval An empty S-Expression, or an error
+ */
+LVal *builtin_dump(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Read back a value written by dump
+ * @note   The file is mapped, long strings are views into it rather than
+ *         copies (@see lser_undump)
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the path
+ * @retval The value, or an error
+ */
+LVal *builtin_undump(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Print a expression
+ * @param  *lenv: A LEnv
+ * @param  *lval: A LVal containing the expressions
+ * @retval A LVal of type LVAL_SEXPR
  */
 LVal *builtin_print(LEnv *lenv, LVal *lval);
 
@@ -427,46 +1156,356 @@ LVal *builtin_print(LEnv *lenv, LVal *lval);
  * @retval A LVal of type LVAL_ERR
  */
 LVal *builtin_err(LEnv *lenv, LVal *lval);
-/* Wrappers for single operations of builtin_op */
+
+/**
+ * @brief  Get the error code of evaluating a qexpr
+ * @note   Errors can't be passed as arguments since they abort evaluation,
+ *         hence the expression is passed quoted
+ * @param  *lenv: The LEnv in which the qexpr is evaluated
+ * @param  *lval: LVal containing a single LVAL_QEXPR
+ * @retval A LVal of type LVAL_NUM, LERR_NONE if evaluation did not fail
+ */
+LVal *builtin_err_code(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Render a LVal as it would be printed into a LVAL_STR
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing a single LVal of any type
+ * @retval A LVal of type LVAL_STR
+ */
+LVal *builtin_tostr(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Build a hash map from alternating keys and values
+ * @note   eg: dict "a" 1 "b" 2 => (dict "a" 1 "b" 2), dict {} => (dict)
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing keys (numbers, strings or symbols) each
+ *                followed by its value, or a single qexpr containing them
+ * @retval A LVal of type LVAL_MAP
+ */
+LVal *builtin_dict(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Get the value of a key in a hash map
+ * @note   eg: dict-get (dict "a" 1) "b" 0 => 0
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the map, the key and optionally a default
+ * @retval The value, else the default or an error if there is none
+ */
+LVal *builtin_dict_get(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Insert or replace the value of a key in a hash map
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the map, the key and the value
+ * @retval The updated map, copied first only if it is shared
+ */
+LVal *builtin_dict_put(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Remove a key from a hash map
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the map and the key
+ * @retval The map without the key
+ */
+LVal *builtin_dict_del(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Get the keys of a hash map
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the map
+ * @retval A LVal of type LVAL_QEXPR
+ */
+LVal *builtin_dict_keys(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Get the number of keys in a hash map
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the map
+ * @retval A LVal of type LVAL_NUM
+ */
+LVal *builtin_dict_size(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Lazy sequence of numbers
+ * @note   eg: range 3 => 0 1 2, range 1 4 => 1 2 3, range 5 0 -2 => 5 3 1
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the bound, or start, bound and optionally
+ *                the step (which is 1 by default)
+ * @retval A LVal of type LVAL_SEQ
+ */
+LVal *builtin_range(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Lazy sequence of a value, its image under a function and so on
+ * @note   eg: iterate (\ {x} {* x 2}) 1 => 1 2 4 8 ...
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the function and the first element
+ * @retval A LVal of type LVAL_SEQ
+ */
+LVal *builtin_iterate(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Lazy sequence repeating a value
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the value and optionally the count,
+ *                without which it is repeated infinitely
+ * @retval A LVal of type LVAL_SEQ
+ */
+LVal *builtin_repeat(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Lazy sequence generated by a function from a state
+ * @note   The function is called with the state and returns {} to end the
+ *         sequence or {element next-state}
+ *         eg: gen (\ {s} {if (> s 3) {{}} {list s (+ s 1)}}) 1 => 1 2 3
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the function and the first state
+ * @retval A LVal of type LVAL_SEQ
+ */
+LVal *builtin_gen(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Take the first elements of a qexpr or sequence
+ * @note   eg: take 2 (range 10) => {0 1}
+ * @param  *lenv: LEnv in which elements of a sequence are computed
+ * @param  *lval: LVal containing the count and a qexpr or sequence
+ * @retval A LVal of type LVAL_QEXPR
+ */
+LVal *builtin_take(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Skip the first elements of a qexpr or sequence
+ * @param  *lenv: LEnv in which elements of a sequence are computed
+ * @param  *lval: LVal containing the count and a qexpr or sequence
+ * @retval The rest of the qexpr or sequence
+ */
+LVal *builtin_drop(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Apply a function to every element of a qexpr
+ * @note   eg: map (\ {x} {* x x}) {1 2 3} => {1 4 9}
+ * @param  *lenv: LEnv in which the function is called
+ * @param  *lval: LVal containing the function and a qexpr
+ * @retval A LVal of type LVAL_QEXPR with the results
+ */
+LVal *builtin_map(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Keep the elements of a qexpr for which a function returns non-zero
+ * @note   eg: filter (\ {x} {> x 1}) {1 2 3} => {2 3}
+ * @param  *lenv: LEnv in which the function is called
+ * @param  *lval: LVal containing the function and a qexpr
+ * @retval A LVal of type LVAL_QEXPR with the kept elements
+ */
+LVal *builtin_filter(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Sort a qexpr of numbers or of strings ascending
+ * @note   eg: sort {3 1 2} => {1 2 3}, sort {"b" "a"} => {"a" "b"}
+ *         Numbers are radix sorted, strings introsorted (@see lsort.h)
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing a qexpr, whose elements are all LVAL_NUM
+ *                or all LVAL_STR
+ * @retval The sorted qexpr
+ */
+LVal *builtin_sort(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Sort a qexpr stably, by a function telling if an element goes
+ *         before another
+ * @note   eg: sort-by (\ {a b} {> a b}) {1 3 2} => {3 2 1}
+ *         Merge sort, so elements the function doesn't order keep their order
+ * @param  *lenv: LEnv in which the function is called
+ * @param  *lval: LVal containing the function and a qexpr
+ * @retval The sorted qexpr, or the first error returned by the function
+ */
+LVal *builtin_sort_by(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Fold a qexpr or sequence from the left
+ * @note   Elements of a sequence are computed one at a time, so folding a
+ *         sequence runs in constant memory
+ *         eg: foldl + 0 (range 5) => 10
+ * @param  *lenv: LEnv in which the function is called
+ * @param  *lval: LVal containing the function (called with the accumulator
+ *                and an element), the initial value and a qexpr or sequence
+ * @retval The final value of the accumulator
+ */
+LVal *builtin_fold(LEnv *lenv, LVal *lval);
+
+/* Wrappers to builtin_fold */
+LVal *builtin_reduce(LEnv *lenv, LVal *lval);
+
+LVal *builtin_foldl(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Create a transient, a buffer modified in place
+ * @note   eg: transient {1 2} => (transient {1 2}). O(1), the elements of
+ *         the qexpr are taken over (@see LTransient)
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the initial elements in a qexpr
+ * @retval A LVal of type LVAL_TRANSIENT
+ */
+LVal *builtin_transient(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Append values to a transient
+ * @note   eg: push! t 3 4 => (transient {1 2 3 4}). Amortized O(1)
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the transient, then the values
+ * @retval The transient
+ */
+LVal *builtin_push(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  builtin_push taking a vector of arguments
+ * @param  *lenv: Not used
+ * @param  argc: Number of arguments
+ * @param  **argv: The transient then the values, consumed
+ * @retval The transient
+ */
+LVal *builtin_pushv(LEnv *lenv, int argc, LVal **argv);
+
+/**
+ * @brief  Replace an element of a transient
+ * @note   eg: set-nth! t 0 5 => (transient {5 2})
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the transient, an index and the value
+ * @retval The transient, or an error if the index is out of range
+ */
+LVal *builtin_set_nth(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Get an element of a transient or a qexpr by index, from 0
+ * @note   eg: nth {1 2 3} 1 => 2
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the transient or qexpr and an index
+ * @retval The element, or an error if the index is out of range
+ */
+LVal *builtin_nth(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  builtin_nth taking a vector of arguments
+ * @param  *lenv: Not used
+ * @param  argc: Number of arguments
+ * @param  **argv: The transient or qexpr then the index, consumed
+ * @retval The element, or an error if the index is out of range
+ */
+LVal *builtin_nthv(LEnv *lenv, int argc, LVal **argv);
+
+/**
+ * @brief  Turn a transient into a qexpr of its elements
+ * @note   eg: freeze t => {5 2}. O(1), the elements are handed over and the
+ *         transient left frozen: using it again is an error
+ * @param  *lenv: Not used
+ * @param  *lval: LVal containing the transient
+ * @retval A LVal of type LVAL_QEXPR
+ */
+LVal *builtin_freeze(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Call a function on every line of a file, or fold over the lines
+ * @note   The file is mapped instead of read, long lines are passed as views
+ *         into the mapping (@see lval_wrap_view). With a delimiter, lines
+ *         are split into a qexpr of fields (no quoting is understood)
+ *         eg: each-line print "log.txt"
+ *             fold-lines (\ {n l} {+ n 1}) 0 "log.txt"
+ *             each-line (\ {fields} {print (head fields)}) "data.csv" ","
+ * @param  *lenv: LEnv in which the function is called
+ * @param  *lval: LVal containing the function, the initial value (only for
+ *                fold-lines), the path and optionally a delimiter
+ * @param  *lbuiltin: Name of the builtin, either "each-line" or "fold-lines"
+ * @retval () for each-line, the final value of the accumulator for
+ *         fold-lines, or the first error returned by the function
+ */
+LVal *builtin_lines(LEnv *lenv, LVal *lval, char *lbuiltin);
+
+/* Wrappers to builtin_lines */
+LVal *builtin_each_line(LEnv *lenv, LVal *lval);
+
+LVal *builtin_fold_lines(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Run code in a task, concurrently with the caller
+ * @note   eg: (spawn {fib 30}) or (spawn (\ {} {fib 30}))
+ *         The task sees the global environment read only (binding globals
+ *         is an error) and a private copy of the caller's local bindings
+ * @param  *lenv: LEnv of the caller
+ * @param  *lval: A Q-Expression to be evaluated or a function to be called
+ *                without arguments
+ * @retval A future of the result (@see builtin_await)
+ */
+LVal *builtin_spawn(LEnv *lenv, LVal *lval);
+
+/**
+ * @brief  Wait for the result of a task
+ * @note   eg: (await (spawn {+ 1 2})) => 3
+ *         Errors of the task are returned like any result
+ * @param  *lenv: Not used
+ * @param  *lval: A future returned by spawn
+ * @retval The result of the task
+ */
+LVal *builtin_await(LEnv *lenv, LVal *lval);
+
+/* Wrappers for single operations of builtin_op, as LBuiltinV and LBuiltin */
+LVal *builtin_addv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_add(LEnv *lenv, LVal *lval);
 
+LVal *builtin_subv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_sub(LEnv *lenv, LVal *lval);
 
+LVal *builtin_mulv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_mul(LEnv *lenv, LVal *lval);
 
+LVal *builtin_divv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_div(LEnv *lenv, LVal *lval);
 
+LVal *builtin_modv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_mod(LEnv *lenv, LVal *lval);
 
 /* Wrappers for single operations of builtin_ord */
+LVal *builtin_gtv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_gt(LEnv *lenv, LVal *lval);
 
+LVal *builtin_ltv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_lt(LEnv *lenv, LVal *lval);
 
+LVal *builtin_gev(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_ge(LEnv *lenv, LVal *lval);
 
+LVal *builtin_lev(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_le(LEnv *lenv, LVal *lval);
 
 /* Wrappers for single operations of builtin_cmp */
+LVal *builtin_eqv(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_eq(LEnv *lenv, LVal *lval);
 
+LVal *builtin_nev(LEnv *lenv, int argc, LVal **argv);
 LVal *builtin_ne(LEnv *lenv, LVal *lval);
 
 /**
- * @brief  Associate a builtin and its symbol in a LEnv
- * @param  *lenv: The LEnv where the builtin is to be stored
- * @param  *sym: The symbol name of the builtin
- * @param  lbuiltin: The lbuiltin to be associated with sym
- * @retval None
+ * @brief  Check arguments of a builtin against its signature
+ * @note   Raises the errors LASSERT_CHILD_COUNT and LASSERT_CHILD_TYPE
+ *         would, in the same order (@see builtins.def)
+ * @param  *sym: Name of the builtin, for errors
+ * @param  *sig: Signature of the builtin, as compiled by mkbuiltins
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments, left untouched
+ * @retval An error, or NULL if the arguments match
  */
-void lenv_add_builtin(LEnv *lenv, char *sym, LBuiltin lbuiltin);
+static inline LVal *lbuiltin_check(const char *sym, const LBuiltinSig *sig,
+                                    int argc, LVal **argv);
 
 /**
- * @brief  Add default builtins to LEnv
- * @param  *lenv: The LEnv where the builtins are to be added
- * @retval None
+ * @brief  Find a builtin by name, with the perfect hash of lbuiltins.h
+ * @param  *sym: A null terminated name
+ * @retval Index of the builtin in lbuiltins, or -1
  */
-void lenv_init_builtins(LEnv *lenv);
+int lbuiltin_index(const char *sym);
+
+/* Every builtin, in the order of builtins.def */
+extern LBuiltinDef lbuiltins[];
 
 ///////////////////////////////////////////////////////////////////////////////
 /* Functions to wrap primitives as LVal */
@@ -475,50 +1514,70 @@ void lenv_init_builtins(LEnv *lenv);
 LVal *lval_wrap_long(long num) {
     LVal *lval = malloc(sizeof(LVal));
     lval->type = LVAL_NUM;
+    lval->flags = 0;
     lval->num = num;
     return lval;
 }
 
-LVal *lval_wrap_sym(char *sym) {
+LVal *lval_wrap_big(LBig *lbig) {
+    long num;
+    if (lbig_to_long(lbig, &num)) {
+        lbig_del(lbig);
+        return lval_wrap_long(num);
+    }
+    LVal *lval = malloc(sizeof(LVal));
+    lval->type = LVAL_BIG;
+    lval->flags = 0;
+    lval->lbig = lbig;
+    return lval;
+}
+
+LVal *lval_wrap_sym(char *sym) { return lval_wrap_symn(sym, strlen(sym)); }
+
+LVal *lval_wrap_symn(const char *sym, size_t len) {
     LVal *lsym = malloc(sizeof(LVal));
     lsym->type = LVAL_SYM;
-    lsym->sym = malloc(strlen(sym) + 1);
-    strcpy(lsym->sym, sym);
+    lsym->flags = 0;
+    lsym->icache = NULL;
+    lsym->sym = lval_alloc_chars(lsym, len);
+    memcpy(lsym->sym, sym, len);
+    lsym->sym[len] = '\0';
     return lsym;
 }
 
-LVal *lval_wrap_err(char *fmt, ...) {
+// Errors without arguments are preallocated and never freed
+LVal lerr_div_zero = {.type = LVAL_ERR,
+                      .flags = LFLAG_STATIC,
+                      .errcode = LERR_DIV_ZERO};
+LVal lerr_bad_variadic = {.type = LVAL_ERR,
+                          .flags = LFLAG_STATIC,
+                          .errcode = LERR_BAD_VARIADIC};
+
+LVal *lval_wrap_err(int errcode, const char *errfn, long arg0, long arg1,
+                    long arg2) {
     LVal *lerr = malloc(sizeof(LVal));
     lerr->type = LVAL_ERR;
+    lerr->flags = 0;
+    lerr->errcode = errcode;
+    lerr->errfn = errfn;
+    lerr->errargs[0] = arg0;
+    lerr->errargs[1] = arg1;
+    lerr->errargs[2] = arg2;
+    lerr->err = NULL;
+    return lerr;
+}
 
-    // Create a variable list to store the arguments
-    va_list va;
-
-    // Initialize the va_list
-    // va_start takes two arguments:
-    // The va_list and the last argument before ellipsis
-    va_start(va, fmt);
-
-    // Allocate maximum size of error string
-    lerr->err = malloc(MAX_ERR);
-
-    // Copy the va string to lerr->err atmost MAX_ERR bytes including null
-    // Leaving space for null byte is therefore required
-    vsnprintf(lerr->err, MAX_ERR - 1, fmt, va);
-
-    // Resize(Reduce) lerr->err to size of va string from MAX_ERR
-    // Again here, strlen doesn't output size of string including null byte
-    lerr->err = realloc(lerr->err, strlen(lerr->err) + 1);
-
-    // Free va_list
-    va_end(va);
-
+LVal *lval_wrap_err_str(int errcode, const char *str) {
+    LVal *lerr = lval_wrap_err(errcode, NULL, 0, 0, 0);
+    lerr->err = malloc(strlen(str) + 1);
+    strcpy(lerr->err, str);
     return lerr;
 }
 
 LVal *lval_wrap_expr(int type) {
     LVal *lval = malloc(sizeof(LVal));
     lval->type = type;
+    lval->flags = 0;
     lval->child_count = 0;
     lval->children = NULL;
     return lval;
@@ -528,18 +1587,40 @@ LVal *lval_wrap_sexpr(void) { return lval_wrap_expr(LVAL_SEXPR); }
 LVal *lval_wrap_qexpr(void) { return lval_wrap_expr(LVAL_QEXPR); }
 
 LVal *lval_wrap_lbuiltin(LBuiltin lbuiltin) {
+    return lval_wrap_lbuiltinv(lbuiltin, NULL);
+}
+
+LVal *lval_wrap_lbuiltinv(LBuiltin lbuiltin, LBuiltinV lbuiltinv) {
     LVal *lfun = malloc(sizeof(LVal));
     lfun->type = LVAL_FUN;
+    lfun->flags = 0;
     lfun->lbuiltin = lbuiltin;
+    lfun->lbuiltinv = lbuiltinv;
+    lfun->lenv = NULL;
+    lfun->lformals = NULL;
+    lfun->lbody = NULL;
+    lfun->lfolded = NULL;
     return lfun;
 }
 
+LVal *lval_wrap_argv(int argc, LVal **argv) {
+    LVal *lval = lval_wrap_sexpr();
+    if (argc > 0) {
+        lval->children = malloc(sizeof(LVal *) * (size_t)argc);
+        memcpy(lval->children, argv, sizeof(LVal *) * (size_t)argc);
+        lval->child_count = argc;
+    }
+    return lval;
+}
+
 LVal *lval_wrap_lambda(LVal *lformals, LVal *lbody) {
     LVal *llambda = malloc(sizeof(LVal));
     llambda->type = LVAL_FUN;
+    llambda->flags = 0;
 
     // lambdas are user functions so, lbuiltin field is set to NULL
     llambda->lbuiltin = NULL;
+    llambda->lbuiltinv = NULL;
 
     // Also provide a new local environment
     llambda->lenv = lenv_new();
@@ -547,46 +1628,236 @@ LVal *lval_wrap_lambda(LVal *lformals, LVal *lbody) {
     // Set formals(parameter list) and the body of lambda
     llambda->lformals = lformals;
     llambda->lbody = lbody;
+    llambda->lfolded = NULL;
+    llambda->ljit = ljit_new();
 
     return llambda;
 }
 
-LVal *lval_wrap_str(char *str) {
+LVal *lval_wrap_str(char *str) { return lval_wrap_strn(str, strlen(str)); }
+
+LVal *lval_wrap_seq(LSeq *lseq) {
+    LVal *lval = malloc(sizeof(LVal));
+    lval->type = LVAL_SEQ;
+    lval->flags = 0;
+    lval->lseq = lseq;
+    return lval;
+}
+
+LVal *lval_wrap_future(LTask *ltask) {
+    LVal *lval = malloc(sizeof(LVal));
+    lval->type = LVAL_FUTURE;
+    lval->flags = 0;
+    lval->ltask = ltask;
+    return lval;
+}
+
+LVal *lval_wrap_transient(LTransient *ltransient) {
+    LVal *lval = malloc(sizeof(LVal));
+    lval->type = LVAL_TRANSIENT;
+    lval->flags = 0;
+    lval->ltransient = ltransient;
+    return lval;
+}
+
+LVal *lval_wrap_map(LMap *lmap) {
+    LVal *ldict = malloc(sizeof(LVal));
+    ldict->type = LVAL_MAP;
+    ldict->flags = 0;
+    ldict->lmap = lmap;
+    return ldict;
+}
+
+LVal *lval_wrap_strn(const char *str, size_t len) {
+    LVal *lstr = malloc(sizeof(LVal));
+    lstr->type = LVAL_STR;
+    lstr->flags = 0;
+    lstr->str = lval_alloc_chars(lstr, len);
+    memcpy(lstr->str, str, len);
+    lstr->str[len] = '\0';
+    return lstr;
+}
+
+char *lval_alloc_chars(LVal *lval, size_t len) {
+    lval->len = len;
+    if (len < LVAL_STR_INLINE) {
+        lval->strbuf = NULL;
+        return lval->inl;
+    }
+    lval->strbuf = malloc(sizeof(LStrBuf) + len + 1);
+    lval->strbuf->refs = 1;
+    lval->strbuf->map = NULL;
+    return lval->strbuf->data;
+}
+
+char *lval_copy_chars(LVal *copy, LVal *lval, const char *src) {
+    copy->len = lval->len;
+    copy->strbuf = lval->strbuf;
+    if (copy->strbuf) {
+        // Immutable, so the bytes are shared instead of copied
+        LATOMIC_ADD(copy->strbuf->refs, 1);
+        return (char *)src;
+    }
+    memcpy(copy->inl, src, copy->len + 1);
+    return copy->inl;
+}
+
+void lstrbuf_del(LStrBuf *lstrbuf) {
+    if (lstrbuf && LATOMIC_ADD(lstrbuf->refs, -1) == 0) {
+        if (lstrbuf->map) {
+            lfile_unmap(lstrbuf->map, lstrbuf->map_len);
+        }
+        free(lstrbuf);
+    }
+}
+
+LVal *lval_wrap_view(LStrBuf *owner, const char *str, size_t len) {
+    if (len < LVAL_STR_INLINE) {
+        return lval_wrap_strn(str, len);
+    }
+
     LVal *lstr = malloc(sizeof(LVal));
     lstr->type = LVAL_STR;
-    lstr->str = malloc(strlen(str) + 1);
-    strcpy(lstr->str, str);
+    lstr->flags = 0;
+    lstr->str = (char *)str;
+    lstr->len = len;
+    lstr->strbuf = owner;
+    LATOMIC_ADD(owner->refs, 1);
     return lstr;
 }
 
+void lval_str_terminate(LVal *lstr) {
+    LStrBuf *owner = lstr->strbuf;
+    if (!owner || !owner->map) {
+        return;
+    }
+
+    const char *view = lstr->str;
+    lstr->str = lval_alloc_chars(lstr, lstr->len);
+    memcpy(lstr->str, view, lstr->len);
+    lstr->str[lstr->len] = '\0';
+    lstrbuf_del(owner);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /* Functions to operate on LVal struct */
 ///////////////////////////////////////////////////////////////////////////////
 
+void lwork_init(LWork *work) {
+    work->items = work->inl;
+    work->len = 0;
+    work->cap = LWORK_INLINE;
+}
+
+void lwork_push(LWork *work, void *item) {
+    if (work->len == work->cap) {
+        // Starts with the inline items, or none for a zeroed LWork
+        size_t cap = work->cap ? work->cap * 2 : LWORK_INLINE;
+        void **items = malloc(sizeof(void *) * cap);
+        if (work->len) {
+            memcpy(items, work->items, sizeof(void *) * work->len);
+        }
+        if (work->items != work->inl) {
+            free(work->items);
+        }
+        work->items = items;
+        work->cap = cap;
+    }
+    work->items[work->len++] = item;
+}
+
+void *lwork_pop(LWork *work) { return work->items[--work->len]; }
+
+void lwork_free(LWork *work) {
+    if (work->items != work->inl) {
+        free(work->items);
+    }
+    lwork_init(work);
+}
+
 void lval_del(LVal *lval) {
+    LWork work;
+    lwork_init(&work);
+    lval_del_node(lval, &work);
+    while (work.len) {
+        lval_del_node(lwork_pop(&work), &work);
+    }
+    lwork_free(&work);
+}
+
+// Trees queued by lval_del_deferred, a zeroed LWork which only uses the heap
+static LWork lval_garbage;
+
+void lval_del_deferred(LVal *lval) { lwork_push(&lval_garbage, lval); }
+
+int lval_reclaim(size_t budget) {
+    for (size_t freed = 0; lval_garbage.len && (!budget || freed < budget);
+         freed++) {
+        lval_del_node(lwork_pop(&lval_garbage), &lval_garbage);
+    }
+    if (lval_garbage.len) {
+        return 1;
+    }
+
+    free(lval_garbage.items);
+    lval_garbage.items = NULL;
+    lval_garbage.cap = 0;
+    return 0;
+}
+
+void lval_del_node(LVal *lval, LWork *work) {
+    // Preallocated LVal's are shared and live forever
+    if (lval->flags & LFLAG_STATIC) {
+        return;
+    }
+
+    if (lval->flags & LFLAG_FOLDED) {
+        lfold_del(lval->lfold);
+    }
+
     switch (lval->type) {
         case LVAL_NUM:
             break;
+        case LVAL_BIG:
+            lbig_del(lval->lbig);
+            break;
         case LVAL_FUN:
             if (!(lval->lbuiltin)) {
                 lenv_del(lval->lenv);
-                lval_del(lval->lformals);
-                lval_del(lval->lbody);
+                lwork_push(work, lval->lformals);
+                lwork_push(work, lval->lbody);
+                if (lval->lfolded) {
+                    lwork_push(work, lval->lfolded);
+                }
+                ljit_del(lval->ljit);
             }
             break;
         case LVAL_ERR:
             free(lval->err);
             break;
         case LVAL_SYM:
-            free(lval->sym);
+            lstrbuf_del(lval->strbuf);
+            licache_del(lval->icache);
             break;
         case LVAL_STR:
-            free(lval->str);
+            lstrbuf_del(lval->strbuf);
+            break;
+        case LVAL_MAP:
+            lmap_del(lval->lmap);
+            break;
+        case LVAL_SEQ:
+            lseq_del(lval->lseq);
+            break;
+        case LVAL_FUTURE:
+            ltask_del(lval->ltask);
+            break;
+        case LVAL_TRANSIENT:
+            ltransient_del(lval->ltransient, work);
             break;
         case LVAL_SEXPR:
         case LVAL_QEXPR:
             for (int i = 0; i < lval->child_count; i++) {
-                lval_del(lval->children[i]);
+                lwork_push(work, lval->children[i]);
             }
             free(lval->children);
             break;
@@ -595,40 +1866,106 @@ void lval_del(LVal *lval) {
 }
 
 LVal *lval_copy(LVal *lval) {
+    LWork work;
+    lwork_init(&work);
+    LVal *copy = lval_copy_node(lval, &work);
+    while (work.len) {
+        LVal **slot = lwork_pop(&work);
+        *slot = lval_copy_node(lwork_pop(&work), &work);
+    }
+    lwork_free(&work);
+    return copy;
+}
+
+LVal *lval_copy_node(LVal *lval, LWork *work) {
+    // Preallocated LVal's are immutable, so they need not be copied
+    if (lval->flags & LFLAG_STATIC) {
+        return lval;
+    }
+
     LVal *copy = malloc(sizeof(LVal));
     copy->type = lval->type;
+    copy->flags = lval->flags & LFLAG_FOLDED;
+    if (copy->flags & LFLAG_FOLDED) {
+        copy->lfold = lval->lfold;
+        LATOMIC_ADD(copy->lfold->refs, 1);
+    }
     switch (copy->type) {
         case LVAL_NUM:
             copy->num = lval->num;
             break;
+        case LVAL_BIG:
+            copy->lbig = lval->lbig;
+            LATOMIC_ADD(copy->lbig->refs, 1);
+            break;
         case LVAL_FUN:
             if (lval->lbuiltin) {
                 copy->lbuiltin = lval->lbuiltin;
+                copy->lbuiltinv = lval->lbuiltinv;
             } else {
                 copy->lbuiltin = NULL;
+                copy->lbuiltinv = NULL;
                 copy->lenv = lenv_copy(lval->lenv);
-                copy->lformals = lval_copy(lval->lformals);
-                copy->lbody = lval_copy(lval->lbody);
+                lwork_push(work, lval->lformals);
+                lwork_push(work, &copy->lformals);
+                lwork_push(work, lval->lbody);
+                lwork_push(work, &copy->lbody);
+                copy->lfolded = NULL;
+                if (lval->lfolded) {
+                    lwork_push(work, lval->lfolded);
+                    lwork_push(work, &copy->lfolded);
+                }
+                // Copies share the native code and count calls together
+                copy->ljit = lval->ljit;
+                if (copy->ljit) {
+                    LATOMIC_ADD(copy->ljit->refs, 1);
+                }
             }
             break;
         case LVAL_SYM:
-            copy->sym = malloc(strlen(lval->sym) + 1);
-            strcpy(copy->sym, lval->sym);
+            copy->sym = lval_copy_chars(copy, lval, lval->sym);
+            // Copies share the cache so lookups through them benefit all
+            copy->icache = lval->icache;
+            if (copy->icache) {
+                LATOMIC_ADD(copy->icache->refs, 1);
+            }
             break;
         case LVAL_ERR:
-            copy->err = malloc(strlen(lval->err) + 1);
-            strcpy(copy->err, lval->err);
+            copy->errcode = lval->errcode;
+            copy->errfn = lval->errfn;
+            memcpy(copy->errargs, lval->errargs, sizeof(lval->errargs));
+            copy->err = NULL;
+            if (lval->err) {
+                copy->err = malloc(strlen(lval->err) + 1);
+                strcpy(copy->err, lval->err);
+            }
             break;
         case LVAL_STR:
-            copy->str = malloc(strlen(lval->str) + 1);
-            strcpy(copy->str, lval->str);
+            copy->str = lval_copy_chars(copy, lval, lval->str);
+            break;
+        case LVAL_MAP:
+            // Shared until either copy is modified (@see lmap_own)
+            copy->lmap = lval->lmap;
+            LATOMIC_ADD(copy->lmap->refs, 1);
+            break;
+        case LVAL_SEQ:
+            copy->lseq = lval->lseq;
+            LATOMIC_ADD(copy->lseq->refs, 1);
+            break;
+        case LVAL_FUTURE:
+            copy->ltask = ltask_ref(lval->ltask);
+            break;
+        case LVAL_TRANSIENT:
+            copy->ltransient = lval->ltransient;
+            LATOMIC_ADD(copy->ltransient->refs, 1);
             break;
         case LVAL_SEXPR:
         case LVAL_QEXPR:
             copy->child_count = lval->child_count;
-            copy->children = malloc(sizeof(LVal) * copy->child_count);
+            copy->children = malloc(sizeof(LVal *) * copy->child_count);
             for (int i = 0; i < copy->child_count; i++) {
-                copy->children[i] = lval_copy(lval->children[i]);
+                lwork_push(work, lval->children[i]);
+                lwork_push(work, &copy->children[i]);
             }
             break;
     }
@@ -688,12 +2025,27 @@ LVal *lval_take(LVal *lval, int index) {
     return popped;
 }
 
+void lval_del_argv(int argc, LVal **argv) {
+    for (int i = 0; i < argc; i++) {
+        lval_del(argv[i]);
+    }
+}
+
 LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs) {
     // Return the lbuiltin itself if a lbuiltin
     if (lfun->lbuiltin) {
         return lfun->lbuiltin(lenv, largs);
     }
 
+    // Hot lambdas over numbers run as native code (@see jit.h)
+    LVal *lnative =
+        ljit_call(lenv, lfun, largs->child_count, largs->children);
+    if (lnative) {
+        largs->child_count = 0;
+        lval_del(largs);
+        return lnative;
+    }
+
     // Store original args/params count
     int nargs = largs->child_count;
     int nparams = lfun->lformals->child_count;
@@ -703,10 +2055,7 @@ LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs) {
         // Handle when args are remaining even after parameters are exhausted
         if (lfun->lformals->child_count == 0) {
             lval_del(largs);
-            return lval_wrap_err(
-                "Function was passed too many arguments!\n"
-                "Got %i, Expected %i",
-                nargs, nparams);
+            return lval_wrap_err(LERR_TOO_MANY_ARGS, NULL, nargs, nparams, 0);
         }
 
         // Get the first variable symbol
@@ -717,9 +2066,7 @@ LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs) {
             // Check there is only a single param(formal) following "&"
             if (lfun->lformals->child_count != 1) {
                 lval_del(largs);
-                return lval_wrap_err(
-                    "Function format invalid!\n"
-                    "'&' not followed by a single symbol!");
+                return &lerr_bad_variadic;
             }
 
             // Get the next symbol
@@ -753,9 +2100,7 @@ LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs) {
         // Handle edge-case when `&` is not followed by a single argument,
         // But wasn't caught by assignment due to absence of args
         if (lfun->lformals->child_count != 2) {
-            return lval_wrap_err(
-                "Function format invalid!\n"
-                "'&' not followed by a single symbol!");
+            return &lerr_bad_variadic;
         }
 
         lval_del(lval_pop(lfun->lformals, 0));
@@ -771,46 +2116,216 @@ LVal *lval_call(LEnv *lenv, LVal *lfun, LVal *largs) {
     // If all params(formals) are bound, evaluate
     if (lfun->lformals->child_count == 0) {
         lfun->lenv->parent = lenv;
-        return builtin_eval(
-            lfun->lenv, lval_add(lval_wrap_sexpr(), lval_copy(lfun->lbody)));
+        // Prefer the body with constants folded
+        LVal *lbody = lfun->lfolded ? lfun->lfolded : lfun->lbody;
+        return lval_eval_body(lfun->lenv, lbody);
     } else {
         // For partial evaluation, return a copy of function
         return lval_copy(lfun);
     }
 }
 
-int lval_eq(LVal *first, LVal *second) {
-    if (first->type != second->type) {
-        return 0;
+LVal *lval_apply(LEnv *lenv, LVal *lfun, LVal *largs) {
+    // Builtins without a LBuiltinV take the S-Expression as it is
+    if (lfun->lbuiltin && !lfun->lbuiltinv) {
+        return lfun->lbuiltin(lenv, largs);
     }
 
-    int type = first->type;
+    LVal *result =
+        lval_apply_argv(lenv, lfun, largs->child_count, largs->children);
+    largs->child_count = 0;
+    lval_del(largs);
+    return result;
+}
 
-    switch (type) {
-        case LVAL_NUM:
-            return (first->num == second->num);
-        case LVAL_ERR:
-            return (strcmp(first->err, second->err) == 0);
-        case LVAL_SYM:
-            return (strcmp(first->sym, second->sym) == 0);
-        case LVAL_STR:
-            return (strcmp(first->str, second->str) == 0);
-        case LVAL_FUN:
-            if (first->lbuiltin || second->lbuiltin) {
-                return (first->lbuiltin == second->lbuiltin);
-            } else {
-                return (lval_eq(first->lformals, second->lformals) &&
-                        lval_eq(first->lbody, second->lbody));
+LVal *lval_apply_argv(LEnv *lenv, LVal *lfun, int argc, LVal **argv) {
+    // Builtins don't modify themselves, lambdas get their arguments bound
+    if (lfun->lbuiltinv) {
+        return lfun->lbuiltinv(lenv, argc, argv);
+    }
+    if (lfun->lbuiltin) {
+        return lfun->lbuiltin(lenv, lval_wrap_argv(argc, argv));
+    }
+
+    LVal *lnative = ljit_call(lenv, lfun, argc, argv);
+    if (lnative) {
+        return lnative;
+    }
+
+    // With an argument for every formal, they are bound in a frame or only
+    // the environment is copied to bind them, as lval_call would after
+    // copying the whole function
+    LVal *lformals = lfun->lformals;
+    int complete = argc == lformals->child_count;
+    for (int i = 0; complete && i < argc; i++) {
+        complete = strcmp(lformals->children[i]->sym, "&") != 0;
+    }
+    if (complete && argc > 0 && lfun->lenv->child_count == 0) {
+        return lval_call_frame(lenv, lfun, argc, argv);
+    }
+    if (complete) {
+        LEnv *local = lenv_copy(lfun->lenv);
+        for (int i = 0; i < argc; i++) {
+            lenv_put(local, lformals->children[i], argv[i]);
+            lval_del(argv[i]);
+        }
+
+        local->parent = lenv;
+        LVal *lbody = lfun->lfolded ? lfun->lfolded : lfun->lbody;
+        LVal *result = lval_eval_body(local, lbody);
+        lenv_del(local);
+        return result;
+    }
+
+    LVal *copy = lval_copy(lfun);
+    LVal *result = lval_call(lenv, copy, lval_wrap_argv(argc, argv));
+    lval_del(copy);
+    return result;
+}
+
+LVal *lval_call_argv(LEnv *lenv, LVal *lfun, int argc, LVal **argv) {
+    if (lfun->lbuiltinv) {
+        return lfun->lbuiltinv(lenv, argc, argv);
+    }
+    if (lfun->lbuiltin) {
+        return lfun->lbuiltin(lenv, lval_wrap_argv(argc, argv));
+    }
+
+    LVal *lnative = ljit_call(lenv, lfun, argc, argv);
+    if (lnative) {
+        return lnative;
+    }
+
+    // With an argument for every formal they are moved from the vector into
+    // a frame, or into the lambda's own LEnv if it already binds some. Else
+    // lval_call handles partial and variadic calls
+    LVal *lformals = lfun->lformals;
+    int complete = argc == lformals->child_count;
+    for (int i = 0; complete && i < argc; i++) {
+        complete = strcmp(lformals->children[i]->sym, "&") != 0;
+    }
+    if (!complete) {
+        return lval_call(lenv, lfun, lval_wrap_argv(argc, argv));
+    }
+    if (argc > 0 && lfun->lenv->child_count == 0) {
+        return lval_call_frame(lenv, lfun, argc, argv);
+    }
+
+    for (int i = 0; i < argc; i++) {
+        lenv_put(lfun->lenv, lformals->children[i], argv[i]);
+        lval_del(argv[i]);
+    }
+    lfun->lenv->parent = lenv;
+    LVal *lbody = lfun->lfolded ? lfun->lfolded : lfun->lbody;
+    return lval_eval_body(lfun->lenv, lbody);
+}
+
+LVal *lval_call_frame(LEnv *lenv, LVal *lfun, int argc, LVal **argv) {
+    LStack *lstack = lstack_self();
+    LEnv *frame = lenv_frame(lstack, lfun->lformals, argc, argv);
+    frame->parent = lenv;
+
+    LVal *lbody = lfun->lfolded ? lfun->lfolded : lfun->lbody;
+    LVal *result = lval_eval_body(frame, lbody);
+    lenv_frame_del(lstack, frame);
+    return result;
+}
+
+LVal *lbuiltinv_call(LEnv *lenv, LBuiltinV lbuiltinv, LVal *largs) {
+    LVal *result = lbuiltinv(lenv, largs->child_count, largs->children);
+    largs->child_count = 0;
+    lval_del(largs);
+    return result;
+}
+
+int lval_eq(LVal *first, LVal *second) {
+    LWork work;
+    lwork_init(&work);
+    int eq = lval_eq_node(first, second, &work);
+    while (eq && work.len) {
+        LVal *next = lwork_pop(&work);
+        eq = lval_eq_node(lwork_pop(&work), next, &work);
+    }
+    lwork_free(&work);
+    return eq;
+}
+
+int lval_eq_node(LVal *first, LVal *second, LWork *work) {
+    if (first->type != second->type) {
+        return 0;
+    }
+
+    int type = first->type;
+
+    switch (type) {
+        case LVAL_NUM:
+            return (first->num == second->num);
+        case LVAL_BIG:
+            return lbig_cmp(first->lbig, second->lbig) == 0;
+        case LVAL_ERR:
+            if (first->errcode != second->errcode) {
+                return 0;
+            }
+            if (first->err || second->err) {
+                return first->err && second->err &&
+                       (strcmp(first->err, second->err) == 0);
+            }
+            return (first->errfn == second->errfn ||
+                    (first->errfn && second->errfn &&
+                     strcmp(first->errfn, second->errfn) == 0)) &&
+                   memcmp(first->errargs, second->errargs,
+                          sizeof(first->errargs)) == 0;
+        case LVAL_SYM:
+            return first->len == second->len &&
+                   memcmp(first->sym, second->sym, first->len) == 0;
+        case LVAL_STR:
+            // Different lengths are rejected without touching the bytes
+            return first->len == second->len &&
+                   (first->str == second->str ||
+                    memcmp(first->str, second->str, first->len) == 0);
+        case LVAL_MAP:
+            return lmap_eq(first->lmap, second->lmap);
+        case LVAL_FUTURE:
+            return first->ltask == second->ltask;
+        case LVAL_TRANSIENT:
+            return first->ltransient == second->ltransient;
+        case LVAL_SEQ:
+            // Equal only if they are evidently the same sequence
+            if (first->lseq == second->lseq) {
+                return 1;
+            }
+            if (first->lseq->kind != second->lseq->kind) {
+                return 0;
+            }
+            if (first->lseq->kind == LSEQ_RANGE) {
+                return first->lseq->start == second->lseq->start &&
+                       first->lseq->stop == second->lseq->stop &&
+                       first->lseq->step == second->lseq->step;
+            }
+            if (first->lseq->kind == LSEQ_REPEAT) {
+                lwork_push(work, first->lseq->cur);
+                lwork_push(work, second->lseq->cur);
+                return first->lseq->count == second->lseq->count;
+            }
+            return 0;
+        case LVAL_FUN:
+            if (first->lbuiltin || second->lbuiltin) {
+                return (first->lbuiltin == second->lbuiltin);
             }
+            lwork_push(work, first->lbody);
+            lwork_push(work, second->lbody);
+            lwork_push(work, first->lformals);
+            lwork_push(work, second->lformals);
+            return 1;
         case LVAL_QEXPR:
         case LVAL_SEXPR:
             if (first->child_count != second->child_count) {
                 return 0;
             }
-            for (int i = 0; i < first->child_count; i++) {
-                if (!lval_eq(first->children[i], second->children[i])) {
-                    return 0;
-                }
+            // Pushed last to first, so children are compared in order
+            for (int i = first->child_count - 1; i >= 0; i--) {
+                lwork_push(work, first->children[i]);
+                lwork_push(work, second->children[i]);
             }
             return 1;
         default:
@@ -822,17 +2337,86 @@ int lval_eq(LVal *first, LVal *second) {
 /* Functions to operate on LEnv's */
 ///////////////////////////////////////////////////////////////////////////////
 
+// Source of LEnv versions, unique across all LEnv's so a LICache can never
+// match a different LEnv allocated at the same address, and of stamps
+unsigned long lenv_version_clock = 0;
+
+// Bindings of a folded builtin's name to anything but the builtin, summed
+// over all LEnv's. Folded constants are only valid while this is 0.
+long lenv_fold_shadows = 0;
+
+int lenv_frozen = 0;
+
 LEnv *lenv_new(void) {
     LEnv *lenv = malloc(sizeof(LEnv));
     lenv->parent = NULL;
     lenv->lvals = NULL;
     lenv->syms = NULL;
     lenv->child_count = 0;
+    lenv->version = LATOMIC_ADD(lenv_version_clock, 1);
+    lenv->stamp = lenv->version;
+    lenv->stamps = NULL;
+    lenv->shadows = 0;
+    lenv->frame = 0;
+
+    return lenv;
+}
+
+// Bytes of a frame on the LStack binding `count` formals
+static size_t lenv_frame_size(int count) {
+    return sizeof(LEnv) + (sizeof(char *) + sizeof(LVal *)) * (size_t)count;
+}
+
+LEnv *lenv_frame(LStack *lstack, LVal *lformals, int argc, LVal **argv) {
+    LEnv *lenv = lstack_push(lstack, lenv_frame_size(argc));
+    lenv->parent = NULL;
+    lenv->syms = (char **)(lenv + 1);
+    lenv->lvals = (LVal **)(lenv->syms + argc);
+    lenv->child_count = argc;
+    lenv->version = LATOMIC_ADD(lenv_version_clock, 1);
+    lenv->stamp = lenv->version;
+    lenv->stamps = NULL;
+    lenv->shadows = 0;
+    lenv->frame = argc;
+
+    // Later formals are found first, as lenv_put would have let them replace
+    // earlier ones of the same name
+    for (int i = 0; i < argc; i++) {
+        char *sym = lformals->children[i]->sym;
+        lenv->syms[argc - 1 - i] = sym;
+        lenv->lvals[argc - 1 - i] = argv[i];
+        lenv->shadows += lenv_shadows(sym, argv[i]);
+    }
+    if (lenv->shadows) {
+        LATOMIC_ADD(lenv_fold_shadows, lenv->shadows);
+    }
 
     return lenv;
 }
 
+void lenv_frame_del(LStack *lstack, LEnv *lenv) {
+    if (lenv->shadows) {
+        LATOMIC_ADD(lenv_fold_shadows, -lenv->shadows);
+    }
+
+    int grown = lenv->child_count > lenv->frame;
+    for (int i = 0; i < lenv->child_count; i++) {
+        if (grown) {
+            free(lenv->syms[i]);
+        }
+        lval_del(lenv->lvals[i]);
+    }
+    if (grown) {
+        free(lenv->lvals);
+        free(lenv->syms);
+    }
+
+    lstack_pop(lstack, lenv_frame_size(lenv->frame));
+}
+
 void lenv_del(LEnv *lenv) {
+    LATOMIC_ADD(lenv_fold_shadows, -lenv->shadows);
+
     for (int i = 0; i < lenv->child_count; i++) {
         free(lenv->syms[i]);
         lval_del(lenv->lvals[i]);
@@ -840,38 +2424,149 @@ void lenv_del(LEnv *lenv) {
 
     free(lenv->lvals);
     free(lenv->syms);
+    free(lenv->stamps);
     free(lenv);
 }
 
-LVal *lenv_get(LEnv *hay, LVal *pin) {
-    // Check in local environment
-    for (int i = 0; i < hay->child_count; i++) {
+LVal *lenv_get_local(LEnv *lenv, const char *sym) {
+    for (int i = 0; i < lenv->child_count; i++) {
+        if (strcmp(lenv->syms[i], sym) == 0) {
+            return lenv->lvals[i];
+        }
+    }
+    return NULL;
+}
+
+LVal *lenv_find(LEnv *hay, LVal *pin, int *local) {
+    // Check in local environments, moving up through their parents
+    while (hay->parent) {
+        for (int i = 0; i < hay->child_count; i++) {
+            if (strcmp(hay->syms[i], pin->sym) == 0) {
+                *local = 1;
+                return hay->lvals[i];
+            }
+        }
+        hay = hay->parent;
+    }
+    *local = 0;
+
+    // `hay` is now the global environment, try the symbol's cache first.
+    // Tasks fill caches concurrently, with the same values as the global
+    // environment is read only meanwhile and indices never change, so only
+    // `lenv` has to be published last
+    // Builtins are cached at negative indices, -1 being lbuiltins[0]
+    LICache *icache = pin->icache;
+    if (icache && __atomic_load_n(&icache->lenv, __ATOMIC_ACQUIRE) == hay &&
+        __atomic_load_n(&icache->version, __ATOMIC_RELAXED) == hay->version) {
+        int index = __atomic_load_n(&icache->index, __ATOMIC_RELAXED);
+        return index >= 0 ? hay->lvals[index] : &lbuiltins[-1 - index].lval;
+    }
+
+    int index = -1;
+    for (int i = 0; i < hay->child_count && index < 0; i++) {
         if (strcmp(hay->syms[i], pin->sym) == 0) {
-            return lval_copy(hay->lvals[i]);
+            index = i;
         }
     }
+    if (index < 0) {
+        int builtin = lbuiltin_index(pin->sym);
+        if (builtin < 0) {
+            return NULL;
+        }
+        index = -1 - builtin;
+    }
+
+    if (icache) {
+        __atomic_store_n(&icache->index, index, __ATOMIC_RELAXED);
+        __atomic_store_n(&icache->version, hay->version, __ATOMIC_RELAXED);
+        __atomic_store_n(&icache->lenv, hay, __ATOMIC_RELEASE);
+    }
+    return index >= 0 ? hay->lvals[index] : &lbuiltins[-1 - index].lval;
+}
+
+LVal *lenv_get(LEnv *hay, LVal *pin) {
+    int local;
+    LVal *lval = lenv_find(hay, pin, &local);
+    return lval ? lval_copy(lval) : lval_wrap_err_str(LERR_UNBOUND, pin->sym);
+}
 
-    // If not found, check in its parent environment
-    if (hay->parent) {
-        return lenv_get(hay->parent, pin);
+LVal *lenv_get_global(LEnv *root, const char *sym) {
+    int index = lenv_index(root, sym);
+    if (index >= 0) {
+        return root->lvals[index];
     }
+    index = lbuiltin_index(sym);
+    return index >= 0 ? &lbuiltins[index].lval : NULL;
+}
 
-    return lval_wrap_err("Unbound symbol: '%s'", pin->sym);
+int lenv_index(LEnv *lenv, const char *sym) {
+    for (int i = 0; i < lenv->child_count; i++) {
+        if (strcmp(lenv->syms[i], sym) == 0) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 void lenv_put(LEnv *lenv, LVal *lsym, LVal *lval) {
+    // Only this binding changes, a LICache keeps its index
+    unsigned long stamp = LATOMIC_ADD(lenv_version_clock, 1);
+    lenv->stamp = stamp;
+
     for (int i = 0; i < lenv->child_count; i++) {
         // Check if symbol already exists
         if (strcmp(lenv->syms[i], lsym->sym) == 0) {
-            // If exists, delete it
-            lval_del(lenv->lvals[i]);
+            if (lenv->stamps) {
+                lenv->stamps[i] = stamp;
+            }
+
+            // A number replacing a number is stored in place, the LVal is
+            // the LEnv's own (@see lenv_get). Both shadow a builtin of the
+            // name alike, so the count of shadows is unchanged
+            LVal *lbound = lenv->lvals[i];
+            if (lbound->type == LVAL_NUM && !lbound->flags &&
+                lval->type == LVAL_NUM) {
+                lbound->num = lval->num;
+                return;
+            }
+
+            int shadows = lenv_shadows(lsym->sym, lval) -
+                          lenv_shadows(lsym->sym, lenv->lvals[i]);
+            lenv->shadows += shadows;
+            LATOMIC_ADD(lenv_fold_shadows, shadows);
+
+            // If exists, delete it, unless a call may have borrowed it (@see
+            // lval_eval_head)
+            LStack *lstack = lbound->type == LVAL_FUN ? lstack_self() : NULL;
+            if (lstack && lstack->borrows) {
+                lwork_push(&lstack->retired, lbound);
+            } else {
+                lval_del(lbound);
+            }
             // Copy the new value from LVal
             lenv->lvals[i] = lval_copy(lval);
             return;
         }
     }
 
-    // If symbol is not present
+    // If symbol is not present, every LICache pointing into this environment
+    // could have been for a builtin of the same name
+    lenv->version = stamp;
+
+    // A frame moves its bindings to the heap first, names were borrowed
+    if (lenv->frame && lenv->child_count == lenv->frame) {
+        size_t count = (size_t)lenv->frame;
+        char **syms = malloc(sizeof(char *) * count);
+        LVal **lvals = malloc(sizeof(LVal *) * count);
+        for (int i = 0; i < lenv->frame; i++) {
+            syms[i] = malloc(strlen(lenv->syms[i]) + 1);
+            strcpy(syms[i], lenv->syms[i]);
+            lvals[i] = lenv->lvals[i];
+        }
+        lenv->syms = syms;
+        lenv->lvals = lvals;
+    }
+
     // Increase child count
     lenv->child_count += 1;
 
@@ -884,16 +2579,34 @@ void lenv_put(LEnv *lenv, LVal *lsym, LVal *lval) {
     strcpy(lenv->syms[lenv->child_count - 1], lsym->sym);
 
     lenv->lvals[lenv->child_count - 1] = lval_copy(lval);
+
+    if (!lenv->frame) {
+        lenv->stamps = realloc(lenv->stamps,
+                               sizeof(unsigned long) * lenv->child_count);
+        lenv->stamps[lenv->child_count - 1] = stamp;
+    }
+
+    if (lenv_shadows(lsym->sym, lval)) {
+        lenv->shadows += 1;
+        LATOMIC_ADD(lenv_fold_shadows, 1);
+    }
 }
 
 LEnv *lenv_copy(LEnv *lenv) {
     LEnv *copy = malloc(sizeof(LEnv));
     copy->parent = lenv->parent;
     copy->child_count = lenv->child_count;
-    copy->lvals = malloc(sizeof(LVal) * copy->child_count);
+    copy->version = LATOMIC_ADD(lenv_version_clock, 1);
+    copy->stamp = copy->version;
+    copy->shadows = lenv->shadows;
+    copy->frame = 0;
+    LATOMIC_ADD(lenv_fold_shadows, copy->shadows);
+    copy->lvals = malloc(sizeof(LVal *) * copy->child_count);
     copy->syms = malloc(sizeof(char *) * copy->child_count);
+    copy->stamps = malloc(sizeof(unsigned long) * copy->child_count);
 
     for (int i = 0; i < copy->child_count; i++) {
+        copy->stamps[i] = copy->version;
         copy->syms[i] = malloc(strlen(lenv->syms[i]) + 1);
         strcpy(copy->syms[i], lenv->syms[i]);
         copy->lvals[i] = lval_copy(lenv->lvals[i]);
@@ -908,6 +2621,21 @@ void lenv_put_global(LEnv *lenv, LVal *lsym, LVal *lval) {
     }
     lenv_put(lenv, lsym, lval);
 }
+
+LICache *licache_new(void) {
+    LICache *icache = malloc(sizeof(LICache));
+    icache->refs = 1;
+    icache->lenv = NULL;
+    icache->version = 0;
+    icache->index = 0;
+    return icache;
+}
+
+void licache_del(LICache *icache) {
+    if (icache && LATOMIC_ADD(icache->refs, -1) == 0) {
+        free(icache);
+    }
+}
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -915,32 +2643,56 @@ LVal *lval_read_long(mpc_ast_t *node) {
     errno = 0;
     long val = strtol(node->contents, NULL, 10);
     return errno != ERANGE ? lval_wrap_long(val)
-                           : lval_wrap_err("Number too large!");
+                           : lval_wrap_big(lbig_parse(node->contents));
 }
 
 LVal *lval_read_str(mpc_ast_t *node) {
-    // Chops of ending quote
-    node->contents[strlen(node->contents) - 1] = '\0';
-
-    // Copies string without starting quote
-    char *unescaped = malloc(strlen(node->contents + 1) + 1);
-    unescaped = strcpy(unescaped, node->contents + 1);
-
-    // Unescape string
-    unescaped = mpcf_unescape(unescaped);
-
-    LVal *lstr = lval_wrap_str(unescaped);
+    // Skip the quotes around the string
+    char *raw = node->contents + 1;
+    size_t raw_len = strlen(raw) - 1;
+
+    // Escapes understood after a backslash, and what they stand for
+    static const char escapes[] = "abfnrtv0\\'\"";
+    static const char unescaped[] = "\a\b\f\n\r\t\v\0\\'\"";
+
+    // Unescape in place, the result is never longer than the source
+    size_t len = 0;
+    for (size_t i = 0; i < raw_len; i++) {
+        const char *escape;
+        if (raw[i] == '\\' && i + 1 < raw_len && raw[i + 1] != '\0' &&
+            (escape = strchr(escapes, raw[i + 1]))) {
+            raw[len++] = unescaped[escape - escapes];
+            i++;
+        } else {
+            raw[len++] = raw[i];
+        }
+    }
 
-    free(unescaped);
-    return lstr;
+    return lval_wrap_strn(raw, len);
 }
 
 LVal *lval_read_ast(mpc_ast_t *node) {
+    // Pairs of a node and the expression its LVal is added to
+    LWork work;
+    lwork_init(&work);
+    LVal *root = lval_read_node(node, &work);
+    while (work.len) {
+        LVal *parent = lwork_pop(&work);
+        lval_add(parent, lval_read_node(lwork_pop(&work), &work));
+    }
+    lwork_free(&work);
+    return root;
+}
+
+LVal *lval_read_node(mpc_ast_t *node, LWork *work) {
     if (strstr(node->tag, "num")) {
         return lval_read_long(node);
     }
     if (strstr(node->tag, "sym")) {
-        return lval_wrap_sym(node->contents);
+        // Symbols read from source are looked up over and over again
+        LVal *lsym = lval_wrap_sym(node->contents);
+        lsym->icache = licache_new();
+        return lsym;
     }
 
     if (strstr(node->tag, "str")) {
@@ -954,7 +2706,8 @@ LVal *lval_read_ast(mpc_ast_t *node) {
         root = lval_wrap_qexpr();
     }
 
-    for (int i = 0; i < node->children_num; i++) {
+    // Pushed last to first, so children are added in order
+    for (int i = node->children_num - 1; i >= 0; i--) {
         if ((strcmp(node->children[i]->contents, "(") == 0) ||
             (strcmp(node->children[i]->contents, ")") == 0) ||
             (strcmp(node->children[i]->contents, "{") == 0) ||
@@ -963,7 +2716,8 @@ LVal *lval_read_ast(mpc_ast_t *node) {
             (strstr(node->children[i]->tag, "comment"))) {
             continue;
         } else {
-            root = lval_add(root, lval_read_ast(node->children[i]));
+            lwork_push(work, node->children[i]);
+            lwork_push(work, root);
         }
     }
     return root;
@@ -974,35 +2728,85 @@ LVal *lval_read_ast(mpc_ast_t *node) {
 ///////////////////////////////////////////////////////////////////////////////
 
 void lval_print(LVal *lval) {
+    LBuf lbuf;
+    lbuf_init_file(&lbuf, stdout);
+    lval_print_lbuf(&lbuf, lval);
+    lbuf_free(&lbuf);
+}
+
+// Text scheduled with a repeated LVAL_SEQ to print its count
+static const char lval_print_count[] = " <count>";
+
+void lval_print_lbuf(LBuf *lbuf, LVal *lval) {
+    LWork work;
+    lwork_init(&work);
+    lval_print_node(lbuf, &work, lval);
+    while (work.len) {
+        const char *text = lwork_pop(&work);
+        LVal *next = lwork_pop(&work);
+        if (!next) {
+            lbuf_puts(lbuf, text);
+        } else if (text == lval_print_count) {
+            lbuf_putc(lbuf, ' ');
+            lbuf_put_long(lbuf, next->lseq->count);
+        } else {
+            lval_print_node(lbuf, &work, next);
+        }
+    }
+    lwork_free(&work);
+}
+
+void lval_print_later(LWork *work, LVal *lval, const char *text) {
+    lwork_push(work, lval);
+    lwork_push(work, (void *)text);
+}
+
+void lval_print_node(LBuf *lbuf, LWork *work, LVal *lval) {
     switch (lval->type) {
         case LVAL_NUM:
-            printf("%ld", lval->num);
+            lbuf_put_long(lbuf, lval->num);
+            break;
+        case LVAL_BIG:
+            lbig_print(lbuf, lval->lbig);
             break;
         case LVAL_FUN:
             if (lval->lbuiltin) {
-                printf("<builtin>");
+                lbuf_puts(lbuf, "<builtin>");
             } else {
-                printf("(\\ ");
-                lval_print(lval->lformals);
-                printf(" ");
-                lval_print(lval->lbody);
-                printf(")");
+                lbuf_puts(lbuf, "(\\ ");
+                lval_print_later(work, NULL, ")");
+                lval_print_later(work, lval->lbody, NULL);
+                lval_print_later(work, NULL, " ");
+                lval_print_later(work, lval->lformals, NULL);
             }
             break;
         case LVAL_ERR:
-            printf("Error: %s", lval->err);
+            lbuf_puts(lbuf, "Error: ");
+            lval_print_err(lbuf, lval);
             break;
         case LVAL_SYM:
-            printf("%s", lval->sym);
+            lbuf_putn(lbuf, lval->sym, lval->len);
             break;
         case LVAL_STR:
-            lval_print_str(lval);
+            lval_print_str(lbuf, lval);
             break;
         case LVAL_SEXPR:
-            lval_print_sexpr(lval);
+            lval_print_sexpr(lbuf, work, lval);
             break;
         case LVAL_QEXPR:
-            lval_print_qexpr(lval);
+            lval_print_qexpr(lbuf, work, lval);
+            break;
+        case LVAL_MAP:
+            lval_print_map(lbuf, work, lval);
+            break;
+        case LVAL_SEQ:
+            lval_print_seq(lbuf, work, lval);
+            break;
+        case LVAL_FUTURE:
+            lbuf_puts(lbuf, "<future>");
+            break;
+        case LVAL_TRANSIENT:
+            lval_print_transient(lbuf, work, lval);
             break;
         default:
             break;
@@ -1010,38 +2814,291 @@ void lval_print(LVal *lval) {
 }
 
 void lval_println(LVal *lval) {
-    lval_print(lval);
-    printf("\n");
+    LBuf lbuf;
+    lbuf_init_file(&lbuf, stdout);
+    lval_print_lbuf(&lbuf, lval);
+    lbuf_putc(&lbuf, '\n');
+    lbuf_free(&lbuf);
 }
 
-void lval_print_expr(LVal *lval, char open, char close) {
-    printf("%c", open);
-    for (int i = 0; i < lval->child_count; i++) {
-        lval_print(lval->children[i]);
-
-        if (i != (lval->child_count - 1)) {
-            printf(" ");
+void lval_print_expr(LBuf *lbuf, LWork *work, LVal *lval, const char *open,
+                     const char *close) {
+    lbuf_puts(lbuf, open);
+    lval_print_later(work, NULL, close);
+    for (int i = lval->child_count - 1; i >= 0; i--) {
+        lval_print_later(work, lval->children[i], NULL);
+        if (i > 0) {
+            lval_print_later(work, NULL, " ");
         }
     }
-    printf("%c", close);
 }
 
-void lval_print_sexpr(LVal *lval) { lval_print_expr(lval, '(', ')'); }
+void lval_print_sexpr(LBuf *lbuf, LWork *work, LVal *lval) {
+    lval_print_expr(lbuf, work, lval, "(", ")");
+}
+
+void lval_print_qexpr(LBuf *lbuf, LWork *work, LVal *lval) {
+    lval_print_expr(lbuf, work, lval, "{", "}");
+}
+
+void lval_print_map(LBuf *lbuf, LWork *work, LVal *lmap) {
+    lbuf_puts(lbuf, "(dict");
+    lval_print_later(work, NULL, ")");
+    // Scheduled from the last entry, so entries print in the map's order
+    LMapEntry **entries = malloc(sizeof(LMapEntry *) * lmap->lmap->count);
+    LMapIter iter;
+    lmap_iter_init(&iter, lmap->lmap);
+    for (size_t i = 0; i < lmap->lmap->count; i++) {
+        entries[i] = lmap_iter_next(&iter);
+    }
+    for (size_t i = lmap->lmap->count; i-- > 0;) {
+        lval_print_later(work, entries[i]->val, NULL);
+        lval_print_later(work, NULL, " ");
+        lval_print_later(work, entries[i]->key, NULL);
+        lval_print_later(work, NULL, " ");
+    }
+    free(entries);
+}
+
+void lval_print_seq(LBuf *lbuf, LWork *work, LVal *lval) {
+    LSeq *lseq = lval->lseq;
+    switch (lseq->kind) {
+        case LSEQ_RANGE:
+            lbuf_puts(lbuf, "(range ");
+            lbuf_put_long(lbuf, lseq->start);
+            lbuf_putc(lbuf, ' ');
+            lbuf_put_long(lbuf, lseq->stop);
+            lbuf_putc(lbuf, ' ');
+            lbuf_put_long(lbuf, lseq->step);
+            lbuf_putc(lbuf, ')');
+            break;
+        case LSEQ_REPEAT:
+            lbuf_puts(lbuf, "(repeat ");
+            lval_print_later(work, NULL, ")");
+            if (lseq->count >= 0) {
+                lval_print_later(work, lval, lval_print_count);
+            }
+            lval_print_later(work, lseq->cur, NULL);
+            break;
+        case LSEQ_ITERATE:
+            lbuf_puts(lbuf, lseq->stale ? "(drop 1 (iterate " : "(iterate ");
+            lval_print_later(work, NULL, lseq->stale ? "))" : ")");
+            lval_print_later(work, lseq->cur, NULL);
+            lval_print_later(work, NULL, " ");
+            lval_print_later(work, lseq->fn, NULL);
+            break;
+        case LSEQ_GEN:
+            lbuf_puts(lbuf, "(gen ");
+            lval_print_later(work, NULL, ")");
+            lval_print_later(work, lseq->cur, NULL);
+            lval_print_later(work, NULL, " ");
+            lval_print_later(work, lseq->fn, NULL);
+            break;
+    }
+}
+
+void lval_print_transient(LBuf *lbuf, LWork *work, LVal *lval) {
+    LTransient *ltransient = lval->ltransient;
+    if (ltransient->frozen) {
+        lbuf_puts(lbuf, "<frozen transient>");
+        return;
+    }
+
+    lbuf_puts(lbuf, "(transient {");
+    lval_print_later(work, NULL, "})");
+    for (int i = ltransient->count - 1; i >= 0; i--) {
+        lval_print_later(work, ltransient->items[i], NULL);
+        if (i > 0) {
+            lval_print_later(work, NULL, " ");
+        }
+    }
+}
 
-void lval_print_qexpr(LVal *lval) { lval_print_expr(lval, '{', '}'); }
+void lval_print_str(LBuf *lbuf, LVal *lstr) {
+    lbuf_putc(lbuf, '"');
+    lbuf_put_escaped(lbuf, lstr->str, lstr->len);
+    lbuf_putc(lbuf, '"');
+}
 
-void lval_print_str(LVal *lstr) {
-    char *escaped = malloc(strlen(lstr->str) + 1);
-    strcpy(escaped, lstr->str);
-    escaped = mpcf_escape(escaped);
-    printf("\"%s\"", escaped);
-    free(escaped);
+void lval_print_err(LBuf *lbuf, LVal *lerr) {
+    long *args = lerr->errargs;
+    switch (lerr->errcode) {
+        case LERR_ARG_COUNT:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was passed incorrect number of arguments\nGot ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, ", expected ");
+            lbuf_put_long(lbuf, args[1]);
+            break;
+        case LERR_ARG_TYPE:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf,
+                      "' was passed incorrect type of argument for "
+                      "argument: ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, "\nGot '");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            lbuf_puts(lbuf, "' expected '");
+            lbuf_puts(lbuf, lval_print_type(args[2]));
+            lbuf_putc(lbuf, '\'');
+            break;
+        case LERR_ARG_EMPTY:
+            lbuf_puts(lbuf, "Functions '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was passed {} for argument at index ");
+            lbuf_put_long(lbuf, args[0]);
+            break;
+        case LERR_UNBOUND:
+            lbuf_puts(lbuf, "Unbound symbol: '");
+            lbuf_puts(lbuf, lerr->err);
+            lbuf_putc(lbuf, '\'');
+            break;
+        case LERR_DIV_ZERO:
+            lbuf_puts(lbuf, "Cannot divide by zero!");
+            break;
+        case LERR_BAD_SEXPR:
+            lbuf_puts(lbuf, "S-Expression starts with incorrect type!\nGot ");
+            lbuf_puts(lbuf, lval_print_type(args[0]));
+            lbuf_puts(lbuf, ", Expected ");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            break;
+        case LERR_TOO_MANY_ARGS:
+            lbuf_puts(lbuf, "Function was passed too many arguments!\nGot ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, ", Expected ");
+            lbuf_put_long(lbuf, args[1]);
+            break;
+        case LERR_BAD_VARIADIC:
+            lbuf_puts(lbuf,
+                      "Function format invalid!\n"
+                      "'&' not followed by a single symbol!");
+            break;
+        case LERR_BAD_FORMALS:
+            lbuf_puts(lbuf, "Formals can only contain symbols!\nGot ");
+            lbuf_puts(lbuf, lval_print_type(args[0]));
+            lbuf_puts(lbuf, ", Expected ");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            break;
+        case LERR_NUM_RANGE:
+            lbuf_puts(lbuf, "Number too large!");
+            break;
+        case LERR_LOAD:
+            lbuf_puts(lbuf, "Could not load file: ");
+            lbuf_puts(lbuf, lerr->err);
+            break;
+        case LERR_BAD_KEY:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was passed a key of incorrect type at index ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, "\nGot '");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            lbuf_puts(lbuf, "' expected a Number, String or Symbol");
+            break;
+        case LERR_NO_KEY:
+            lbuf_puts(lbuf, "Key not found: ");
+            lbuf_puts(lbuf, lerr->err);
+            break;
+        case LERR_BAD_GEN:
+            lbuf_puts(lbuf,
+                      "Generator must return {} or {element state}\nGot '");
+            lbuf_puts(lbuf, lval_print_type(args[0]));
+            lbuf_putc(lbuf, '\'');
+            if (args[0] == LVAL_QEXPR) {
+                lbuf_puts(lbuf, " of ");
+                lbuf_put_long(lbuf, args[1]);
+                lbuf_puts(lbuf, " elements");
+            }
+            break;
+        case LERR_OPEN:
+            lbuf_puts(lbuf, "Could not open file: ");
+            lbuf_puts(lbuf, lerr->err);
+            break;
+        case LERR_BAD_DELIM:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf,
+                      "' expects a delimiter of a single character\nGot ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, " characters");
+            break;
+        case LERR_FROZEN:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' can't bind globals inside a task or request");
+            break;
+        case LERR_BAD_INDEX:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was passed index ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, " out of ");
+            lbuf_put_long(lbuf, args[1]);
+            lbuf_puts(lbuf, " elements");
+            break;
+        case LERR_THAWED:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was passed a transient which was frozen");
+            break;
+        case LERR_BAD_DUMP:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            if (strcmp(lerr->errfn, "dump") == 0) {
+                lbuf_puts(lbuf, "' was passed a value which can't be dumped");
+            } else {
+                lbuf_puts(lbuf,
+                          "' was passed a file which isn't a dump of this "
+                          "version");
+            }
+            break;
+        case LERR_BAD_ARG:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' can't take ");
+            lbuf_put_long(lbuf, args[1]);
+            lbuf_puts(lbuf, " for argument: ");
+            lbuf_put_long(lbuf, args[0]);
+            break;
+        case LERR_BAD_RESULT:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf, "' was returned '");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            lbuf_puts(lbuf, "' for the element at index ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, "\nExpected '");
+            lbuf_puts(lbuf, lval_print_type(args[2]));
+            lbuf_putc(lbuf, '\'');
+            break;
+        case LERR_BAD_ELEM:
+            lbuf_puts(lbuf, "Function '");
+            lbuf_puts(lbuf, lerr->errfn);
+            lbuf_puts(lbuf,
+                      "' was passed a list with an element of incorrect "
+                      "type at index ");
+            lbuf_put_long(lbuf, args[0]);
+            lbuf_puts(lbuf, "\nGot '");
+            lbuf_puts(lbuf, lval_print_type(args[1]));
+            lbuf_puts(lbuf, "' expected '");
+            lbuf_puts(lbuf, lval_print_type(args[2]));
+            lbuf_putc(lbuf, '\'');
+            break;
+        case LERR_CUSTOM:
+        default:
+            lbuf_puts(lbuf, lerr->err ? lerr->err : "Unknown error");
+            break;
+    }
 }
 
 char *lval_print_type(int type) {
     switch (type) {
         case LVAL_NUM:
             return "Number";
+        case LVAL_BIG:
+            return "Big Number";
         case LVAL_FUN:
             return "Function";
         case LVAL_SYM:
@@ -1054,6 +3111,14 @@ char *lval_print_type(int type) {
             return "Quoted Expression";
         case LVAL_SEXPR:
             return "Symbolic Expression";
+        case LVAL_MAP:
+            return "Dictionary";
+        case LVAL_SEQ:
+            return "Sequence";
+        case LVAL_FUTURE:
+            return "Future";
+        case LVAL_TRANSIENT:
+            return "Transient";
         default:
             return "Unknown type";
     }
@@ -1064,53 +3129,98 @@ char *lval_print_type(int type) {
 ///////////////////////////////////////////////////////////////////////////////
 
 LVal *lval_eval_sexpr(LEnv *lenv, LVal *lval) {
-    // Start evaluation from the inner-most child
-    for (int i = 0; i < lval->child_count; i++) {
-        lval->children[i] = lval_eval(lenv, lval->children[i]);
-    }
-
-    // If there is an error return error, discard LVal
-    for (int i = 0; i < lval->child_count; i++) {
-        if (lval->children[i]->type == LVAL_ERR) {
-            return lval_take(lval, i);
-        }
-    }
-
     // If no child return the LVal
-    if (lval->child_count == 0) {
+    int count = lval->child_count;
+    if (count == 0) {
         return lval;
     }
 
-    // For a single child pop child, delete LVal, return child
-    if (lval->child_count == 1) {
-        return lval_take(lval, 0);
+    // Start evaluation from the inner-most child, each into its slot on the
+    // LStack, which stays put while the children push their own arguments
+    LStack *lstack = lstack_self();
+    LVal **slots = lstack_push(lstack, sizeof(LVal *) * (size_t)count);
+    LVal *lhead = lval->children[0];
+    int borrowed = 0;
+    if (count > 1 && lval_is_head(lhead)) {
+        borrowed = lval_eval_head(lenv, lhead, slots);
+        lval_del(lhead);
+    } else {
+        slots[0] = lval_eval(lenv, lhead);
     }
+    for (int i = 1; i < count; i++) {
+        slots[i] = lval_eval(lenv, lval->children[i]);
+    }
+    lval->child_count = 0;
+    lval_del(lval);
+    return lval_eval_slots(lenv, lstack, count, slots, borrowed);
+}
 
-    // Get the first child
-    LVal *lfun = lval_pop(lval, 0);
+int lval_is_head(LVal *lhead) {
+    return lhead->type == LVAL_SYM && !(lhead->flags & LFLAG_FOLDED);
+}
 
-    // Raise error if first child is not a function
-    // Also free first child and `lval`
-    if (lfun->type != LVAL_FUN) {
-        LVal *lerr = lval_wrap_err(
-            "S-Expression starts with incorrect type!\n"
-            "Got %s, Expected %s",
-            lval_print_type(lfun->type), lval_print_type(LVAL_FUN));
-        lval_del(lfun);
-        lval_del(lval);
-        return lerr;
+int lval_eval_head(LEnv *lenv, LVal *lhead, LVal **slot) {
+    int local;
+    LVal *lval = lenv_find(lenv, lhead, &local);
+    if (lval && !local && lval->type == LVAL_FUN) {
+        *slot = lval;
+        return 1;
     }
+    *slot = lval ? lval_copy(lval)
+                 : lval_wrap_err_str(LERR_UNBOUND, lhead->sym);
+    return 0;
+}
 
-    // Invoke function
-    LVal *result = lval_call(lenv, lfun, lval);
+LVal *lval_eval_slots(LEnv *lenv, LStack *lstack, int count, LVal **slots,
+                      int borrowed) {
+    int error = -1;
+    for (int i = 0; i < count && error < 0; i++) {
+        if (slots[i]->type == LVAL_ERR) {
+            error = i;
+        }
+    }
 
-    // Delete the first child
-    lval_del(lfun);
+    LVal *result;
+    if (error >= 0) {
+        // If there is an error return error, discard the rest but a borrowed
+        // function
+        result = slots[error];
+        slots[error] = slots[count - 1];
+        lval_del_argv(count - 1 - borrowed, slots + borrowed);
+    } else if (count == 1) {
+        // For a single child return the child
+        result = slots[0];
+    } else if (slots[0]->type != LVAL_FUN) {
+        // Raise error if first child is not a function
+        result =
+            lval_wrap_err(LERR_BAD_SEXPR, NULL, slots[0]->type, LVAL_FUN, 0);
+        lval_del_argv(count, slots);
+    } else if (borrowed) {
+        // A borrowed function is left as it is, and if rebound meanwhile it is
+        // only freed once no borrowed function is being called (@see
+        // lenv_put)
+        lstack->borrows++;
+        result = lval_apply_argv(lenv, slots[0], count - 1, slots + 1);
+        if (--lstack->borrows == 0) {
+            while (lstack->retired.len) {
+                lval_del(lwork_pop(&lstack->retired));
+            }
+        }
+    } else {
+        // Invoke function with the rest in place, then delete it
+        result = lval_call_argv(lenv, slots[0], count - 1, slots + 1);
+        lval_del(slots[0]);
+    }
 
+    lstack_pop(lstack, sizeof(LVal *) * (size_t)count);
     return result;
 }
 
 LVal *lval_eval(LEnv *lenv, LVal *lval) {
+    if (lval->flags & LFLAG_FOLDED) {
+        return lval_eval_folded(lenv, lval);
+    }
+
     // If a symbol get value from LEnv
     if (lval->type == LVAL_SYM) {
         LVal *lsym = lenv_get(lenv, lval);
@@ -1125,330 +3235,1664 @@ LVal *lval_eval(LEnv *lenv, LVal *lval) {
     return lval;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-/* Language built-in(LEnv) functions for operation on different LVal types */
-///////////////////////////////////////////////////////////////////////////////
-
-LVal *builtin_list(LEnv *lenv, LVal *lval) {
-    (void)lenv;
-    lval->type = LVAL_QEXPR;
-    return lval;
-}
+LVal *lval_eval_borrowed(LEnv *lenv, LVal *lval) {
+    if (lval->flags & LFLAG_FOLDED) {
+        return lval_eval_folded(lenv, lval_copy(lval));
+    }
 
-LVal *builtin_head(LEnv *lenv, LVal *lval) {
-    (void)lenv;
-    // Assert head is passed a single argument
-    // i.e head has a single child
-    LASSERT_CHILD_COUNT("head", lval, 1);
+    if (lval->type == LVAL_SYM) {
+        return lenv_get(lenv, lval);
+    }
 
-    // Assert head's first child is a QEXPR
-    LASSERT_CHILD_TYPE("head", lval, 0, LVAL_QEXPR);
+    if (lval->type != LVAL_SEXPR || lval->child_count == 0) {
+        return lval_copy(lval);
+    }
+    return lval_eval_body(lenv, lval);
+}
 
-    // Assert QEXPR passed to head was not empty
-    LASSERT_CHILD_NOT_EMPTY("head", lval, 0);
+LVal *lval_eval_body(LEnv *lenv, LVal *lbody) {
+    int count = lbody->child_count;
+    if (count == 0) {
+        return lval_wrap_sexpr();
+    }
 
-    // Get first child i.lenv first argument of head
+    LStack *lstack = lstack_self();
+    LVal **slots = lstack_push(lstack, sizeof(LVal *) * (size_t)count);
+    LVal *lhead = lbody->children[0];
+    int borrowed = 0;
+    if (count > 1 && lval_is_head(lhead)) {
+        borrowed = lval_eval_head(lenv, lhead, slots);
+    } else {
+        slots[0] = lval_eval_borrowed(lenv, lhead);
+    }
+    for (int i = 1; i < count; i++) {
+        slots[i] = lval_eval_borrowed(lenv, lbody->children[i]);
+    }
+    return lval_eval_slots(lenv, lstack, count, slots, borrowed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Functions to fold constants */
+///////////////////////////////////////////////////////////////////////////////
+
+// Index in lbuiltins of a builtin whose calls are folded, or -1
+int lval_fold_index(char *sym) {
+    int index = lbuiltin_index(sym);
+    return index >= 0 && lbuiltins[index].fold != LFOLD_NONE ? index : -1;
+}
+
+int lenv_shadows(char *sym, LVal *lval) {
+    int index = lval_fold_index(sym);
+    return index >= 0 &&
+           !(lval->type == LVAL_FUN &&
+             lval->lbuiltin == lbuiltins[index].lval.lbuiltin);
+}
+
+// Index in lbuiltins of the folded head of a S-Expression or -1
+int lval_fold_head(LVal *lval, LVal *lformals) {
+    LVal *lhead = lval->children[0];
+    if (lhead->type != LVAL_SYM) {
+        return -1;
+    }
+
+    // Formals named after a builtin would shadow it on every call
+    for (int i = 0; lformals && i < lformals->child_count; i++) {
+        if (strcmp(lformals->children[i]->sym, lhead->sym) == 0) {
+            return -1;
+        }
+    }
+
+    return lval_fold_index(lhead->sym);
+}
+
+LFold *lfold_new(LVal *src) {
+    LFold *lfold = malloc(sizeof(LFold));
+    lfold->refs = 1;
+    lfold->src = src;
+    return lfold;
+}
+
+void lfold_del(LFold *lfold) {
+    if (LATOMIC_ADD(lfold->refs, -1) == 0) {
+        lval_del(lfold->src);
+        free(lfold);
+    }
+}
+
+// Turn a folded constant into an ordinary value
+LVal *lval_unflag(LVal *lval) {
+    if (lval->flags & LFLAG_FOLDED) {
+        lfold_del(lval->lfold);
+        lval->flags &= ~LFLAG_FOLDED;
+    }
+    return lval;
+}
+
+LVal *lval_fold(LVal *lval, LVal *lformals, int *changed) {
+    if (lval->type != LVAL_SEXPR || lval->child_count == 0) {
+        return lval;
+    }
+
+    // Fold inner-most expressions first
+    for (int i = 0; i < lval->child_count; i++) {
+        lval->children[i] = lval_fold(lval->children[i], lformals, changed);
+    }
+
+    int index = lval_fold_head(lval, lformals);
+    if (index < 0) {
+        return lval;
+    }
+
+    // Fold branches of an if, which are only data to any other function
+    // hence the folded branch also falls back to the original one
+    if (lbuiltins[index].fold == LFOLD_BRANCH) {
+        for (int i = 2; lval->child_count == 4 && i < 4; i++) {
+            LVal *branch = lval->children[i];
+            if (branch->type != LVAL_QEXPR || (branch->flags & LFLAG_FOLDED)) {
+                continue;
+            }
+
+            LVal *folded = lval_fold_body(branch, lformals);
+            if (folded) {
+                folded->flags |= LFLAG_FOLDED;
+                folded->lfold = lfold_new(branch);
+                lval->children[i] = folded;
+                *changed = 1;
+            }
+        }
+        return lval;
+    }
+
+    if (lval->child_count < 2) {
+        return lval;
+    }
+
+    // Only calls with literals for all arguments are folded
+    LVal *largs = lval_wrap_sexpr();
+    for (int i = 1; i < lval->child_count; i++) {
+        LVal *larg = lval->children[i];
+        if (larg->type != LVAL_NUM && larg->type != LVAL_BIG &&
+            larg->type != LVAL_STR && larg->type != LVAL_QEXPR) {
+            lval_del(largs);
+            return lval;
+        }
+        lval_add(largs, lval_unflag(lval_copy(larg)));
+    }
+
+    // Pure builtins don't use their LEnv
+    LVal *result = lbuiltins[index].lval.lbuiltin(NULL, largs);
+
+    // Errors are left to be raised at runtime
+    if (result->type == LVAL_ERR) {
+        lval_del(result);
+        return lval;
+    }
+
+    result->flags |= LFLAG_FOLDED;
+    result->lfold = lfold_new(lval);
+    *changed = 1;
+    return result;
+}
+
+LVal *lval_fold_body(LVal *lbody, LVal *lformals) {
+    int changed = 0;
+
+    LVal *folded = lval_copy(lbody);
+    folded->type = LVAL_SEXPR;
+    folded = lval_fold(folded, lformals, &changed);
+
+    if (!changed) {
+        lval_del(folded);
+        return NULL;
+    }
+
+    // Either still an expression or folded to a single constant
+    if (folded->type == LVAL_SEXPR) {
+        folded->type = LVAL_QEXPR;
+    } else {
+        folded = lval_add(lval_wrap_qexpr(), folded);
+    }
+    return folded;
+}
+
+LVal *lval_eval_folded(LEnv *lenv, LVal *lval) {
+    if (LATOMIC_GET(lenv_fold_shadows) == 0) {
+        return lval_unflag(lval);
+    }
+
+    // A folded builtin was rebound since, evaluate the original expression
+    LVal *src = lval_copy(lval->lfold->src);
+    lval_del(lval);
+    return lval_eval(lenv, src);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Functions to operate on lazy sequences */
+///////////////////////////////////////////////////////////////////////////////
+
+LSeq *lseq_new(int kind) {
+    LSeq *lseq = malloc(sizeof(LSeq));
+    lseq->refs = 1;
+    lseq->kind = kind;
+    lseq->start = 0;
+    lseq->stop = 0;
+    lseq->step = 0;
+    lseq->count = 0;
+    lseq->cur = NULL;
+    lseq->fn = NULL;
+    lseq->stale = 0;
+    lseq->forced = NULL;
+    return lseq;
+}
+
+void lseq_del(LSeq *lseq) {
+    if (LATOMIC_ADD(lseq->refs, -1) > 0) {
+        return;
+    }
+
+    if (lseq->cur) {
+        lval_del(lseq->cur);
+    }
+    if (lseq->fn) {
+        lval_del(lseq->fn);
+    }
+    if (lseq->forced) {
+        lval_del(lseq->forced);
+    }
+    free(lseq);
+}
+
+LSeq *lseq_own(LSeq *lseq) {
+    if (LATOMIC_GET(lseq->refs) == 1) {
+        return lseq;
+    }
+
+    LSeq *clone = malloc(sizeof(LSeq));
+    *clone = *lseq;
+    clone->refs = 1;
+    clone->cur = lseq->cur ? lval_copy(lseq->cur) : NULL;
+    clone->fn = lseq->fn ? lval_copy(lseq->fn) : NULL;
+    clone->forced = lseq->forced ? lval_copy(lseq->forced) : NULL;
+
+    // The other references may have been dropped meanwhile
+    lseq_del(lseq);
+    return clone;
+}
+
+LVal *lseq_force(LEnv *lenv, LSeq *lseq) {
+    if (lseq->kind == LSEQ_ITERATE && lseq->stale) {
+        LVal *arg = lval_copy(lseq->cur);
+        LVal *next = lval_apply_argv(lenv, lseq->fn, 1, &arg);
+        if (next->type == LVAL_ERR) {
+            return next;
+        }
+        lval_del(lseq->cur);
+        lseq->cur = next;
+        lseq->stale = 0;
+    }
+
+    if (lseq->kind == LSEQ_GEN && !lseq->forced) {
+        LVal *arg = lval_copy(lseq->cur);
+        LVal *forced = lval_apply_argv(lenv, lseq->fn, 1, &arg);
+        if (forced->type == LVAL_ERR) {
+            return forced;
+        }
+        if (forced->type != LVAL_QEXPR ||
+            (forced->child_count != 0 && forced->child_count != 2)) {
+            LVal *lerr = lval_wrap_err(
+                LERR_BAD_GEN, NULL, forced->type,
+                forced->type == LVAL_QEXPR ? forced->child_count : 0, 0);
+            lval_del(forced);
+            return lerr;
+        }
+        lseq->forced = forced;
+    }
+
+    return NULL;
+}
+
+int lseq_empty(LSeq *lseq) {
+    switch (lseq->kind) {
+        case LSEQ_RANGE:
+            if (lseq->step > 0) {
+                return lseq->start >= lseq->stop;
+            }
+            // A step of 0 repeats `start` forever
+            return lseq->step < 0 && lseq->start <= lseq->stop;
+        case LSEQ_REPEAT:
+            return lseq->count == 0;
+        case LSEQ_GEN:
+            return lseq->forced->child_count == 0;
+        default:
+            return 0;
+    }
+}
+
+LVal *lseq_next(LEnv *lenv, LSeq *lseq) {
+    LVal *lerr = lseq_force(lenv, lseq);
+    if (lerr) {
+        return lerr;
+    }
+    if (lseq_empty(lseq)) {
+        return NULL;
+    }
+
+    LVal *elem;
+    switch (lseq->kind) {
+        case LSEQ_RANGE:
+            elem = lval_wrap_long(lseq->start);
+            lseq_drop(lenv, lseq, 1);
+            break;
+        case LSEQ_REPEAT:
+            elem = lval_copy(lseq->cur);
+            if (lseq->count > 0) {
+                lseq->count -= 1;
+            }
+            break;
+        case LSEQ_ITERATE:
+            // `fn` is only applied once the following element is needed
+            elem = lval_copy(lseq->cur);
+            lseq->stale = 1;
+            break;
+        default:
+            elem = lval_pop(lseq->forced, 0);
+            lval_del(lseq->cur);
+            lseq->cur = lval_take(lseq->forced, 0);
+            lseq->forced = NULL;
+            break;
+    }
+    return elem;
+}
+
+LVal *lseq_drop(LEnv *lenv, LSeq *lseq, long count) {
+    if (count <= 0) {
+        return NULL;
+    }
+
+    if (lseq->kind == LSEQ_RANGE) {
+        if (lseq->step == 0 || lseq_empty(lseq)) {
+            return NULL;
+        }
+
+        // Work unsigned so neither the distance to `stop` nor the skipped
+        // span can overflow
+        unsigned long left, stride;
+        if (lseq->step > 0) {
+            left = (unsigned long)lseq->stop - (unsigned long)lseq->start;
+            stride = (unsigned long)lseq->step;
+        } else {
+            left = (unsigned long)lseq->start - (unsigned long)lseq->stop;
+            stride = 0UL - (unsigned long)lseq->step;
+        }
+
+        unsigned long remaining = left / stride + (left % stride != 0);
+        if ((unsigned long)count >= remaining) {
+            lseq->start = lseq->stop;
+        } else {
+            lseq->start = (long)((unsigned long)lseq->start +
+                                 (unsigned long)count *
+                                     (unsigned long)lseq->step);
+        }
+        return NULL;
+    }
+
+    if (lseq->kind == LSEQ_REPEAT) {
+        if (lseq->count >= 0) {
+            lseq->count = count < lseq->count ? lseq->count - count : 0;
+        }
+        return NULL;
+    }
+
+    for (long i = 0; i < count; i++) {
+        LVal *elem = lseq_next(lenv, lseq);
+        if (!elem) {
+            break;
+        }
+        if (elem->type == LVAL_ERR) {
+            return elem;
+        }
+        lval_del(elem);
+    }
+    return NULL;
+}
+
+LVal *lval_seq_next(LEnv *lenv, LVal *lseq, char *lbuiltin) {
+    lseq->lseq = lseq_own(lseq->lseq);
+    LVal *elem = lseq_next(lenv, lseq->lseq);
+    return elem ? elem : lval_wrap_err(LERR_ARG_EMPTY, lbuiltin, 0, 0, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Functions to operate on transients */
+///////////////////////////////////////////////////////////////////////////////
+
+LTransient *ltransient_new(LVal *qexpr) {
+    LTransient *ltransient = malloc(sizeof(LTransient));
+    ltransient->refs = 1;
+    ltransient->frozen = 0;
+    ltransient->items = qexpr->children;
+    ltransient->count = qexpr->child_count;
+    ltransient->cap = qexpr->child_count;
+
+    qexpr->children = NULL;
+    qexpr->child_count = 0;
+    lval_del(qexpr);
+    return ltransient;
+}
+
+void ltransient_del(LTransient *ltransient, LWork *work) {
+    if (LATOMIC_ADD(ltransient->refs, -1) > 0) {
+        return;
+    }
+
+    for (int i = 0; i < ltransient->count; i++) {
+        lwork_push(work, ltransient->items[i]);
+    }
+    free(ltransient->items);
+    free(ltransient);
+}
+
+void ltransient_push(LTransient *ltransient, LVal *lval) {
+    if (ltransient->count == ltransient->cap) {
+        ltransient->cap = ltransient->cap ? 2 * ltransient->cap : 8;
+        ltransient->items =
+            realloc(ltransient->items, sizeof(LVal *) * ltransient->cap);
+    }
+    ltransient->items[ltransient->count++] = lval;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/* Language built-in(LEnv) functions for operation on different LVal types */
+///////////////////////////////////////////////////////////////////////////////
+
+LVal *builtin_list(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    lval->type = LVAL_QEXPR;
+    return lval;
+}
+
+LVal *builtin_listv(LEnv *lenv, int argc, LVal **argv) {
+    (void)lenv;
+    LVal *qexpr = lval_wrap_argv(argc, argv);
+    qexpr->type = LVAL_QEXPR;
+    return qexpr;
+}
+
+LVal *builtin_headv(LEnv *lenv, int argc, LVal **argv) {
+    LVal *qexpr = argv[0];
+    if (qexpr->type == LVAL_SEQ) {
+        LVal *elem = lval_seq_next(lenv, qexpr, "head");
+        lval_del(qexpr);
+        return elem->type == LVAL_ERR ? elem
+                                      : lval_add(lval_wrap_qexpr(), elem);
+    }
+
+    // Assert QEXPR passed to head was not empty
+    LASSERT_ARGV(argc, argv, qexpr->child_count != 0,
+                 lval_wrap_err(LERR_ARG_EMPTY, "head", 0, 0, 0));
+
+    // Delete all elements(children) of qexpr except first
+    for (int i = 1; i < qexpr->child_count; i++) {
+        lval_del(qexpr->children[i]);
+    }
+    qexpr->child_count = 1;
+    return qexpr;
+}
+
+LVal *builtin_head(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_headv, lval);
+}
+
+LVal *builtin_tailv(LEnv *lenv, int argc, LVal **argv) {
+    LVal *qexpr = argv[0];
+    if (qexpr->type == LVAL_SEQ) {
+        LVal *elem = lval_seq_next(lenv, qexpr, "tail");
+        if (elem->type == LVAL_ERR) {
+            lval_del(qexpr);
+            return elem;
+        }
+        lval_del(elem);
+        return qexpr;
+    }
+
+    LASSERT_ARGV(argc, argv, qexpr->child_count != 0,
+                 lval_wrap_err(LERR_ARG_EMPTY, "tail", 0, 0, 0));
+
+    // Only delete the first child of the argument
+    lval_del(lval_pop(qexpr, 0));
+    return qexpr;
+}
+
+LVal *builtin_tail(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_tailv, lval);
+}
+
+LVal *builtin_evalv(LEnv *lenv, int argc, LVal **argv) {
+    (void)argc;
+    // Evaluate as an SEXPR
+    LVal *qexpr = argv[0];
+    qexpr->type = LVAL_SEXPR;
+    return lval_eval(lenv, qexpr);
+}
+
+LVal *builtin_eval(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_evalv, lval);
+}
+
+// {name num}
+static LVal *lval_wrap_pair(const char *name, long num) {
+    LVal *pair = lval_wrap_qexpr();
+    lval_add(pair, lval_wrap_symn(name, strlen(name)));
+    return lval_add(pair, lval_wrap_long(num));
+}
+
+LVal *builtin_measure(LEnv *lenv, LVal *lval) {
     LVal *qexpr = lval_take(lval, 0);
+    qexpr->type = LVAL_SEXPR;
+
+    LPerf lperf;
+    lperf_start(&lperf);
+    LVal *result = lval_eval(lenv, qexpr);
+    lperf_stop(&lperf);
+    if (result->type == LVAL_ERR) {
+        return result;
+    }
+
+    LVal *measured = lval_add(lval_wrap_qexpr(), result);
+    lval_add(measured, lval_wrap_pair("ns", lperf.ns));
+    for (int i = 0; i < LPERF_COUNTERS; i++) {
+        if (lperf.counts[i] >= 0) {
+            lval_add(measured, lval_wrap_pair(lperf_names[i], lperf.counts[i]));
+        }
+    }
+    return measured;
+}
+
+LVal *builtin_joinv(LEnv *lenv, int argc, LVal **argv) {
+    (void)lenv;
+    // Join the remaining args to the first
+    LVal *qexpr = argv[0];
+    for (int i = 1; i < argc; i++) {
+        qexpr = lval_join(qexpr, argv[i]);
+    }
+    return qexpr;
+}
+
+LVal *builtin_join(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_joinv, lval);
+}
+
+// The LBig of a LVAL_NUM or LVAL_BIG, a reference to be released
+static LBig *lval_to_big(LVal *lval) {
+    if (lval->type == LVAL_BIG) {
+        LATOMIC_ADD(lval->lbig->refs, 1);
+        return lval->lbig;
+    }
+    return lbig_from_long(lval->num);
+}
+
+// Compare LVAL_NUMs or LVAL_BIGs, which lie beyond every long
+static int lval_cmp_num(LVal *first, LVal *second) {
+    if (first->type == LVAL_NUM && second->type == LVAL_NUM) {
+        return (first->num > second->num) - (first->num < second->num);
+    }
+    if (first->type == LVAL_NUM) {
+        return second->lbig->neg ? 1 : -1;
+    }
+    if (second->type == LVAL_NUM) {
+        return first->lbig->neg ? -1 : 1;
+    }
+    return lbig_cmp(first->lbig, second->lbig);
+}
+
+// An operation of builtin_op on LBigs, for operands of which either is a
+// LVAL_BIG or whose result overflows a long. `second` is NULL to negate
+// `first`, a divisor isn't 0. Consumes both
+static LVal *lval_op_big(LVal *first, LVal *second, char op) {
+    LBig *a = lval_to_big(first);
+    LBig *b = second ? lval_to_big(second) : NULL;
+    lval_del(first);
+
+    LBig *result;
+    if (!b) {
+        result = lbig_neg(a);
+    } else {
+        lval_del(second);
+        switch (op) {
+            case '+':
+                result = lbig_add(a, b);
+                break;
+            case '-':
+                result = lbig_sub(a, b);
+                break;
+            case '*':
+                result = lbig_mul(a, b);
+                break;
+            case '/':
+                result = lbig_div(a, b);
+                break;
+            default:
+                result = lbig_mod(a, b);
+                break;
+        }
+        lbig_del(b);
+    }
+    lbig_del(a);
+    return lval_wrap_big(result);
+}
+
+LVal *builtin_op(LEnv *lenv, int argc, LVal **argv, char *op) {
+    (void)lenv;
+
+    // Get the first operand
+    LVal *first = argv[0];
+
+    // If only first operand is supplied with `-` operator negate first operand
+    if (*op == '-' && argc == 1) {
+        long num;
+        if (first->type == LVAL_NUM &&
+            !__builtin_sub_overflow(0, first->num, &num)) {
+            first->num = num;
+            return first;
+        }
+        return lval_op_big(first, NULL, *op);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        // Get the other(second) operand
+        LVal *second = argv[i];
+
+        // A LVAL_BIG is never 0
+        if ((*op == '/' || *op == '%') && second->type == LVAL_NUM &&
+            second->num == 0) {
+            // Free first, second and the remaining operands
+            lval_del(first);
+            lval_del_argv(argc - i, argv + i);
+
+            first = &lerr_div_zero;
+            break;
+        }
+
+        // Numbers are computed in place for as long as they fit a long
+        long num = 0;
+        int overflow = 1;
+        if (first->type == LVAL_NUM && second->type == LVAL_NUM) {
+            switch (*op) {
+                case '+':
+                    overflow =
+                        __builtin_add_overflow(first->num, second->num, &num);
+                    break;
+                case '-':
+                    overflow =
+                        __builtin_sub_overflow(first->num, second->num, &num);
+                    break;
+                case '*':
+                    overflow =
+                        __builtin_mul_overflow(first->num, second->num, &num);
+                    break;
+                case '/':
+                    // Only LONG_MIN / -1 overflows, as a negation
+                    if (second->num == -1) {
+                        overflow = __builtin_sub_overflow(0, first->num, &num);
+                    } else {
+                        num = first->num / second->num;
+                        overflow = 0;
+                    }
+                    break;
+                case '%':
+                    // LONG_MIN % -1 traps like LONG_MIN / -1 does
+                    num = second->num == -1 ? 0 : first->num % second->num;
+                    overflow = 0;
+                    break;
+            }
+        }
+
+        if (!overflow) {
+            first->num = num;
+            lval_del(second);
+        } else {
+            first = lval_op_big(first, second, *op);
+        }
+    }
+
+    return first;
+}
+
+LVal *builtin_modv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_op(lenv, argc, argv, "%");
+}
+
+LVal *builtin_mod(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_modv, lval);
+}
+
+LVal *builtin_ord(LEnv *lenv, int argc, LVal **argv, char *op) {
+    (void)lenv;
+
+    long result = 0;
+    long first = argv[0]->num;
+    long second = argv[1]->num;
+
+    // Past a long only the sign of the comparison is needed
+    if (argv[0]->type == LVAL_BIG || argv[1]->type == LVAL_BIG) {
+        first = lval_cmp_num(argv[0], argv[1]);
+        second = 0;
+    }
+
+    if (strcmp(op, "<") == 0) {
+        result = (first < second);
+    } else if (strcmp(op, ">") == 0) {
+        result = (first > second);
+    } else if (strcmp(op, "<=") == 0) {
+        result = (first <= second);
+    } else if (strcmp(op, ">=") == 0) {
+        result = (first >= second);
+    }
+
+    lval_del_argv(argc, argv);
+    return lval_wrap_long(result);
+}
+
+LVal *builtin_cmp(LEnv *lenv, int argc, LVal **argv, char *op) {
+    (void)lenv;
+
+    int result = 0;
+    LVal *first = argv[0];
+    LVal *second = argv[1];
+
+    if (strcmp(op, "==") == 0) {
+        result = lval_eq(first, second);
+    } else if (strcmp(op, "!=") == 0) {
+        result = !lval_eq(first, second);
+    }
+
+    lval_del_argv(argc, argv);
+    return lval_wrap_long(result);
+}
+
+LVal *builtin_ifv(LEnv *lenv, int argc, LVal **argv) {
+    (void)argc;
+    // Only the chosen branch is kept, and evaluated as a S-Expression
+    int taken = argv[0]->num ? 1 : 2;
+    LVal *branch = argv[taken];
+    lval_del(argv[0]);
+    lval_del(argv[3 - taken]);
+
+    branch->type = LVAL_SEXPR;
+    return lval_eval(lenv, branch);
+}
+
+LVal *builtin_if(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_ifv, lval);
+}
+
+// Evaluate forms of a loop as S-Expressions, returns the first error or NULL
+static LVal *lval_eval_loop(LEnv *lenv, int count, LVal **forms) {
+    for (int i = 0; i < count; i++) {
+        if (forms[i]->child_count == 0) {
+            continue;
+        }
+        LVal *result = lval_eval_borrowed(lenv, forms[i]);
+        if (result->type == LVAL_ERR) {
+            return result;
+        }
+        lval_del(result);
+    }
+    return NULL;
+}
+
+LVal *builtin_while(LEnv *lenv, LVal *lval) {
+    // The forms are kept and evaluated in place, only their results allocate
+    for (int i = 0; i < lval->child_count; i++) {
+        lval->children[i]->type = LVAL_SEXPR;
+    }
+    LVal *lcond = lval->children[0];
+    LVal **forms = lval->children + 1;
+    int count = lval->child_count - 1;
+
+    LVal *result = NULL;
+    while (!result) {
+        LVal *holds = lval_eval_borrowed(lenv, lcond);
+        if (holds->type != LVAL_NUM) {
+            result = holds->type == LVAL_ERR
+                         ? holds
+                         : lval_wrap_err(LERR_ARG_TYPE, "while", 0,
+                                         holds->type, LVAL_NUM);
+            if (result != holds) {
+                lval_del(holds);
+            }
+            break;
+        }
+
+        long num = holds->num;
+        lval_del(holds);
+        if (!num) {
+            break;
+        }
+        result = lval_eval_loop(lenv, count, forms);
+    }
+
+    lval_del(lval);
+    return result ? result : lval_wrap_sexpr();
+}
+
+LVal *builtin_dotimes(LEnv *lenv, LVal *lval) {
+    LVal *lvar = lval->children[0];
+    LASSERT(lval, lvar->child_count == 1,
+            lval_wrap_err(LERR_ARG_COUNT, "dotimes", lvar->child_count, 1, 0));
+    LASSERT(lval, lvar->children[0]->type == LVAL_SYM,
+            lval_wrap_err(LERR_ARG_TYPE, "dotimes", 0,
+                          lvar->children[0]->type, LVAL_SYM));
+
+    // Same as `=` binding a global (@see builtin_var)
+    if (!lenv->parent) {
+        LASSERT(lval, !ltask_inside() && !lenv_frozen,
+                lval_wrap_err(LERR_FROZEN, "dotimes", 0, 0, 0));
+        ltask_quiesce();
+    }
+
+    for (int i = 2; i < lval->child_count; i++) {
+        lval->children[i]->type = LVAL_SEXPR;
+    }
+    LVal **forms = lval->children + 2;
+    int count = lval->child_count - 2;
+
+    // A local counter is counted in place once bound, unless forms rebind
+    // it. Globals are always put, for compiled code to see they changed
+    LVal *lsym = lvar->children[0];
+    LVal *result = NULL;
+    LVal lcounter = {.type = LVAL_NUM};
+    for (long n = lval->children[1]->num; !result && lcounter.num < n;
+         lcounter.num++) {
+        LVal *lbound = lenv->parent ? lenv_get_local(lenv, lsym->sym) : NULL;
+        if (lbound && lbound->type == LVAL_NUM && !lbound->flags) {
+            lbound->num = lcounter.num;
+        } else {
+            lenv_put(lenv, lsym, &lcounter);
+        }
+        result = lval_eval_loop(lenv, count, forms);
+    }
+
+    lval_del(lval);
+    return result ? result : lval_wrap_sexpr();
+}
+
+LVal *builtin_var(LEnv *lenv, LVal *lval, char *fun) {
+    // Syntax is of the form:
+    //`fun {sym1, sym2, ...} val1, val2, ...`
+    //     ^- Child 0        ^- Child 1  ^- Child N
+
+    // Check whether Child 0 is a QEXPR
+    LASSERT_CHILD_TYPE(fun, lval, 0, LVAL_QEXPR);
+
+    // Get the symbol list(QEXPR)
+    LVal *var_list = lval->children[0];
+
+    // Assert all var_list members are symbols
+    for (int i = 0; i < var_list->child_count; i++) {
+        LASSERT(lval, var_list->children[i]->type == LVAL_SYM,
+                lval_wrap_err(LERR_ARG_TYPE, fun, i,
+                              var_list->children[i]->type, LVAL_SYM));
+    }
+
+    // Assert there are enough values for all symbols in var list
+    LASSERT(lval, var_list->child_count == lval->child_count - 1,
+            lval_wrap_err(LERR_ARG_COUNT, fun, var_list->child_count,
+                          lval->child_count - 1, 0));
+
+    // Tasks share the global environment read only, bindings from outside of
+    // tasks wait for them to finish (@see ltask.h)
+    if (strcmp(fun, "def") == 0 || !lenv->parent) {
+        LASSERT(lval, !ltask_inside() && !lenv_frozen,
+                lval_wrap_err(LERR_FROZEN, fun, 0, 0, 0));
+        ltask_quiesce();
+    }
+
+    for (int i = 0; i < var_list->child_count; i++) {
+        // If fun is "def" put in global scope i.e parent environment
+        if (strcmp(fun, "def") == 0) {
+            lenv_put_global(lenv, var_list->children[i], lval->children[i + 1]);
+        } else if (strcmp(fun, "=") == 0) {  // Else in local environment
+            // Put variable symbols and their values in the env
+            lenv_put(lenv, var_list->children[i], lval->children[i + 1]);
+        }
+    }
+
+    lval_del(lval);
+    return lval_wrap_sexpr();
+}
+
+LVal *builtin_lambda(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    // Check if first child(lformals) contains only symbols
+    for (int i = 0; i < lval->children[0]->child_count; i++) {
+        LASSERT(lval, (lval->children[0]->children[i]->type == LVAL_SYM),
+                lval_wrap_err(LERR_BAD_FORMALS, "\\",
+                              lval->children[0]->children[i]->type, LVAL_SYM,
+                              0));
+    }
+
+    LVal *lformals = lval_pop(lval, 0);
+    LVal *lbody = lval_pop(lval, 0);
+
+    lval_del(lval);
+
+    LVal *llambda = lval_wrap_lambda(lformals, lbody);
+
+    // Fold constants once here, rather than evaluating them on every call
+    if (LATOMIC_GET(lenv_fold_shadows) == 0) {
+        llambda->lfolded = lval_fold_body(lbody, lformals);
+    }
+
+    return llambda;
+}
+
+void lval_eval_forms(LEnv *lenv, LVal *lforms,
+                     void (*after)(LEnv *lenv, void *ctx), void *ctx) {
+    while (lforms->child_count) {
+        LVal *lform = lval_pop(lforms, 0);
+
+        if (LATOMIC_GET(lenv_fold_shadows) == 0) {
+            int changed = 0;
+            lform = lval_fold(lform, NULL, &changed);
+        }
+
+        LVal *leval = lval_eval(lenv, lform);
+        if (leval->type == LVAL_ERR) {
+            lval_println(leval);
+        }
+        lval_del(leval);
+
+        if (after) {
+            after(lenv, ctx);
+        }
+    }
+
+    lval_del(lforms);
+}
+
+LVal *builtin_load(LEnv *lenv, LVal *lval) {
+    lval_str_terminate(lval->children[0]);
+    char *path = lval->children[0]->str;
+
+    // Forms of an unchanged file are decoded from its cache, else the file
+    // is parsed and the cache written for next time
+    LSerStamp stamp;
+    LVal *lexpr = lser_cache_load(path, &stamp);
+    if (!lexpr) {
+        mpc_result_t result;
+        if (!mpc_parse_contents(path, Notation, &result)) {
+            char *err = mpc_err_string(result.error);
+            mpc_err_delete(result.error);
+
+            LVal *lerr = lval_wrap_err_str(LERR_LOAD, err);
+            free(err);
+            lval_del(lval);
+
+            return lerr;
+        }
+
+        lexpr = lval_read_ast(result.output);
+        mpc_ast_delete(result.output);
+        lser_cache_save(path, &stamp, lexpr);
+    }
+
+    lval_eval_forms(lenv, lexpr, NULL, NULL);
+    lval_del(lval);
+
+    return lval_wrap_sexpr();
+}
+
+// Error opening `path` for the reason `err` (an errno value)
+static LVal *lval_wrap_err_open(const char *path, int err) {
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lbuf_puts(&lbuf, path);
+    lbuf_puts(&lbuf, ": ");
+    lbuf_puts(&lbuf, strerror(err));
+    char *reason = lbuf_take(&lbuf, NULL);
+
+    LVal *lerr = lval_wrap_err_str(LERR_OPEN, reason);
+    free(reason);
+    return lerr;
+}
+
+LVal *builtin_dump(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    lval_str_terminate(lval->children[0]);
+    int err = lser_dump(lval->children[0]->str, lval->children[1]);
+    LASSERT(lval, err >= 0, lval_wrap_err(LERR_BAD_DUMP, "dump", 0, 0, 0));
+    LASSERT(lval, err == 0, lval_wrap_err_open(lval->children[0]->str, err));
+
+    lval_del(lval);
+    return lval_wrap_sexpr();
+}
+
+LVal *builtin_undump(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    lval_str_terminate(lval->children[0]);
+    int err;
+    LVal *result = lser_undump(lval->children[0]->str, &err);
+    LASSERT(lval, err >= 0,
+            lval_wrap_err(LERR_BAD_DUMP, "undump", 0, 0, 0));
+    LASSERT(lval, err == 0, lval_wrap_err_open(lval->children[0]->str, err));
+
+    lval_del(lval);
+    return result;
+}
+
+LVal *builtin_print(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    // Buffer the whole line and write it out at once
+    LBuf lbuf;
+    lbuf_init_file(&lbuf, stdout);
+    for (int i = 0; i < lval->child_count; i++) {
+        lval_print_lbuf(&lbuf, lval->children[i]);
+        lbuf_putc(&lbuf, ' ');
+    }
+    lbuf_putc(&lbuf, '\n');
+    lbuf_free(&lbuf);
+    lval_del(lval);
+
+    return lval_wrap_sexpr();
+}
+
+LVal *builtin_err(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+
+    lval_str_terminate(lval->children[0]);
+    LVal *lerr = lval_wrap_err_str(LERR_CUSTOM, lval->children[0]->str);
+
+    lval_del(lval);
+    return lerr;
+}
 
-    // Pop all elements(children) of qexpr except first
-    while (qexpr->child_count > 1) {
-        lval_del(lval_pop(qexpr, 1));
-    }
+LVal *builtin_err_code(LEnv *lenv, LVal *lval) {
+    LVal *result = builtin_eval(lenv, lval);
+    long errcode = result->type == LVAL_ERR ? result->errcode : LERR_NONE;
 
-    return qexpr;
+    lval_del(result);
+    return lval_wrap_long(errcode);
 }
 
-LVal *builtin_tail(LEnv *lenv, LVal *lval) {
+LVal *builtin_tostr(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    LASSERT_CHILD_COUNT("tail", lval, 1);
 
-    LASSERT_CHILD_TYPE("tail", lval, 0, LVAL_QEXPR);
+    LBuf lbuf;
+    lbuf_init_str(&lbuf);
+    lval_print_lbuf(&lbuf, lval->children[0]);
 
-    LASSERT_CHILD_NOT_EMPTY("tail", lval, 0);
+    LVal *lstr = lval_wrap_strn(lbuf.data, lbuf.len);
 
-    // Get heads first argument
-    LVal *qexpr = lval_take(lval, 0);
+    lbuf_free(&lbuf);
+    lval_del(lval);
+    return lstr;
+}
 
-    // Only delete the first child of the argument
-    lval_del(lval_pop(qexpr, 0));
-    return qexpr;
+LVal *builtin_dict(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    // A single qexpr holds the keys and values, eg: to build from a list
+    if (lval->child_count == 1 && lval->children[0]->type == LVAL_QEXPR) {
+        lval = lval_take(lval, 0);
+    }
+
+    LASSERT(lval, lval->child_count % 2 == 0,
+            lval_wrap_err(LERR_ARG_COUNT, "dict", lval->child_count,
+                          lval->child_count + 1, 0));
+    for (int i = 0; i < lval->child_count; i += 2) {
+        LASSERT_CHILD_KEY("dict", lval, i);
+    }
+
+    LMap *lmap = lmap_new();
+    for (int i = 0; i < lval->child_count; i += 2) {
+        lmap_put(lmap, lval->children[i], lval->children[i + 1]);
+    }
+
+    // Keys and values were moved into the map
+    lval->child_count = 0;
+    lval_del(lval);
+    return lval_wrap_map(lmap);
 }
 
-LVal *builtin_eval(LEnv *lenv, LVal *lval) {
+LVal *builtin_dict_get(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    LASSERT_CHILD_COUNT("eval", lval, 1);
+    LASSERT(lval, lval->child_count == 2 || lval->child_count == 3,
+            lval_wrap_err(LERR_ARG_COUNT, "dict-get", lval->child_count, 2,
+                          0));
+    LASSERT_CHILD_TYPE("dict-get", lval, 0, LVAL_MAP);
+    LASSERT_CHILD_KEY("dict-get", lval, 1);
 
-    LASSERT_CHILD_TYPE("eval", lval, 0, LVAL_QEXPR);
+    LVal *key = lval->children[1];
+    LVal *found = lmap_get(lval->children[0]->lmap, key);
 
-    // Get the first argument
-    LVal *qexpr = lval_take(lval, 0);
-    // Evaluate as an SEXPR
-    qexpr->type = LVAL_SEXPR;
-    return lval_eval(lenv, qexpr);
+    LVal *result;
+    if (found) {
+        result = lval_copy(found);
+    } else if (lval->child_count == 3) {
+        result = lval_pop(lval, 2);
+    } else {
+        LBuf lbuf;
+        lbuf_init_str(&lbuf);
+        lval_print_lbuf(&lbuf, key);
+        char *printed = lbuf_take(&lbuf, NULL);
+        result = lval_wrap_err_str(LERR_NO_KEY, printed);
+        free(printed);
+    }
+
+    lval_del(lval);
+    return result;
 }
 
-LVal *builtin_join(LEnv *lenv, LVal *lval) {
+LVal *builtin_dict_put(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    for (int i = 0; i < lval->child_count; i++) {
-        LASSERT_CHILD_TYPE("join", lval, i, LVAL_QEXPR);
+    LASSERT_CHILD_KEY("dict-put", lval, 1);
+
+    LVal *ldict = lval->children[0];
+    ldict->lmap = lmap_own(ldict->lmap);
+    lmap_put(ldict->lmap, lval->children[1], lval->children[2]);
+
+    // The key and value were moved into the map
+    lval->child_count = 1;
+    return lval_take(lval, 0);
+}
+
+LVal *builtin_dict_del(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    LASSERT_CHILD_KEY("dict-del", lval, 1);
+
+    // Avoid copying a shared map when there is nothing to remove
+    LVal *ldict = lval->children[0];
+    if (lmap_get(ldict->lmap, lval->children[1])) {
+        ldict->lmap = lmap_own(ldict->lmap);
+        lmap_remove(ldict->lmap, lval->children[1]);
     }
 
-    // Get the first arg of head
-    LVal *qexpr = lval_pop(lval, 0);
+    return lval_take(lval, 0);
+}
+
+LVal *builtin_dict_keys(LEnv *lenv, LVal *lval) {
+    (void)lenv;
 
-    // Join the remaining args to the first
-    while (lval->child_count) {
-        qexpr = lval_join(qexpr, lval_pop(lval, 0));
+    LMap *lmap = lval->children[0]->lmap;
+    LVal *keys = lval_wrap_qexpr();
+    keys->children = malloc(sizeof(LVal *) * lmap->count);
+    LMapIter iter;
+    lmap_iter_init(&iter, lmap);
+    for (LMapEntry *entry; (entry = lmap_iter_next(&iter));) {
+        keys->children[keys->child_count++] = lval_copy(entry->key);
     }
 
-    // Delete the LVal
     lval_del(lval);
-    return qexpr;
+    return keys;
+}
+
+LVal *builtin_dict_size(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+
+    LVal *size = lval_wrap_long((long)lval->children[0]->lmap->count);
+    lval_del(lval);
+    return size;
 }
 
-LVal *builtin_op(LEnv *lenv, LVal *lval, char *op) {
+LVal *builtin_range(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    // Error handling for non-number values
+    LASSERT(lval, lval->child_count >= 1 && lval->child_count <= 3,
+            lval_wrap_err(LERR_ARG_COUNT, "range", lval->child_count, 2, 0));
     for (int i = 0; i < lval->child_count; i++) {
-        LASSERT_CHILD_TYPE(op, lval, i, LVAL_NUM);
+        LASSERT_CHILD_TYPE("range", lval, i, LVAL_NUM);
     }
+    // A step of 0 would repeat `start` forever
+    LASSERT(lval, lval->child_count < 3 || lval->children[2]->num != 0,
+            lval_wrap_err(LERR_BAD_ARG, "range", 2, 0, 0));
 
-    // Get the first operand
-    // Side-Effect lval->child_count--;
-    LVal *first = lval_pop(lval, 0);
+    LSeq *lseq = lseq_new(LSEQ_RANGE);
+    if (lval->child_count == 1) {
+        lseq->stop = lval->children[0]->num;
+    } else {
+        lseq->start = lval->children[0]->num;
+        lseq->stop = lval->children[1]->num;
+    }
+    lseq->step = lval->child_count == 3 ? lval->children[2]->num : 1;
 
-    // If only first operand is supplied with `-` operator negate first operand
-    if ((strcmp(op, "-") == 0) && lval->child_count == 0) {
-        first->num = -first->num;
+    lval_del(lval);
+    return lval_wrap_seq(lseq);
+}
+
+LVal *builtin_iterate(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+
+    LSeq *lseq = lseq_new(LSEQ_ITERATE);
+    lseq->fn = lval_pop(lval, 0);
+    lseq->cur = lval_take(lval, 0);
+    return lval_wrap_seq(lseq);
+}
+
+LVal *builtin_repeat(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    LASSERT(lval, lval->child_count == 1 || lval->child_count == 2,
+            lval_wrap_err(LERR_ARG_COUNT, "repeat", lval->child_count, 1, 0));
+    if (lval->child_count == 2) {
+        LASSERT_CHILD_TYPE("repeat", lval, 1, LVAL_NUM);
     }
 
-    while (lval->child_count > 0) {
-        // Get the other(second) operand
-        LVal *second = lval_pop(lval, 0);
+    LSeq *lseq = lseq_new(LSEQ_REPEAT);
+    lseq->count = -1;
+    if (lval->child_count == 2) {
+        lseq->count = lval->children[1]->num < 0 ? 0 : lval->children[1]->num;
+    }
+    lseq->cur = lval_take(lval, 0);
+    return lval_wrap_seq(lseq);
+}
+
+LVal *builtin_gen(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+
+    LSeq *lseq = lseq_new(LSEQ_GEN);
+    lseq->fn = lval_pop(lval, 0);
+    lseq->cur = lval_take(lval, 0);
+    return lval_wrap_seq(lseq);
+}
+
+LVal *builtin_take(LEnv *lenv, LVal *lval) {
+    long count = lval->children[0]->num;
+
+    if (lval->children[1]->type == LVAL_QEXPR) {
+        LVal *qexpr = lval_take(lval, 1);
+        int keep = count < 0                      ? 0
+                   : count < qexpr->child_count ? (int)count
+                                                : qexpr->child_count;
+        for (int i = keep; i < qexpr->child_count; i++) {
+            lval_del(qexpr->children[i]);
+        }
+        qexpr->child_count = keep;
+        return qexpr;
+    }
+
+    LVal *lseq = lval_take(lval, 1);
+    lseq->lseq = lseq_own(lseq->lseq);
 
-        if (strcmp(op, "+") == 0) {
-            first->num += second->num;
+    LVal *taken = lval_wrap_qexpr();
+    for (long i = 0; i < count; i++) {
+        LVal *elem = lseq_next(lenv, lseq->lseq);
+        if (!elem) {
+            break;
+        }
+        if (elem->type == LVAL_ERR) {
+            lval_del(taken);
+            taken = elem;
+            break;
         }
+        lval_add(taken, elem);
+    }
+
+    lval_del(lseq);
+    return taken;
+}
 
-        if (strcmp(op, "-") == 0) {
-            first->num -= second->num;
+LVal *builtin_drop(LEnv *lenv, LVal *lval) {
+    long count = lval->children[0]->num;
+
+    if (lval->children[1]->type == LVAL_QEXPR) {
+        LVal *qexpr = lval_take(lval, 1);
+        int skip = count < 0                      ? 0
+                   : count < qexpr->child_count ? (int)count
+                                                : qexpr->child_count;
+        for (int i = 0; i < skip; i++) {
+            lval_del(qexpr->children[i]);
         }
+        memmove(qexpr->children, qexpr->children + skip,
+                sizeof(LVal *) * (size_t)(qexpr->child_count - skip));
+        qexpr->child_count -= skip;
+        return qexpr;
+    }
+
+    LVal *lseq = lval_take(lval, 1);
+    lseq->lseq = lseq_own(lseq->lseq);
+
+    LVal *lerr = lseq_drop(lenv, lseq->lseq, count);
+    if (lerr) {
+        lval_del(lseq);
+        return lerr;
+    }
+    return lseq;
+}
+
+LVal *builtin_map(LEnv *lenv, LVal *lval) {
+    LVal *lfun = lval->children[0];
+    LVal *list = lval->children[1];
 
-        if (strcmp(op, "*") == 0) {
-            first->num *= second->num;
+    // Each element is moved into its call and replaced by the result, so
+    // the list's own children are reused for the result, and its slot is
+    // the vector of arguments
+    for (int i = 0; i < list->child_count; i++) {
+        list->children[i] = lval_apply_argv(lenv, lfun, 1, &list->children[i]);
+
+        if (list->children[i]->type == LVAL_ERR) {
+            LVal *lerr = lval_pop(list, i);
+            lval_del(lval);
+            return lerr;
         }
+    }
 
-        if (strcmp(op, "/") == 0) {
-            if (second->num == 0) {
-                // Free first and second
-                lval_del(first);
-                lval_del(second);
+    return lval_take(lval, 1);
+}
 
-                first = lval_wrap_err("Cannot divide by zero!");
-                break;
+LVal *builtin_filter(LEnv *lenv, LVal *lval) {
+    LVal *lfun = lval->children[0];
+    LVal *list = lval->children[1];
+
+    // Kept elements are compacted to the front of the list's children
+    int kept = 0;
+    for (int i = 0; i < list->child_count; i++) {
+        LVal *elem = list->children[i];
+        LVal *arg = lval_copy(elem);
+        LVal *keep = lval_apply_argv(lenv, lfun, 1, &arg);
+
+        if (keep->type != LVAL_NUM) {
+            LVal *lerr = keep;
+            if (keep->type != LVAL_ERR) {
+                lerr = lval_wrap_err(LERR_BAD_RESULT, "filter", i, keep->type,
+                                     LVAL_NUM);
+                lval_del(keep);
             }
 
-            first->num /= second->num;
+            // Keep the unvisited elements after the kept ones, for deletion
+            memmove(list->children + kept, list->children + i,
+                    sizeof(LVal *) * (size_t)(list->child_count - i));
+            list->child_count = kept + list->child_count - i;
+            lval_del(lval);
+            return lerr;
         }
 
-        if (strcmp(op, "%") == 0) {
-            first->num %= second->num;
+        if (keep->num) {
+            list->children[kept++] = elem;
+        } else {
+            lval_del(elem);
         }
-
-        lval_del(second);
+        lval_del(keep);
     }
+    list->child_count = kept;
 
-    lval_del(lval);
-    return first;
+    return lval_take(lval, 1);
 }
 
-LVal *builtin_mod(LEnv *lenv, LVal *lval) {
-    return builtin_op(lenv, lval, "%");
+// Ordering of sort for numbers some of which are LVAL_BIGs
+static int lval_sort_less_num(LVal *first, LVal *second, void *ctx) {
+    (void)ctx;
+    return lval_cmp_num(first, second) < 0;
 }
 
-LVal *builtin_ord(LEnv *lenv, LVal *lval, char *op) {
+LVal *builtin_sort(LEnv *lenv, LVal *lval) {
     (void)lenv;
 
-    LASSERT_CHILD_COUNT(op, lval, 2);
-    LASSERT_CHILD_TYPE(op, lval, 0, LVAL_NUM);
-    LASSERT_CHILD_TYPE(op, lval, 1, LVAL_NUM);
-
-    long result = 0;
-    long first = lval->children[0]->num;
-    long second = lval->children[1]->num;
+    LVal *list = lval_take(lval, 0);
+    if (list->child_count == 0) {
+        return list;
+    }
 
-    if (strcmp(op, "<") == 0) {
-        result = (first < second);
-    } else if (strcmp(op, ">") == 0) {
-        result = (first > second);
-    } else if (strcmp(op, "<=") == 0) {
-        result = (first <= second);
-    } else if (strcmp(op, ">=") == 0) {
-        result = (first >= second);
+    // Elements are ordered like the first one, there's no order across types
+    int type = list->children[0]->type == LVAL_STR ? LVAL_STR : LVAL_NUM;
+    int bigs = 0;
+    for (int i = 0; i < list->child_count; i++) {
+        if (type == LVAL_NUM && list->children[i]->type == LVAL_BIG) {
+            bigs = 1;
+            continue;
+        }
+        if (list->children[i]->type != type) {
+            LVal *lerr = lval_wrap_err(LERR_BAD_ELEM, "sort", i,
+                                       list->children[i]->type, type);
+            lval_del(list);
+            return lerr;
+        }
     }
 
-    lval_del(lval);
-    return lval_wrap_long(result);
+    if (bigs) {
+        lsort_intro(list->children, list->child_count, lval_sort_less_num,
+                    NULL);
+    } else if (type == LVAL_NUM) {
+        lsort_nums(list->children, list->child_count);
+    } else {
+        lsort_strs(list->children, list->child_count);
+    }
+    return list;
 }
 
-LVal *builtin_cmp(LEnv *lenv, LVal *lval, char *op) {
-    (void)lenv;
+/**
+ * @brief  Ordering of sort-by, calling a function
+ */
+typedef struct LSortBy {
+    LEnv *lenv;
+    LVal *lfun;
+    /* First error returned by the function, no more calls are made after */
+    LVal *lerr;
+} LSortBy;
+
+static int lval_sort_less(LVal *first, LVal *second, void *ctx) {
+    LSortBy *by = ctx;
+    if (by->lerr) {
+        return 0;
+    }
 
-    LASSERT_CHILD_COUNT(op, lval, 2);
+    LVal *argv[2] = {lval_copy(first), lval_copy(second)};
+    LVal *less = lval_apply_argv(by->lenv, by->lfun, 2, argv);
+    if (less->type != LVAL_NUM) {
+        by->lerr = less;
+        if (less->type != LVAL_ERR) {
+            by->lerr = lval_wrap_err(LERR_ARG_TYPE, "sort-by", 0, less->type,
+                                     LVAL_NUM);
+            lval_del(less);
+        }
+        return 0;
+    }
 
-    int result = 0;
-    LVal *first = lval->children[0];
-    LVal *second = lval->children[1];
+    int result = less->num != 0;
+    lval_del(less);
+    return result;
+}
 
-    if (strcmp(op, "==") == 0) {
-        result = lval_eq(first, second);
-    } else if (strcmp(op, "!=") == 0) {
-        result = !lval_eq(first, second);
+LVal *builtin_sort_by(LEnv *lenv, LVal *lval) {
+    LSortBy by = {lenv, lval->children[0], NULL};
+    LVal *list = lval->children[1];
+    lsort_merge(list->children, list->child_count, lval_sort_less, &by);
+
+    // The elements are still all in the list after an error, and deleted
+    if (by.lerr) {
+        lval_del(lval);
+        return by.lerr;
+    }
+    return lval_take(lval, 1);
+}
+
+LVal *builtin_fold(LEnv *lenv, LVal *lval) {
+    LVal *acc = lval_pop(lval, 1);
+    LVal *lfun = lval->children[0];
+    LVal *src = lval->children[1];
+
+    if (src->type == LVAL_QEXPR) {
+        // Elements are moved into the calls, the rest deleted on error
+        int i = 0;
+        while (i < src->child_count && acc->type != LVAL_ERR) {
+            LVal *argv[2] = {acc, src->children[i]};
+            acc = lval_apply_argv(lenv, lfun, 2, argv);
+            i++;
+        }
+        while (i < src->child_count) {
+            lval_del(src->children[i++]);
+        }
+        src->child_count = 0;
+    } else {
+        src->lseq = lseq_own(src->lseq);
+        while (acc->type != LVAL_ERR) {
+            LVal *elem = lseq_next(lenv, src->lseq);
+            if (!elem) {
+                break;
+            }
+            if (elem->type == LVAL_ERR) {
+                lval_del(acc);
+                acc = elem;
+                break;
+            }
+            LVal *argv[2] = {acc, elem};
+            acc = lval_apply_argv(lenv, lfun, 2, argv);
+        }
     }
 
     lval_del(lval);
-    return lval_wrap_long(result);
+    return acc;
 }
 
-LVal *builtin_if(LEnv *lenv, LVal *lval) {
-    LASSERT_CHILD_COUNT("if", lval, 3);
-
-    LASSERT_CHILD_TYPE("if", lval, 0, LVAL_NUM);
-    LASSERT_CHILD_TYPE("if", lval, 1, LVAL_QEXPR);
-    LASSERT_CHILD_TYPE("if", lval, 2, LVAL_QEXPR);
+LVal *builtin_reduce(LEnv *lenv, LVal *lval) {
+    return builtin_fold(lenv, lval);
+}
 
-    LVal *result;
+LVal *builtin_foldl(LEnv *lenv, LVal *lval) {
+    return builtin_fold(lenv, lval);
+}
 
-    // Convert expressions to be evaluable
-    lval->children[1]->type = LVAL_SEXPR;
-    lval->children[2]->type = LVAL_SEXPR;
+LVal *builtin_transient(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    return lval_wrap_transient(ltransient_new(lval_take(lval, 0)));
+}
 
-    if (lval->children[0]->num) {
-        result = lval_eval(lenv, lval_pop(lval, 1));
-    } else {
-        result = lval_eval(lenv, lval_pop(lval, 2));
+LVal *builtin_pushv(LEnv *lenv, int argc, LVal **argv) {
+    (void)lenv;
+    LTransient *ltransient = argv[0]->ltransient;
+    if (ltransient->frozen) {
+        lval_del_argv(argc, argv);
+        return lval_wrap_err(LERR_THAWED, "push!", 0, 0, 0);
     }
 
-    lval_del(lval);
+    // Values are moved in, only the transient is left to return
+    for (int i = 1; i < argc; i++) {
+        ltransient_push(ltransient, argv[i]);
+    }
+    return argv[0];
+}
 
-    return result;
+LVal *builtin_push(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_pushv, lval);
 }
 
-LVal *builtin_var(LEnv *lenv, LVal *lval, char *fun) {
-    // Syntax is of the form:
-    //`fun {sym1, sym2, ...} val1, val2, ...`
-    //     ^- Child 0        ^- Child 1  ^- Child N
+LVal *builtin_set_nth(LEnv *lenv, LVal *lval) {
+    (void)lenv;
+    LASSERT_CHILD_THAWED("set-nth!", lval, 0);
 
-    // Check whether Child 0 is a QEXPR
-    LASSERT_CHILD_TYPE(fun, lval, 0, LVAL_QEXPR);
+    LTransient *ltransient = lval->children[0]->ltransient;
+    long index = lval->children[1]->num;
+    LASSERT_INDEX("set-nth!", lval, index, ltransient->count);
 
-    // Get the symbol list(QEXPR)
-    LVal *var_list = lval->children[0];
+    lval_del(ltransient->items[index]);
+    ltransient->items[index] = lval_pop(lval, 2);
+    return lval_take(lval, 0);
+}
 
-    // Assert all var_list members are symbols
-    for (int i = 0; i < var_list->child_count; i++) {
-        LASSERT_CHILD_TYPE(fun, var_list, i, LVAL_SYM);
+LVal *builtin_nthv(LEnv *lenv, int argc, LVal **argv) {
+    (void)lenv;
+    LVal *lseq = argv[0];
+    LASSERT_ARGV(
+        argc, argv, lseq->type == LVAL_QEXPR || lseq->type == LVAL_TRANSIENT,
+        lval_wrap_err(LERR_ARG_TYPE, "nth", 0, lseq->type, LVAL_QEXPR));
+
+    LVal **items = lseq->children;
+    int count = lseq->child_count;
+    if (lseq->type == LVAL_TRANSIENT) {
+        LASSERT_ARGV(argc, argv, !lseq->ltransient->frozen,
+                     lval_wrap_err(LERR_THAWED, "nth", 0, 0, 0));
+        items = lseq->ltransient->items;
+        count = lseq->ltransient->count;
     }
 
-    // Assert there are enough values for all symbols in var list
-    LASSERT_CHILD_COUNT(fun, var_list, lval->child_count - 1);
+    long index = argv[1]->num;
+    LASSERT_ARGV(argc, argv, index >= 0 && index < count,
+                 lval_wrap_err(LERR_BAD_INDEX, "nth", index, count, 0));
 
-    for (int i = 0; i < var_list->child_count; i++) {
-        // If fun is "def" put in global scope i.e parent environment
-        if (strcmp(fun, "def") == 0) {
-            lenv_put_global(lenv, var_list->children[i], lval->children[i + 1]);
-        } else if (strcmp(fun, "=") == 0) {  // Else in local environment
-            // Put variable symbols and their values in the env
-            lenv_put(lenv, var_list->children[i], lval->children[i + 1]);
-        }
-    }
+    LVal *elem = lval_copy(items[index]);
+    lval_del_argv(argc, argv);
+    return elem;
+}
 
-    lval_del(lval);
-    return lval_wrap_sexpr();
+LVal *builtin_nth(LEnv *lenv, LVal *lval) {
+    return lbuiltinv_call(lenv, builtin_nthv, lval);
 }
 
-LVal *builtin_lambda(LEnv *lenv, LVal *lval) {
+LVal *builtin_freeze(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    // Ensure both lformals and lbody are present
-    LASSERT_CHILD_COUNT("\\", lval, 2);
-
-    // Assert both children are QEXPR
-    LASSERT_CHILD_TYPE("\\", lval, 0, LVAL_QEXPR);
-    LASSERT_CHILD_TYPE("\\", lval, 1, LVAL_QEXPR);
+    LASSERT_CHILD_THAWED("freeze", lval, 0);
 
-    // Check if first child(lformals) contains only symbols
-    for (int i = 0; i < lval->children[0]->child_count; i++) {
-        LASSERT(lval, (lval->children[0]->children[i]->type == LVAL_SYM),
-                "Formals can only contain symbols!\n"
-                "Got %s, Expected %s",
-                lval_print_type(lval->children[0]->children[i]->type),
-                lval_print_type(LVAL_SYM));
-    }
+    // The elements are handed over as they are, spare capacity included
+    LTransient *ltransient = lval->children[0]->ltransient;
+    LVal *qexpr = lval_wrap_qexpr();
+    qexpr->children = ltransient->items;
+    qexpr->child_count = ltransient->count;
 
-    LVal *lformals = lval_pop(lval, 0);
-    LVal *lbody = lval_pop(lval, 0);
+    ltransient->frozen = 1;
+    ltransient->items = NULL;
+    ltransient->count = 0;
+    ltransient->cap = 0;
 
     lval_del(lval);
+    return qexpr;
+}
+
+// A line as a single string, or split into a qexpr of fields at `delim`
+static LVal *lval_read_line(LStrBuf *owner, const char *line, size_t len,
+                            int delim) {
+    if (delim < 0) {
+        return lval_wrap_view(owner, line, len);
+    }
 
-    return lval_wrap_lambda(lformals, lbody);
+    LVal *lfields = lval_wrap_qexpr();
+    const char *end = line + len;
+    for (;;) {
+        const char *next = memchr(line, delim, (size_t)(end - line));
+        if (!next) {
+            return lval_add(lfields,
+                            lval_wrap_view(owner, line, (size_t)(end - line)));
+        }
+        lval_add(lfields, lval_wrap_view(owner, line, (size_t)(next - line)));
+        line = next + 1;
+    }
 }
 
-LVal *builtin_load(LEnv *lenv, LVal *lval) {
-    LASSERT_CHILD_COUNT("load", lval, 1);
-    LASSERT_CHILD_TYPE("load", lval, 0, LVAL_STR);
+LVal *builtin_lines(LEnv *lenv, LVal *lval, char *lbuiltin) {
+    // fold-lines takes the initial value before the path
+    int fold = strcmp(lbuiltin, "fold-lines") == 0;
+    int path = fold ? 2 : 1;
+
+    LASSERT(lval,
+            lval->child_count == path + 1 || lval->child_count == path + 2,
+            lval_wrap_err(LERR_ARG_COUNT, lbuiltin, lval->child_count,
+                          path + 1, 0));
+    LASSERT_CHILD_TYPE(lbuiltin, lval, 0, LVAL_FUN);
+    LASSERT_CHILD_TYPE(lbuiltin, lval, path, LVAL_STR);
+
+    int delim = -1;
+    if (lval->child_count == path + 2) {
+        LASSERT_CHILD_TYPE(lbuiltin, lval, path + 1, LVAL_STR);
+        LVal *ldelim = lval->children[path + 1];
+        LASSERT(lval, ldelim->len == 1,
+                lval_wrap_err(LERR_BAD_DELIM, lbuiltin, (long)ldelim->len,
+                              0, 0));
+        delim = (unsigned char)ldelim->str[0];
+    }
 
-    mpc_result_t result;
+    lval_str_terminate(lval->children[path]);
+    LFile lfile;
+    int err = lfile_open(&lfile, lval->children[path]->str);
+    LASSERT(lval, !err, lval_wrap_err_open(lval->children[path]->str, err));
 
-    if (mpc_parse_contents(lval->children[0]->str, Notation, &result)) {
-        LVal *lexpr = lval_read_ast(result.output);
-        mpc_ast_delete(result.output);
+    LVal *acc = fold ? lval_pop(lval, 1) : lval_wrap_sexpr();
+    LVal *lfun = lval->children[0];
+
+    const char *line;
+    size_t len;
+    while (acc->type != LVAL_ERR && lfile_line(&lfile, &line, &len)) {
+        LVal *argv[2] = {acc, lval_read_line(lfile.owner, line, len, delim)};
+        LVal *result = lval_apply_argv(lenv, lfun, 1 + fold, argv + !fold);
 
-        while (lexpr->child_count) {
-            LVal *leval = lval_eval(lenv, lval_pop(lexpr, 0));
-            if (leval->type == LVAL_ERR) {
-                lval_println(leval);
+        // each-line keeps only errors, () is returned otherwise
+        if (fold || result->type == LVAL_ERR) {
+            if (!fold) {
+                lval_del(acc);
             }
-            lval_del(leval);
+            acc = result;
+        } else {
+            lval_del(result);
         }
+    }
 
-        lval_del(lexpr);
-        lval_del(lval);
-
-        return lval_wrap_sexpr();
-    } else {
-        char *err = mpc_err_string(result.error);
-        mpc_err_delete(result.error);
+    lfile_close(&lfile);
+    lval_del(lval);
+    return acc;
+}
 
-        LVal *lerr = lval_wrap_err("Could not load file: %s", err);
-        free(err);
-        lval_del(lval);
+LVal *builtin_each_line(LEnv *lenv, LVal *lval) {
+    return builtin_lines(lenv, lval, "each-line");
+}
 
-        return lerr;
-    }
+LVal *builtin_fold_lines(LEnv *lenv, LVal *lval) {
+    return builtin_lines(lenv, lval, "fold-lines");
 }
 
-LVal *builtin_print(LEnv *lenv, LVal *lval) {
-    (void)lenv;
-    for (int i = 0; i < lval->child_count; i++) {
-        lval_print(lval->children[i]);
-        printf(" ");
-    }
-    printf("\n");
-    lval_del(lval);
+LVal *builtin_spawn(LEnv *lenv, LVal *lval) {
+    LASSERT_CHILD_COUNT("spawn", lval, 1);
+    LASSERT(lval,
+            lval->children[0]->type == LVAL_QEXPR ||
+                lval->children[0]->type == LVAL_FUN,
+            lval_wrap_err(LERR_ARG_TYPE, "spawn", 0, lval->children[0]->type,
+                          LVAL_QEXPR));
 
-    return lval_wrap_sexpr();
+    return lval_wrap_future(ltask_spawn(lenv, lval_take(lval, 0)));
 }
 
-LVal *builtin_err(LEnv *lenv, LVal *lval) {
+LVal *builtin_await(LEnv *lenv, LVal *lval) {
     (void)lenv;
-    LASSERT_CHILD_COUNT("error", lval, 1);
-    LASSERT_CHILD_TYPE("error", lval, 0, LVAL_STR);
-
-    LVal *lerr = lval_wrap_err(lval->children[0]->str);
 
+    LVal *result = ltask_await(lval->children[0]->ltask);
     lval_del(lval);
-    return lerr;
+    return result;
 }
+
 LVal *builtin_def(LEnv *lenv, LVal *lval) {
     return builtin_var(lenv, lval, "def");
 }
@@ -1457,80 +4901,152 @@ LVal *builtin_put(LEnv *lenv, LVal *lval) {
     return builtin_var(lenv, lval, "=");
 }
 
+LVal *builtin_addv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_op(lenv, argc, argv, "+");
+}
+
 LVal *builtin_add(LEnv *lenv, LVal *lval) {
-    return builtin_op(lenv, lval, "+");
+    return lbuiltinv_call(lenv, builtin_addv, lval);
+}
+
+LVal *builtin_subv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_op(lenv, argc, argv, "-");
 }
 
 LVal *builtin_sub(LEnv *lenv, LVal *lval) {
-    return builtin_op(lenv, lval, "-");
+    return lbuiltinv_call(lenv, builtin_subv, lval);
+}
+
+LVal *builtin_mulv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_op(lenv, argc, argv, "*");
 }
 
 LVal *builtin_mul(LEnv *lenv, LVal *lval) {
-    return builtin_op(lenv, lval, "*");
+    return lbuiltinv_call(lenv, builtin_mulv, lval);
+}
+
+LVal *builtin_divv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_op(lenv, argc, argv, "/");
 }
 
 LVal *builtin_div(LEnv *lenv, LVal *lval) {
-    return builtin_op(lenv, lval, "/");
+    return lbuiltinv_call(lenv, builtin_divv, lval);
+}
+
+LVal *builtin_gtv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_ord(lenv, argc, argv, ">");
 }
 
 LVal *builtin_gt(LEnv *lenv, LVal *lval) {
-    return builtin_ord(lenv, lval, ">");
+    return lbuiltinv_call(lenv, builtin_gtv, lval);
+}
+LVal *builtin_ltv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_ord(lenv, argc, argv, "<");
 }
+
 LVal *builtin_lt(LEnv *lenv, LVal *lval) {
-    return builtin_ord(lenv, lval, "<");
+    return lbuiltinv_call(lenv, builtin_ltv, lval);
+}
+LVal *builtin_gev(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_ord(lenv, argc, argv, ">=");
 }
+
 LVal *builtin_ge(LEnv *lenv, LVal *lval) {
-    return builtin_ord(lenv, lval, ">=");
+    return lbuiltinv_call(lenv, builtin_gev, lval);
+}
+LVal *builtin_lev(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_ord(lenv, argc, argv, "<=");
 }
+
 LVal *builtin_le(LEnv *lenv, LVal *lval) {
-    return builtin_ord(lenv, lval, "<=");
+    return lbuiltinv_call(lenv, builtin_lev, lval);
+}
+
+LVal *builtin_eqv(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_cmp(lenv, argc, argv, "==");
 }
 
 LVal *builtin_eq(LEnv *lenv, LVal *lval) {
-    return builtin_cmp(lenv, lval, "==");
+    return lbuiltinv_call(lenv, builtin_eqv, lval);
+}
+
+LVal *builtin_nev(LEnv *lenv, int argc, LVal **argv) {
+    return builtin_cmp(lenv, argc, argv, "!=");
 }
 
 LVal *builtin_ne(LEnv *lenv, LVal *lval) {
-    return builtin_cmp(lenv, lval, "!=");
-}
-
-void lenv_add_builtin(LEnv *lenv, char *sym, LBuiltin lbuiltin) {
-    LVal *lsym = lval_wrap_sym(sym);
-    LVal *lfun = lval_wrap_lbuiltin(lbuiltin);
-
-    lenv_put(lenv, lsym, lfun);
-    lval_del(lsym);
-    lval_del(lfun);
-}
-
-void lenv_init_builtins(LEnv *lenv) {
-    lenv_add_builtin(lenv, "list", builtin_list);
-    lenv_add_builtin(lenv, "head", builtin_head);
-    lenv_add_builtin(lenv, "tail", builtin_tail);
-    lenv_add_builtin(lenv, "eval", builtin_eval);
-    lenv_add_builtin(lenv, "join", builtin_join);
-
-    lenv_add_builtin(lenv, "\\", builtin_lambda);
-    lenv_add_builtin(lenv, "def", builtin_def);
-
-    lenv_add_builtin(lenv, "+", builtin_add);
-    lenv_add_builtin(lenv, "-", builtin_sub);
-    lenv_add_builtin(lenv, "*", builtin_mul);
-    lenv_add_builtin(lenv, "/", builtin_div);
-    lenv_add_builtin(lenv, "%", builtin_mod);
-    lenv_add_builtin(lenv, "=", builtin_put);
-
-    lenv_add_builtin(lenv, "if", builtin_if);
-    lenv_add_builtin(lenv, "==", builtin_eq);
-    lenv_add_builtin(lenv, "!=", builtin_ne);
-    lenv_add_builtin(lenv, ">", builtin_gt);
-    lenv_add_builtin(lenv, "<", builtin_lt);
-    lenv_add_builtin(lenv, ">=", builtin_ge);
-    lenv_add_builtin(lenv, "<=", builtin_le);
-
-    lenv_add_builtin(lenv, "load", builtin_load);
-    lenv_add_builtin(lenv, "print", builtin_print);
-    lenv_add_builtin(lenv, "err", builtin_err);
+    return lbuiltinv_call(lenv, builtin_nev, lval);
+}
+
+static inline LVal *lbuiltin_check(const char *sym, const LBuiltinSig *sig,
+                                    int argc, LVal **argv) {
+    if (sig->count < 0) {
+        return NULL;
+    }
+    if (sig->variadic ? argc < sig->count : argc != sig->count) {
+        return lval_wrap_err(LERR_ARG_COUNT, sym, argc, sig->count, 0);
+    }
+
+    // Arguments past the required ones are checked against the last one
+    for (int i = 0; i < argc; i++) {
+        int arg = i < sig->count ? i : sig->count;
+        int type = argv[i]->type;
+        if (!(sig->masks[arg] & (1u << type))) {
+            return lval_wrap_err(LERR_ARG_TYPE, sym, i, type,
+                                 sig->expected[arg]);
+        }
+    }
+    return NULL;
+}
+
+// Builtins as bound to their names, checking arguments against the
+// signature mkbuiltins compiled before calling builtin_<name> (or
+// builtin_<name>v)
+#define LBUILTIN(sym, name, sig, fold)                                  \
+    static LVal *lbuiltin_##name(LEnv *lenv, LVal *lval) {              \
+        LVal *lerr = lbuiltin_check(sym, &lbuiltin_sig_##name,          \
+                                    lval->child_count, lval->children); \
+        if (lerr) {                                                     \
+            lval_del(lval);                                             \
+            return lerr;                                                \
+        }                                                               \
+        return builtin_##name(lenv, lval);                              \
+    }
+#define LBUILTINV(sym, name, sig, fold)                                     \
+    LBUILTIN(sym, name, sig, fold)                                          \
+    static LVal *lbuiltinv_##name(LEnv *lenv, int argc, LVal **argv) {      \
+        LVal *lerr = lbuiltin_check(sym, &lbuiltin_sig_##name, argc, argv); \
+        if (lerr) {                                                         \
+            lval_del_argv(argc, argv);                                      \
+            return lerr;                                                    \
+        }                                                                   \
+        return builtin_##name##v(lenv, argc, argv);                         \
+    }
+#include "builtins.def"
+
+#define LBUILTIN(sym, name, sig, fold)                           \
+    {sym,                                                        \
+     &lbuiltin_sig_##name,                                       \
+     fold,                                                       \
+     {.type = LVAL_FUN,                                          \
+      .flags = LFLAG_STATIC,                                     \
+      .lbuiltin = lbuiltin_##name}},
+#define LBUILTINV(sym, name, sig, fold)                          \
+    {sym,                                                        \
+     &lbuiltin_sig_##name,                                       \
+     fold,                                                       \
+     {.type = LVAL_FUN,                                          \
+      .flags = LFLAG_STATIC,                                     \
+      .lbuiltin = lbuiltin_##name,                               \
+      .lbuiltinv = lbuiltinv_##name}},
+LBuiltinDef lbuiltins[] = {
+#include "builtins.def"
+};
+
+int lbuiltin_index(const char *sym) {
+    unsigned hash = lbuiltin_hash(sym, LBUILTIN_SEED);
+    int index = lbuiltin_slots[hash & (LBUILTIN_SLOTS - 1)];
+    return index >= 0 && strcmp(lbuiltins[index].sym, sym) == 0 ? index : -1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
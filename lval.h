@@ -1,13 +1,42 @@
 #ifndef LVAL_H
 #define LVAL_H
 
+#include "lbuf.h"
 #include "mpc.h"
 
 struct LVal;
 struct LEnv;
+struct LICache;
+struct LFold;
+struct LStrBuf;
+struct LMap;
+struct LSeq;
+struct LTransient;
+struct LBig;
+struct LJit;
+struct LTask;
 
 typedef struct LVal LVal;
 typedef struct LEnv LEnv;
+typedef struct LICache LICache;
+typedef struct LFold LFold;
+typedef struct LStrBuf LStrBuf;
+typedef struct LMap LMap;
+typedef struct LSeq LSeq;
+typedef struct LTransient LTransient;
+typedef struct LBig LBig;
+typedef struct LJit LJit;
+typedef struct LTask LTask;
+
+/* Symbols and strings shorter than this are stored inline in their LVal */
+#define LVAL_STR_INLINE 24
+
+/* LVal's freed by a call of lval_reclaim between two REPL lines, at least */
+#define LVAL_RECLAIM_STEP 65536
+
+/* Counters (eg: reference counts) shared by OS threads running tasks */
+#define LATOMIC_ADD(var, n) __atomic_add_fetch(&(var), (n), __ATOMIC_ACQ_REL)
+#define LATOMIC_GET(var) __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
 
 /* LVal Types */
 enum {
@@ -17,7 +46,55 @@ enum {
     LVAL_STR,
     LVAL_SEXPR,
     LVAL_QEXPR,
-    LVAL_FUN
+    LVAL_FUN,
+    LVAL_MAP,
+    LVAL_SEQ,
+    LVAL_FUTURE,
+    LVAL_TRANSIENT,
+    LVAL_BIG
+};
+
+/* LSeq Kinds */
+enum {
+    LSEQ_RANGE,   /* Numbers from `start` upto `stop` by `step` */
+    LSEQ_REPEAT,  /* `cur`, `count` times */
+    LSEQ_ITERATE, /* `cur`, then `fn` applied to the previous element */
+    LSEQ_GEN      /* Unfolded from state `cur` by `fn`, @see builtin_gen */
+};
+
+/* LVal Flags */
+enum {
+    LFLAG_STATIC = 1, /* Preallocated, never copied or freed */
+    LFLAG_FOLDED = 2  /* Folded constant, `lfold` has the source expression */
+};
+
+/* LVal Error Codes, exposed to lispy by `err-code` */
+enum {
+    LERR_NONE,          /* Not an error */
+    LERR_CUSTOM,        /* Raised by `err`, message in `err` */
+    LERR_ARG_COUNT,     /* Args: got, expected */
+    LERR_ARG_TYPE,      /* Args: index, got type, expected type */
+    LERR_ARG_EMPTY,     /* Args: index */
+    LERR_UNBOUND,       /* Symbol in `err` */
+    LERR_DIV_ZERO,      /* No args */
+    LERR_BAD_SEXPR,     /* Args: got type, expected type */
+    LERR_TOO_MANY_ARGS, /* Args: got, expected */
+    LERR_BAD_VARIADIC,  /* No args */
+    LERR_BAD_FORMALS,   /* Args: got type, expected type */
+    LERR_NUM_RANGE,     /* No args */
+    LERR_LOAD,          /* Reason in `err` */
+    LERR_BAD_KEY,       /* Args: index, got type */
+    LERR_NO_KEY,        /* Printed key in `err` */
+    LERR_BAD_GEN,       /* Args: got type, number of elements */
+    LERR_OPEN,          /* Path and reason in `err` */
+    LERR_BAD_DELIM,     /* Args: length of the delimiter */
+    LERR_FROZEN,        /* No args */
+    LERR_BAD_INDEX,     /* Args: index, count */
+    LERR_THAWED,        /* No args */
+    LERR_BAD_DUMP,      /* No args */
+    LERR_BAD_ELEM,      /* Args: index, got type, expected type */
+    LERR_BAD_ARG,       /* Args: index, the number passed */
+    LERR_BAD_RESULT     /* Args: index, got type, expected type */
 };
 
 /**
@@ -29,29 +106,92 @@ enum {
  */
 typedef LVal *(*LBuiltin)(LEnv *, LVal *);
 
+/**
+ * @brief  A function pointer for LBuiltins taking their arguments as a vector
+ * @note   The evaluator calls these with the arguments in place on the LStack
+ *         (@see lstack.h), so calling one allocates nothing for the arguments
+ * @param  LEnv *: A LEnv to hold environment variables
+ * @param  int: Number of arguments
+ * @param  LVal **: The arguments, consumed but not the vector itself
+ * @retval Evaluation as a LVal
+ */
+typedef LVal *(*LBuiltinV)(LEnv *, int, LVal **);
+
 /**
  * @brief  Store number or error in an abstract type
- * @note  LVal are lispy native values
+ * @note  LVal are lispy native values. Only the members for `type` are set,
+ *        the others sharing their storage
  */
 struct LVal {
     /* Type */
     int type;
+    int flags;
 
-    /* Value */
-    long num;
-    char *err;
-    char *sym;
-    char *str;
+    /* Expression a LFLAG_FOLDED constant was folded from */
+    LFold *lfold;
 
-    /* Functions */
-    LBuiltin lbuiltin;
-    LEnv *lenv;
-    LVal *lformals;
-    LVal *lbody;
+    /* Value, the member in use being given by `type` */
+    __extension__ union {
+        long num;
+        /* Integer beyond a long, shared by all copies (@see lbig.h) */
+        LBig *lbig;
 
-    /* Child Expressions */
-    struct LVal **children;
-    int child_count;
+        /* Symbols and strings */
+        __extension__ struct {
+            /* Point either to `inl` or into `strbuf`, null terminated unless
+             * `str` is a view into a mapped file (@see lval_wrap_view) */
+            __extension__ union {
+                char *sym;
+                char *str;
+            };
+            /* Length of `sym`/`str` in bytes, which may include null bytes */
+            size_t len;
+            /* Shared immutable storage of longer symbols and strings, else
+             * NULL */
+            LStrBuf *strbuf;
+            /* Inline cache of the global binding of a symbol, may be NULL */
+            LICache *icache;
+            char inl[LVAL_STR_INLINE];
+        };
+
+        /* Hash map, shared copy on write by all copies (@see lmap.h) */
+        LMap *lmap;
+        /* Lazy sequence, shared by all copies (@see LSeq) */
+        LSeq *lseq;
+        /* Spawned task, shared by all copies of the future (@see ltask.h) */
+        LTask *ltask;
+        /* Mutable buffer, shared by all copies (@see LTransient) */
+        LTransient *ltransient;
+
+        /* Errors, formatted lazily from code and arguments */
+        __extension__ struct {
+            int errcode;
+            const char *errfn;
+            long errargs[3];
+            char *err;
+        };
+
+        /* Functions */
+        __extension__ struct {
+            LBuiltin lbuiltin;
+            /* Same builtin taking a vector of arguments, or NULL */
+            LBuiltinV lbuiltinv;
+            LEnv *lenv;
+            LVal *lformals;
+            LVal *lbody;
+            /* lbody with constants folded, NULL if there was nothing to fold */
+            LVal *lfolded;
+            /* Native code of a lambda, shared by all copies (@see jit.h), or
+             * NULL */
+            LJit *ljit;
+        };
+
+        /* Child Expressions */
+        __extension__ struct {
+            struct LVal **children;
+            int child_count;
+        };
+    };
 };
 
 /**
@@ -68,8 +208,152 @@ struct LEnv {
     LVal **lvals;
 
     int child_count;
+
+    /* Stamp which changes whenever a symbol is added to this environment,
+     * indices of bound symbols never change (@see LICache) */
+    unsigned long version;
+    /* Clock value of the last change of any binding and of each binding, so
+     * code depending on a few names checks only those. NULL in frames */
+    unsigned long stamp;
+    unsigned long *stamps;
+
+    /* Number of bindings shadowing a builtin that constants are folded for */
+    int shadows;
+
+    /* Bindings of a call frame allocated on the LStack along with the LEnv
+     * (@see lenv_frame), 0 for a LEnv on the heap. They move to the heap
+     * once the frame binds more than that */
+    int frame;
+};
+
+/**
+ * @brief  Cached location of a symbol in the global LEnv
+ * @note   Shared (and reference counted) by all copies of a symbol read from
+ *         source, so a symbol in a lambda body is resolved once per version
+ *         of the global LEnv instead of once per evaluation
+ */
+struct LICache {
+    int refs;
+
+    /* The global LEnv, its version when cached and the index of the symbol */
+    LEnv *lenv;
+    unsigned long version;
+    int index;
 };
 
+/**
+ * @brief  Source of a folded constant, shared by all copies of the constant
+ * @note   Evaluated instead of the constant once a folded builtin is shadowed
+ */
+struct LFold {
+    int refs;
+    LVal *src;
+};
+
+/**
+ * @brief  Immutable bytes of a symbol or string, shared by all its copies
+ * @note   Copying a long string only bumps `refs`
+ */
+struct LStrBuf {
+    int refs;
+    /* Mapped file the bytes of string views lie in (@see lfile.h), unmapped
+     * with the last reference. NULL if the bytes are in `data` */
+    void *map;
+    size_t map_len;
+    char data[];
+};
+
+/**
+ * @brief  State of a lazy sequence, shared by all copies of a LVAL_SEQ
+ * @note   Elements are produced on demand so a sequence only ever holds its
+ *         current element. Consumers advance a sequence in place once it is
+ *         no longer shared (@see lseq_own)
+ */
+struct LSeq {
+    int refs;
+    int kind;
+
+    /* LSEQ_RANGE: next number, exclusive bound (if `step` isn't 0), step */
+    long start;
+    long stop;
+    long step;
+
+    /* LSEQ_REPEAT: remaining elements, negative if infinite */
+    long count;
+
+    /* Current element, or state of LSEQ_GEN */
+    LVal *cur;
+    /* LSEQ_ITERATE/LSEQ_GEN: function computing the next element/state */
+    LVal *fn;
+
+    /* LSEQ_ITERATE: the current element is `fn` applied to `cur` */
+    int stale;
+    /* LSEQ_GEN: `fn` applied to `cur` ({} or {element state}), or NULL */
+    LVal *forced;
+};
+
+/**
+ * @brief  Elements of a transient, shared by all copies of a LVAL_TRANSIENT
+ * @note   Unlike any other LVal, a transient is modified in place by
+ *         `push!` and `set-nth!`, which all its copies see. `freeze` hands
+ *         the elements over to a Q-Expression and leaves it frozen, no
+ *         longer usable. Not to be shared by concurrent tasks
+ */
+struct LTransient {
+    int refs;
+    int frozen;
+
+    /* Elements, `cap` of them allocated, doubling when full */
+    LVal **items;
+    int count;
+    int cap;
+};
+
+/* Pointers a LWork holds inline before spilling to the heap */
+#define LWORK_INLINE 64
+
+/**
+ * @brief  Explicit stack of pending work, for traversals of nested LVal's
+ * @note   Traversals loop over a LWork instead of recursing on the C stack,
+ *         so the depth of nesting is only limited by memory. Usually lives on
+ *         the stack, only deep or wide trees spill to the heap
+ */
+typedef struct LWork {
+    void **items;
+    size_t len;
+    size_t cap;
+    void *inl[LWORK_INLINE];
+} LWork;
+
+/**
+ * @brief  Initialize an empty LWork
+ * @param  *work: A LWork
+ * @retval None
+ */
+void lwork_init(LWork *work);
+
+/**
+ * @brief  Push an item, growing the LWork as needed
+ * @param  *work: A LWork
+ * @param  *item: The item
+ * @retval None
+ */
+void lwork_push(LWork *work, void *item);
+
+/**
+ * @brief  Pop the item pushed last
+ * @param  *work: A LWork, not empty
+ * @retval The item
+ */
+void *lwork_pop(LWork *work);
+
+/**
+ * @brief  Release heap memory of a LWork, which is empty afterwards
+ * @param  *work: A LWork
+ * @retval None
+ */
+void lwork_free(LWork *work);
+
 /**
  * @brief Print the value of a LVal, adding a new line at the end
  * @param  val: An LVal
@@ -77,6 +361,15 @@ struct LEnv {
  */
 void lval_println(LVal *lval);
 
+/**
+ * @brief  Print value of LVal into a LBuf
+ * @note   Used to render LVal's into strings or non-stdout sinks
+ * @param  *lbuf: The LBuf written to
+ * @param  *lval: An LVal
+ * @retval None
+ */
+void lval_print_lbuf(LBuf *lbuf, LVal *lval);
+
 /**
  * @brief  Read ast as a LVal
  * @param  *node: The ast to be converted
@@ -91,6 +384,61 @@ LVal *lval_read_ast(mpc_ast_t *node);
  */
 void lval_del(LVal *lval);
 
+/**
+ * @brief  Queue a LVal to be deleted later by lval_reclaim
+ * @note   For large trees whose lval_del would stall the caller, eg: the
+ *         previous result of a REPL line
+ * @param  *lval: The LVal which need to be freed along with its contents
+ * @retval None
+ */
+void lval_del_deferred(LVal *lval);
+
+/**
+ * @brief  Free LVal's queued by lval_del_deferred
+ * @param  budget: Most LVal's freed by this call, 0 to free all of them
+ * @retval 1 if LVal's are left to be freed, 0 otherwise
+ */
+int lval_reclaim(size_t budget);
+
+/**
+ * @brief  Copy a LVal
+ * @param  *lval: The LVal to be copied
+ * @retval A copy which is deleted independently of `lval`
+ */
+LVal *lval_copy(LVal *lval);
+
+/**
+ * @brief  Compare two LVal's
+ * @param  *first: The first LVal
+ * @param  *second: The second LVal
+ * @retval 1 if they are equal, 0 otherwise
+ */
+int lval_eq(LVal *first, LVal *second);
+
+/**
+ * @brief  Call a copy of a function, leaving the function itself untouched
+ * @note   lval_call binds arguments into the function it is given, so
+ *         functions held by builtins (eg: by `reduce`) are called this way
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A LVal of type LVAL_FUN, not consumed
+ * @param  *largs: A LVAL_SEXPR of arguments, consumed
+ * @retval Result of the call
+ */
+LVal *lval_apply(LEnv *lenv, LVal *lfun, LVal *largs);
+
+/**
+ * @brief  Call a function with a vector of arguments, as lval_apply would
+ * @note   Calls of LBuiltinVs and complete calls of lambdas take the
+ *         arguments from the vector, so a caller reusing one vector (eg:
+ *         `map`) allocates no argument list per call
+ * @param  *lenv: The LEnv of the caller
+ * @param  *lfun: A LVal of type LVAL_FUN, not consumed
+ * @param  argc: Number of arguments
+ * @param  **argv: The arguments, consumed but not the vector itself
+ * @retval Result of the call
+ */
+LVal *lval_apply_argv(LEnv *lenv, LVal *lfun, int argc, LVal **argv);
+
 /**
  * @brief  Evaluate an LVal
  * @note   Fetches symbols from LEnv, Handles SEXPR, or just returns LVal
@@ -100,6 +448,18 @@ void lval_del(LVal *lval);
  */
 LVal *lval_eval(LEnv *lenv, LVal *lval);
 
+/* Bindings of builtins that constants are folded for (eg: `+`) to anything
+ * else, summed over all LEnv's. While this is 0 those names mean the builtins
+ */
+extern long lenv_fold_shadows;
+
+/* Source of LEnv versions and stamps, only ever increasing */
+extern unsigned long lenv_version_clock;
+
+/* Nonzero while the global LEnv must not be bound (eg: by `def`), set while
+ * serving requests (@see server.h) */
+extern int lenv_frozen;
+
 /**
  * @brief  Create a new LEnv
  * @retval A LEnv with fields initialized to NULL/0
@@ -114,11 +474,44 @@ LEnv *lenv_new(void);
 void lenv_del(LEnv *lenv);
 
 /**
- * @brief  Add default builtins to LEnv
- * @param  *lenv: The LEnv where the builtins are to be added
+ * @brief  Search for LVal of type LVAL_SYM in LEnv "hay" containing the same
+ * symbol(sym) as "pin"
+ * @param  *hay: LEnv "hay" to search the symbol(LVal) "pin" in
+ * @param  *pin: The symbol(LVal) "pin" to be searched for in the LEnv "hay"
+ * @retval A copy of LVal in "hay" having symbol same as "pin" if exists, else
+ * error of the type LVAL_ERR
+ */
+LVal *lenv_get(LEnv *hay, LVal *pin);
+
+/**
+ * @brief  Get the value of a global name, without copying it
+ * @note   Names the global LEnv doesn't bind resolve to builtins
+ *         (@see builtins.def)
+ * @param  *root: The global LEnv
+ * @param  *sym: A null terminated name
+ * @retval The value, owned by `root` or static, or NULL if unbound
+ */
+LVal *lenv_get_global(LEnv *root, const char *sym);
+
+/**
+ * @brief  Get the index of a name bound in a LEnv itself
+ * @note   The index stays valid for the life of the LEnv, bindings are only
+ *         ever added or replaced
+ * @param  *lenv: The LEnv
+ * @param  *sym: A null terminated name
+ * @retval An index into `lvals` and `stamps`, or -1 if unbound
+ */
+int lenv_index(LEnv *lenv, const char *sym);
+
+/**
+ * @brief  Put an LVal with symbol lsym inside a LEnv
+ * @param  *lenv: A LEnv in which the LVal is to be added
+ * @param  *lsym: The symbol of the LVal which is to be added into LEnv
+ * @param  *lval: The LVal with symbol lsym which is to be added into LEnv
  * @retval None
  */
-void lenv_init_builtins(LEnv *lenv);
+void lenv_put(LEnv *lenv, LVal *lsym, LVal *lval);
+
 
 /**
  * @brief  Add a LVal to another LVal
@@ -135,6 +528,68 @@ LVal *lval_add(LVal *parent, LVal *child);
  */
 LVal *lval_wrap_sexpr(void);
 
+/**
+ * @brief  Create a empty Q-Expression
+ * @note   Wrapper for lval_wrap_expr
+ * @retval A LVal with type LVAL_QEXPR
+ */
+LVal *lval_wrap_qexpr(void);
+
+/**
+ * @brief  Wrap a number as a LVal
+ * @param  num: The number to be wrapped
+ * @retval A LVal of type LVAL_NUM
+ */
+LVal *lval_wrap_long(long num);
+
+/**
+ * @brief  Wrap a LBig as a LVal
+ * @note   A LBig fitting a long is wrapped as a LVAL_NUM, and freed, so
+ *         every integer has a single representation
+ * @param  *lbig: The LBig, whose reference is handed over
+ * @retval A LVal of type LVAL_NUM or LVAL_BIG
+ */
+LVal *lval_wrap_big(LBig *lbig);
+
+/**
+ * @brief  Wrap `len` bytes as a LVal symbol
+ * @param  *sym: The bytes, need not be null terminated
+ * @param  len: Number of bytes
+ * @retval A LVal of type LVAL_SYM
+ */
+LVal *lval_wrap_symn(const char *sym, size_t len);
+
+/**
+ * @brief  Wrap bytes of a mapped file as a string without copying them
+ * @note   Short strings are copied inline instead, so they neither keep the
+ *         mapping alive nor lack the null terminator
+ * @param  *owner: The LStrBuf owning the mapping, gets a reference
+ * @param  *str: The bytes, within the mapping
+ * @param  len: Number of bytes
+ * @retval A LVal of type LVAL_STR
+ */
+LVal *lval_wrap_view(LStrBuf *owner, const char *str, size_t len);
+
+/**
+ * @brief  Wrap a LMap as a LVal
+ * @param  *lmap: The LMap, whose reference is handed over
+ * @retval A LVal of type LVAL_MAP
+ */
+LVal *lval_wrap_map(LMap *lmap);
+
+/**
+ * @brief  Drop a reference to a LStrBuf, freeing it with the last one
+ * @param  *lstrbuf: A LStrBuf, may be NULL
+ * @retval None
+ */
+void lstrbuf_del(LStrBuf *lstrbuf);
+
+/**
+ * @brief  Create an empty inline cache for a symbol
+ * @retval A LICache with a single reference which matches no LEnv
+ */
+LICache *licache_new(void);
+
 /**
  * @brief  Wrap a string as a LVal
  * @param  *str: The string to be wrapped
@@ -142,6 +597,26 @@ LVal *lval_wrap_sexpr(void);
  */
 LVal *lval_wrap_str(char *str);
 
+/**
+ * @brief  Wrap `len` bytes as a string LVal
+ * @param  *str: The bytes, need not be null terminated
+ * @param  len: Number of bytes
+ * @retval A LVal of type LVAL_STR
+ */
+LVal *lval_wrap_strn(const char *str, size_t len);
+
+/**
+ * @brief  Evaluate the forms read from a file, like `load` does
+ * @note   Forms are folded first, errors they evaluate to are printed
+ * @param  *lenv: The environment where the forms are evaluated
+ * @param  *lforms: A LVAL_SEXPR of the forms, consumed
+ * @param  *after: Called after every form with `ctx`, may be NULL
+ * @param  *ctx: Passed to `after`
+ * @retval None
+ */
+void lval_eval_forms(LEnv *lenv, LVal *lforms,
+                     void (*after)(LEnv *lenv, void *ctx), void *ctx);
+
 /**
  * @brief  Load files containing valid lispy expression
  * @param  *lenv: The environment where the expressions are loaded
@@ -0,0 +1,165 @@
+/* Generates lbuiltins.h, a perfect hash of the names in builtins.def and
+ * their compiled signatures
+ *
+ * Searches the seed for which lbuiltin_hash maps every name to a distinct
+ * slot, in the fewest slots (a power of two) a seed is found for, and
+ * prints the slots with the index of their builtin. Looking a name up is
+ * then a hash and one strcmp (@see lbuiltin_index). Each signature is
+ * printed as a LBuiltinSig named lbuiltin_sig_<name>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lbuiltin.h"
+
+#define LBUILTIN(sym, name, sig, fold) {sym, #name, sig},
+static const struct {
+    const char *sym;
+    const char *name;
+    const char *sig;
+} builtins[] = {
+#include "builtins.def"
+};
+
+#define COUNT (int)(sizeof(builtins) / sizeof(builtins[0]))
+
+/* Seeds tried for a number of slots before doubling it */
+#define SEEDS 1000000u
+
+// Whether `seed` hashes every name to its own slot, filled in `slots`
+static int perfect(unsigned seed, int size, signed char *slots) {
+    memset(slots, -1, (size_t)size);
+    for (int i = 0; i < COUNT; i++) {
+        unsigned hash = lbuiltin_hash(builtins[i].sym, seed);
+        int slot = (int)(hash & (unsigned)(size - 1));
+        if (slots[slot] >= 0) {
+            return 0;
+        }
+        slots[slot] = (signed char)i;
+    }
+    return 1;
+}
+
+// Accept `type` for an argument
+#define BIT(type) (1u << (type))
+
+// Types accepted for a character of a signature, and the one reported as
+// expected otherwise, 0 if the character is unknown
+static unsigned sig_mask(char c, int *expected) {
+    switch (c) {
+        case 'n':
+            *expected = LVAL_NUM;
+            return BIT(LVAL_NUM);
+        case 'N':
+            *expected = LVAL_NUM;
+            return BIT(LVAL_NUM) | BIT(LVAL_BIG);
+        case 's':
+            *expected = LVAL_STR;
+            return BIT(LVAL_STR);
+        case 'q':
+            *expected = LVAL_QEXPR;
+            return BIT(LVAL_QEXPR);
+        case 'f':
+            *expected = LVAL_FUN;
+            return BIT(LVAL_FUN);
+        case 'm':
+            *expected = LVAL_MAP;
+            return BIT(LVAL_MAP);
+        case 't':
+            *expected = LVAL_FUTURE;
+            return BIT(LVAL_FUTURE);
+        case 'b':
+            *expected = LVAL_TRANSIENT;
+            return BIT(LVAL_TRANSIENT);
+        case 'i':
+            *expected = LVAL_SEQ;
+            return BIT(LVAL_QEXPR) | BIT(LVAL_SEQ);
+        case '.':
+            *expected = 0;
+            return ~0u;
+    }
+    return 0;
+}
+
+// Print the LBuiltinSig of a builtin, 0 if its signature is malformed
+static int print_sig(const char *name, const char *sig) {
+    int count = -1;
+    int variadic = 0;
+    unsigned masks[LBUILTIN_MAX_ARGS] = {0};
+    int expected[LBUILTIN_MAX_ARGS] = {0};
+
+    if (sig) {
+        // Arguments before a trailing `*` are required, the last repeats
+        int len = (int)strlen(sig);
+        variadic = len > 1 && sig[len - 1] == '*';
+        count = variadic ? len - 2 : len;
+        if (len - variadic > LBUILTIN_MAX_ARGS) {
+            return 0;
+        }
+        for (int i = 0; i < len - variadic; i++) {
+            masks[i] = sig_mask(sig[i], &expected[i]);
+            if (!masks[i]) {
+                return 0;
+            }
+        }
+    }
+
+    printf("static const LBuiltinSig lbuiltin_sig_%s = {%d, %d, {", name,
+           count, variadic);
+    for (int i = 0; i < LBUILTIN_MAX_ARGS; i++) {
+        printf("%s%#x", i ? ", " : "", masks[i]);
+    }
+    printf("}, {");
+    for (int i = 0; i < LBUILTIN_MAX_ARGS; i++) {
+        printf("%s%d", i ? ", " : "", expected[i]);
+    }
+    puts("}};");
+    return 1;
+}
+
+int main(void) {
+    if (COUNT > 127) {
+        fprintf(stderr, "mkbuiltins: too many builtins\n");
+        return 1;
+    }
+
+    int size = 1;
+    while (size < 2 * COUNT) {
+        size *= 2;
+    }
+
+    signed char slots[1024];
+    for (; size <= 1024; size *= 2) {
+        for (unsigned seed = 0; seed < SEEDS; seed++) {
+            if (!perfect(seed, size, slots)) {
+                continue;
+            }
+
+            puts("/* Generated by mkbuiltins from builtins.def */");
+            printf("#define LBUILTIN_SEED %uu\n", seed);
+            printf("#define LBUILTIN_SLOTS %d\n\n", size);
+            puts("/* Index in lbuiltins of the builtin in a slot, or -1 */");
+            printf("static const signed char lbuiltin_slots[] = {");
+            for (int i = 0; i < size; i++) {
+                printf("%s%d", i % 12 ? ", " : "\n    ", slots[i]);
+                if (i + 1 < size && i % 12 == 11) {
+                    putchar(',');
+                }
+            }
+            puts("};");
+
+            puts("\n/* Signatures of the builtins (@see lbuiltin_check) */");
+            for (int i = 0; i < COUNT; i++) {
+                if (!print_sig(builtins[i].name, builtins[i].sig)) {
+                    fprintf(stderr, "mkbuiltins: bad signature of %s\n",
+                            builtins[i].sym);
+                    return 1;
+                }
+            }
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "mkbuiltins: no perfect hash found\n");
+    return 1;
+}
@@ -0,0 +1,42 @@
+#include "parser.h"
+
+mpc_parser_t *Number;
+mpc_parser_t *Symbol;
+mpc_parser_t *String;
+mpc_parser_t *Comment;
+mpc_parser_t *Expression;
+mpc_parser_t *QExpression;
+mpc_parser_t *SExpression;
+mpc_parser_t *Notation;
+
+void parser_init(void) {
+    // Create parsers
+    Number = mpc_new("num");
+    Symbol = mpc_new("sym");
+    String = mpc_new("str");
+    Comment = mpc_new("comment");
+    Expression = mpc_new("expr");
+    QExpression = mpc_new("qexpr");
+    SExpression = mpc_new("sexpr");
+    Notation = mpc_new("lisp");
+
+    // Define the above parsers with patterns + regex
+    const char *lang =
+        " \
+        num: /-?[0-9]+/ ; \
+        sym: /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&%]+/ ; \
+        str: /\"(\\\\.|[^\"])*\"/ ; \
+        comment: /;[^\\n^\\r]*/ ; \
+        sexpr: '(' <expr>* ')' ; \
+        qexpr: '{' <expr>* '}' ; \
+        expr: <num> | <sym> | <str> | <comment> | <sexpr> | <qexpr> ; \
+        lisp: /^/ <expr>* /$/ ; \
+    ";
+    mpca_lang(MPCA_LANG_DEFAULT, lang, Number, Symbol, String, Comment,
+              SExpression, QExpression, Expression, Notation);
+}
+
+void parser_cleanup(void) {
+    mpc_cleanup(8, Number, Symbol, String, Comment, SExpression, Expression,
+                QExpression, Notation);
+}
@@ -12,4 +12,17 @@ extern mpc_parser_t *QExpression;
 extern mpc_parser_t *SExpression;
 extern mpc_parser_t *Notation;
 
+/**
+ * @brief  Create the parsers of the lispy grammar
+ * @note   Called once before anything is parsed (eg: by `load`)
+ * @retval None
+ */
+void parser_init(void);
+
+/**
+ * @brief  Free the parsers created by parser_init
+ * @retval None
+ */
+void parser_cleanup(void);
+
 #endif
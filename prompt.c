@@ -1,55 +1,82 @@
 #include <editline/readline.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "jit.h"
+#include "lbuf.h"
+#include "lperf.h"
+#include "ltask.h"
 #include "lval.h"
 #include "mpc.h"
 #include "parser.h"
+#include "server.h"
 
 #define TRUE 1
 #define FALSE 0
 
-mpc_parser_t *Number;
-mpc_parser_t *Symbol;
-mpc_parser_t *String;
-mpc_parser_t *Comment;
-mpc_parser_t *Expression;
-mpc_parser_t *QExpression;
-mpc_parser_t *SExpression;
-mpc_parser_t *Notation;
-
 int main(int argc, char *argv[]) {
-    // Create parsers
-    Number = mpc_new("num");
-    Symbol = mpc_new("sym");
-    String = mpc_new("str");
-    Comment = mpc_new("comment");
-    Expression = mpc_new("expr");
-    QExpression = mpc_new("qexpr");
-    SExpression = mpc_new("sexpr");
-    Notation = mpc_new("lisp");
-
-    // Define the above parsers with patterns + regex
-    const char *lang =
-        " \
-        num: /-?[0-9]+/ ; \
-        sym: /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&%]+/ ; \
-        str: /\"(\\\\.|[^\"])*\"/ ; \
-        comment: /;[^\\n^\\r]*/ ; \
-        sexpr: '(' <expr>* ')' ; \
-        qexpr: '{' <expr>* '}' ; \
-        expr: <num> | <sym> | <str> | <comment> | <sexpr> | <qexpr> ; \
-        lisp: /^/ <expr>* /$/ ; \
-    ";
-    mpca_lang(MPCA_LANG_DEFAULT, lang, Number, Symbol, String, Comment,
-              SExpression, QExpression, Expression, Notation);
+    parser_init();
 
     static char *input = (char *)NULL;
 
     printf("LISPY v0.0.10\n");
     printf("Enter CTRL+C or, CTRL+D on an empty line to exit\n");
 
+    // `--no-jit` or LISPY_JIT=0 interpret all lambdas, decided before any
+    // lambda is created. `--defer-free` spreads freeing results of REPL
+    // lines over the following lines. `--perf` prints the wall time and
+    // hardware counters of evaluating each REPL line (@see LPerf). `--serve
+    // SOCKET` answers requests on SOCKET instead of running the REPL. Other
+    // arguments are files to be loaded
+    const char *jit = getenv("LISPY_JIT");
+    if (jit && strcmp(jit, "0") == 0) {
+        ljit_enabled = 0;
+    }
+    // LISPY_THREADS=N runs tasks on N OS threads instead of one per CPU
+    const char *threads = getenv("LISPY_THREADS");
+    if (threads) {
+        ltask_threads = atoi(threads);
+    }
+    int defer_free = FALSE;
+    int perf = FALSE;
+    const char *serve = NULL;
+    char **files = malloc(sizeof(char *) * (size_t)argc);
+    int nfiles = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-jit") == 0) {
+            ljit_enabled = 0;
+        } else if (strcmp(argv[i], "--defer-free") == 0) {
+            defer_free = TRUE;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = TRUE;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve = argv[++i];
+        } else {
+            files[nfiles++] = argv[i];
+        }
+    }
+
     LEnv *lenv = lenv_new();
-    lenv_init_builtins(lenv);
-    if (argc == 1) {
+
+    // Files are loaded first, so a server answers requests using them
+    for (int i = 0; i < nfiles; i++) {
+        LVal *largs = lval_add(lval_wrap_sexpr(), lval_wrap_str(files[i]));
+        LVal *lfile = builtin_load(lenv, largs);
+        if (lfile->type == LVAL_ERR) {
+            lval_println(lfile);
+        }
+        lval_del(lfile);
+    }
+    free(files);
+
+    int status = 0;
+    if (serve) {
+        status = server_run(serve, lenv);
+    } else if (nfiles == 0) {
+        // LVal's freed after each line. Doubled while some are left, so that
+        // freeing catches up with lines deferring more than that, and halved
+        // back towards LVAL_RECLAIM_STEP once none are
+        size_t reclaim = LVAL_RECLAIM_STEP;
         while (TRUE) {
             mpc_result_t result;
 
@@ -68,30 +95,47 @@ int main(int argc, char *argv[]) {
             }
 
             if (mpc_parse("<stdin>", input, Notation, &result)) {
-                LVal *lval = lval_eval(lenv, lval_read_ast(result.output));
+                LVal *lexpr = lval_read_ast(result.output);
+                LPerf lperf;
+                if (perf) {
+                    lperf_start(&lperf);
+                }
+                LVal *lval = lval_eval(lenv, lexpr);
+                if (perf) {
+                    lperf_stop(&lperf);
+                }
                 lval_println(lval);
-                lval_del(lval);
+                if (perf) {
+                    LBuf lbuf;
+                    lbuf_init_file(&lbuf, stdout);
+                    lbuf_puts(&lbuf, "; ");
+                    lperf_print(&lbuf, &lperf);
+                    lbuf_putc(&lbuf, '\n');
+                    lbuf_free(&lbuf);
+                }
+                if (defer_free) {
+                    lval_del_deferred(lval);
+                } else {
+                    lval_del(lval);
+                }
                 mpc_ast_delete(result.output);
             } else {
                 mpc_err_print(result.error);
                 mpc_err_delete(result.error);
             }
-        }
-    } else if (argc >= 2) {
-        for (int i = 1; i < argc; i++) {
-            LVal *largs = lval_add(lval_wrap_sexpr(), lval_wrap_str(argv[i]));
-            LVal *lfile = builtin_load(lenv, largs);
-            if (lfile->type == LVAL_ERR) {
-                lval_println(lfile);
+            if (lval_reclaim(reclaim)) {
+                reclaim *= 2;
+            } else if (reclaim > LVAL_RECLAIM_STEP) {
+                reclaim /= 2;
             }
-            lval_del(lfile);
         }
     }
 
+    ltask_shutdown();
+    lval_reclaim(0);
     lenv_del(lenv);
 
-    mpc_cleanup(8, Number, Symbol, String, Comment, SExpression, Expression,
-                QExpression, Notation);
+    parser_cleanup();
     free(input);
-    return 0;
+    return status;
 }
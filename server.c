@@ -0,0 +1,370 @@
+#define _DEFAULT_SOURCE
+
+#include "server.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "lbuf.h"
+#include "mpc.h"
+#include "parser.h"
+
+/**
+ * @brief  A connected client
+ * @note   `in` collects bytes until whole requests arrived, `out` holds
+ *         responses the socket didn't take yet. Past SERVER_MAX_PENDING
+ *         bytes in `out`, requests wait in `in` and the socket isn't read
+ */
+typedef struct SConn {
+    int fd;
+    LBuf in;
+    size_t in_pos;
+    LBuf out;
+    size_t out_pos;
+    /* Events waited for on `fd` */
+    uint32_t events;
+    /* The client shut down its side, it's closed once every request is
+     * answered and `out` is sent */
+    int eof;
+
+    /* Every open SConn, to close them when the server stops */
+    struct SConn *prev;
+    struct SConn *next;
+} SConn;
+
+static volatile sig_atomic_t server_stop = 0;
+static SConn *server_conns = NULL;
+
+static void server_on_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+static int server_nonblock(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int server_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 || server_nonblock(fd) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void server_close(int epfd, SConn *sconn) {
+    if (sconn->prev) {
+        sconn->prev->next = sconn->next;
+    } else {
+        server_conns = sconn->next;
+    }
+    if (sconn->next) {
+        sconn->next->prev = sconn->prev;
+    }
+    epoll_ctl(epfd, EPOLL_CTL_DEL, sconn->fd, NULL);
+    close(sconn->fd);
+    lbuf_free(&sconn->in);
+    lbuf_free(&sconn->out);
+    free(sconn);
+}
+
+// Evaluate a request like a line of the REPL, appending the framed response
+static void server_eval(LEnv *lenv, SConn *sconn, const char *src,
+                        size_t len) {
+    // mpc parses null terminated strings
+    char *code = malloc(len + 1);
+    memcpy(code, src, len);
+    code[len] = '\0';
+
+    // The result is printed right into `out`, after room for its length
+    size_t start = sconn->out.len;
+    lbuf_putn(&sconn->out, "\0\0\0\0", 4);
+    mpc_result_t result;
+    if (mpc_parse("<request>", code, Notation, &result)) {
+        LEnv *lscratch = lenv_new();
+        lscratch->parent = lenv;
+        LVal *lval = lval_eval(lscratch, lval_read_ast(result.output));
+        lval_print_lbuf(&sconn->out, lval);
+        lval_del(lval);
+        lenv_del(lscratch);
+        mpc_ast_delete(result.output);
+    } else {
+        char *err = mpc_err_string(result.error);
+        lbuf_puts(&sconn->out, err);
+        free(err);
+        mpc_err_delete(result.error);
+    }
+    free(code);
+
+    size_t rlen = sconn->out.len - start - 4;
+    unsigned char *header = (unsigned char *)sconn->out.data + start;
+    header[0] = (unsigned char)(rlen >> 24);
+    header[1] = (unsigned char)(rlen >> 16);
+    header[2] = (unsigned char)(rlen >> 8);
+    header[3] = (unsigned char)rlen;
+}
+
+// Length of the request at the front of `in`, 0 if its header didn't arrive
+static size_t server_next(SConn *sconn, int *whole) {
+    *whole = 0;
+    if (sconn->in.len - sconn->in_pos < 4) {
+        return 0;
+    }
+    const unsigned char *header =
+        (const unsigned char *)sconn->in.data + sconn->in_pos;
+    size_t len = (size_t)header[0] << 24 | (size_t)header[1] << 16 |
+                 (size_t)header[2] << 8 | (size_t)header[3];
+    *whole = sconn->in.len - sconn->in_pos - 4 >= len;
+    return len;
+}
+
+// The client has too many responses to receive for more to be answered
+static int server_full(SConn *sconn) {
+    return sconn->out.len - sconn->out_pos > SERVER_MAX_PENDING;
+}
+
+// Send what the socket takes of pending responses, 0 if the client is gone
+// or has nothing left to receive
+static int server_flush(int epfd, SConn *sconn) {
+    while (sconn->out_pos < sconn->out.len) {
+        ssize_t sent =
+            send(sconn->fd, sconn->out.data + sconn->out_pos,
+                 sconn->out.len - sconn->out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            return 0;
+        }
+        sconn->out_pos += (size_t)sent;
+    }
+
+    // Sent bytes are dropped once they are half of `out`, which otherwise
+    // grows while a client receives responses as fast as they're appended
+    if (sconn->out_pos > sconn->out.len / 2) {
+        size_t left = sconn->out.len - sconn->out_pos;
+        memmove(sconn->out.data, sconn->out.data + sconn->out_pos, left);
+        sconn->out.len = left;
+        sconn->out_pos = 0;
+    }
+    int writing = sconn->out_pos < sconn->out.len;
+    // A request held back while `out` was full is answered once the socket
+    // is writable, it may be the last thing the client sent
+    int held;
+    server_next(sconn, &held);
+    if (sconn->eof && !writing && !held) {
+        return 0;
+    }
+    // A shut down socket is always readable, so it's only waited on to write
+    uint32_t events = (sconn->eof || server_full(sconn) ? 0 : EPOLLIN) |
+                      (writing || held ? EPOLLOUT : 0);
+    if (events != sconn->events) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.ptr = sconn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, sconn->fd, &event);
+        sconn->events = events;
+    }
+    return 1;
+}
+
+// Answer every complete request received until `out` is full, 0 if a
+// request is too large, which is known from its length before the request
+// itself arrives
+static int server_answer(LEnv *lenv, SConn *sconn) {
+    while (sconn->in.len - sconn->in_pos >= 4) {
+        int whole;
+        size_t len = server_next(sconn, &whole);
+        if (len > SERVER_MAX_REQUEST) {
+            return 0;
+        }
+        if (!whole || server_full(sconn)) {
+            break;
+        }
+        server_eval(lenv, sconn, sconn->in.data + sconn->in_pos + 4, len);
+        sconn->in_pos += 4 + len;
+    }
+
+    // Move a partial request to the front, so `in` doesn't grow forever
+    if (sconn->in_pos) {
+        size_t left = sconn->in.len - sconn->in_pos;
+        memmove(sconn->in.data, sconn->in.data + sconn->in_pos, left);
+        sconn->in.len = left;
+        sconn->in_pos = 0;
+    }
+    return 1;
+}
+
+// Read what the client sent, up to SERVER_READ_BUDGET bytes, and answer
+// every complete request, 0 if the client is gone or misbehaved. The socket
+// stays readable while more is pending, epoll being level triggered. Nothing
+// is read while `out` is full
+static int server_read(LEnv *lenv, int epfd, SConn *sconn) {
+    // Requests held back are answered first
+    if (!server_answer(lenv, sconn)) {
+        return 0;
+    }
+
+    char chunk[SERVER_READ_CHUNK];
+    size_t budget = SERVER_READ_BUDGET;
+    while (budget > 0 && !server_full(sconn)) {
+        ssize_t got = read(sconn->fd, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (got < 0) {
+            return 0;
+        }
+        // Requests sent before shutting down are still answered
+        if (got == 0) {
+            sconn->eof = 1;
+            break;
+        }
+        lbuf_putn(&sconn->in, chunk, (size_t)got);
+        budget -= (size_t)got < budget ? (size_t)got : budget;
+
+        // Answered chunk by chunk, so `in` holds atmost one request, or a
+        // chunk of those held back once `out` is full
+        if (!server_answer(lenv, sconn)) {
+            return 0;
+        }
+    }
+
+    return server_flush(epfd, sconn);
+}
+
+static void server_accept(int epfd, int lfd) {
+    while (1) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN once every pending client is accepted, other errors
+            // (eg: out of descriptors) are retried on the next event
+            return;
+        }
+        if (server_nonblock(fd) != 0) {
+            close(fd);
+            continue;
+        }
+
+        SConn *sconn = malloc(sizeof(SConn));
+        sconn->fd = fd;
+        lbuf_init_str(&sconn->in);
+        sconn->in_pos = 0;
+        lbuf_init_str(&sconn->out);
+        sconn->out_pos = 0;
+        sconn->events = EPOLLIN;
+        sconn->eof = 0;
+        sconn->prev = NULL;
+        sconn->next = NULL;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = sconn;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            lbuf_free(&sconn->in);
+            lbuf_free(&sconn->out);
+            free(sconn);
+            continue;
+        }
+        sconn->next = server_conns;
+        if (server_conns) {
+            server_conns->prev = sconn;
+        }
+        server_conns = sconn;
+    }
+}
+
+int server_run(const char *path, LEnv *lenv) {
+    int lfd = server_listen(path);
+    if (lfd < 0) {
+        return 1;
+    }
+    int epfd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    // The listening socket is told apart by its NULL pointer
+    event.data.ptr = NULL;
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &event) != 0) {
+        perror("epoll");
+        close(lfd);
+        unlink(path);
+        return 1;
+    }
+
+    // Without SA_RESTART, so the signals interrupt epoll_wait
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    lenv_frozen = 1;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (!server_stop) {
+        int count = epoll_wait(epfd, events, SERVER_MAX_EVENTS, -1);
+        for (int i = 0; i < count; i++) {
+            SConn *sconn = events[i].data.ptr;
+            if (!sconn) {
+                server_accept(epfd, lfd);
+                continue;
+            }
+
+            int alive = 1;
+            if (!sconn->eof &&
+                (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                alive = server_read(lenv, epfd, sconn);
+            } else if (events[i].events & EPOLLOUT) {
+                alive = server_answer(lenv, sconn) && server_flush(epfd, sconn);
+            }
+            if (!alive) {
+                server_close(epfd, sconn);
+            }
+        }
+    }
+    lenv_frozen = 0;
+
+    // Clients still connected are dropped
+    while (server_conns) {
+        server_close(epfd, server_conns);
+    }
+    close(epfd);
+    close(lfd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include "lval.h"
+
+/* Largest request accepted, clients sending more are disconnected */
+#define SERVER_MAX_REQUEST ((size_t)16 << 20)
+/* Bytes of responses a client hasn't received past which its requests are
+ * held back, and it isn't read from, until it catches up */
+#define SERVER_MAX_PENDING ((size_t)16 << 20)
+/* Events handled per wakeup of the event loop */
+#define SERVER_MAX_EVENTS 64
+/* Bytes read from a client at a time */
+#define SERVER_READ_CHUNK 65536
+/* Bytes read from a client per wakeup, the rest waits for the next one so
+ * other clients get their turn */
+#define SERVER_READ_BUDGET (4 * SERVER_READ_CHUNK)
+
+/**
+ * @brief  Serve requests on a Unix domain socket until SIGINT or SIGTERM
+ * @note   Requests and responses are framed by their length, as 4 bytes big
+ *         endian. A request is lispy source, evaluated like a line of the
+ *         REPL in a fresh LEnv over the global one, which is frozen (@see
+ *         lenv_frozen). The response is the result, printed like the REPL
+ *         prints it. Clients may send any number of requests, responses come
+ *         back in order
+ * @param  *path: Path of the socket, replaced if it exists
+ * @param  *lenv: The global LEnv, with everything requests need loaded
+ * @retval 0 once stopped, 1 if the socket could not be set up
+ */
+int server_run(const char *path, LEnv *lenv);
+
+#endif /* server.h */
@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Run every tests/*.lspy and compare what it prints with tests/<name>.out
+# Usage: tests/run.sh [path to prompt]. Tests run in a temporary directory,
+# where the inputs they read are generated first
+prompt=$(cd "$(dirname "${1:-./prompt}")" && pwd)/$(basename "${1:-./prompt}")
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# Dumps nesting a number in 100000 lists, whole and cut short before it
+printf 'LSPYD\002' > truncated.dump
+printf '{\001%.0s' $(seq 100000) >> truncated.dump
+cp truncated.dump deep.dump
+printf 'n\002' >> deep.dump
+# A dump claiming more children than it has bytes, and a dict keyed by a list
+printf 'LSPYD\002{\377\377\377\377\017' > count.dump
+printf 'LSPYD\002m\001{\000n\002' > key.dump
+
+failed=0
+for test in "$tests"/*.lspy; do
+    name=$(basename "$test" .lspy)
+    if "$prompt" "$test" 2>&1 | tail -n +3 | diff -u "$tests/$name.out" -; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        failed=1
+    fi
+done
+
+# REPL lines each leaving more garbage than lval_reclaim frees by default,
+# whose results would take about 900 MB if --defer-free fell behind
+{
+    echo '(def {big} (take 300000 (range 300000)))'
+    printf '(eval {list big})\n%.0s' $(seq 40)
+} > defer.in
+if (ulimit -v 400000 && "$prompt" --defer-free < defer.in > /dev/null 2>&1)
+then
+    echo "ok   defer-free"
+else
+    echo "FAIL defer-free"
+    failed=1
+fi
+exit $failed